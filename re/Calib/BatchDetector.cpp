@@ -0,0 +1,251 @@
+/*
+ * BatchDetector.cpp
+ *
+ * Parallel chessboard detection over a list of stored images.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "BatchDetector.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/*
+ * Default constructor : image not loaded
+ */
+BatchView::BatchView() :
+	loaded(false),
+	found(false),
+	imageSize(0, 0)
+{
+}
+
+/*
+ * Default constructor : everything set to 0
+ */
+BatchStatistics::BatchStatistics() :
+	images(0),
+	loaded(0),
+	found(0),
+	cached(0),
+	workers(0),
+	wallTime(0),
+	hashTime(0),
+	readTime(0),
+	convertTime(0),
+	findTime(0),
+	refineTime(0)
+{
+}
+
+/*
+ * Print throughput report
+ */
+void BatchStatistics::print(FILE * out) const
+{
+	// cached images are neither read nor searched
+	double n = loaded > cached ? (double) (loaded - cached) : 1.0;
+	double busy = hashTime + readTime + convertTime + findTime + refineTime;
+
+	fprintf(out, "Batch detection: %u images, %u read, %u boards found\n",
+			(unsigned) images, (unsigned) loaded, (unsigned) found);
+	fprintf(out, "  %u workers, %.3f s elapsed, %.2f images/s, "
+			"parallel efficiency %.0f%%\n",
+			(unsigned) workers,
+			wallTime,
+			wallTime > 0 ? images / wallTime : 0.0,
+			wallTime > 0 && workers > 0 ?
+				100.0 * busy / (wallTime * workers) : 0.0);
+	if (cached > 0 || hashTime > 0)
+	{
+		fprintf(out, "  %u results from the corner cache\n", (unsigned) cached);
+	}
+	fprintf(out, "  %-22s %10s %12s\n", "stage", "total (s)", "mean (ms)");
+	if (hashTime > 0)
+	{
+		fprintf(out, "  %-22s %10.3f %12.2f\n", "content hash",
+				hashTime, images > 0 ? 1e3 * hashTime / images : 0.0);
+	}
+	fprintf(out, "  %-22s %10.3f %12.2f\n", "imread",
+			readTime, 1e3 * readTime / n);
+	fprintf(out, "  %-22s %10.3f %12.2f\n", "cvtColor",
+			convertTime, 1e3 * convertTime / n);
+	fprintf(out, "  %-22s %10.3f %12.2f\n", "findChessboardCorners",
+			findTime, 1e3 * findTime / n);
+	fprintf(out, "  %-22s %10.3f %12.2f\n", "cornerSubPix",
+			refineTime, found > 0 ? 1e3 * refineTime / found : 0.0);
+}
+
+/*
+ * Constructor
+ */
+BatchDetector::BatchDetector(const ChessboardDetector & detector,
+							 ThreadPool & pool,
+							 bool flipVertical,
+							 CornerCache * cache) :
+	detector(detector),
+	pool(pool),
+	flipVertical(flipVertical),
+	cache(cache)
+{
+}
+
+/*
+ * Detect chessboards in all images of the list
+ */
+void BatchDetector::run(const vector<string> & imageList,
+						vector<BatchView> & views)
+{
+	Clock::time_point start = Clock::now();
+
+	statistics = BatchStatistics();
+	statistics.images = imageList.size();
+	statistics.workers = pool.size();
+
+	views.assign(imageList.size(), BatchView());
+
+	// the pool may be shared (i.e. by concurrent server jobs) : only wait for
+	// the tasks of this batch instead of ThreadPool::wait
+	mutex batchMutex;
+	condition_variable batchDone;
+	size_t remaining = imageList.size();
+
+	// submit blocks while the pool queue is full so only a bounded number of
+	// images are pending at any time
+	for (size_t i = 0; i < imageList.size(); i++)
+	{
+		const string * filename = &imageList[i];
+		BatchView * view = &views[i];
+		pool.submit([this, filename, view, &batchMutex, &batchDone, &remaining]
+		{
+			try
+			{
+				processImage(*filename, *view);
+			}
+			catch (const exception & e)
+			{
+				fprintf(stderr, "BatchDetector: %s failed: %s\n",
+						filename->c_str(), e.what());
+			}
+
+			lock_guard<mutex> lock(batchMutex);
+			remaining--;
+			if (remaining == 0)
+			{
+				batchDone.notify_all();
+			}
+		});
+	}
+
+	{
+		unique_lock<mutex> lock(batchMutex);
+		batchDone.wait(lock, [&remaining] { return remaining == 0; });
+	}
+
+	statistics.wallTime = secondsSince(start);
+}
+
+/*
+ * Statistics of the last run
+ */
+const BatchStatistics & BatchDetector::getStatistics() const
+{
+	return statistics;
+}
+
+/*
+ * Read and detect a single image (runs on a worker)
+ */
+void BatchDetector::processImage(const string & filename, BatchView & view)
+{
+	double hashTime = 0, readTime = 0, convertTime = 0, findTime = 0,
+		refineTime = 0;
+	Mat image, imageGray;
+	uint64_t contentHash = 0;
+	bool hashed = false;
+
+	Clock::time_point t = Clock::now();
+	if (cache != NULL)
+	{
+		hashed = CornerCache::hashFile(filename, contentHash);
+		hashTime = secondsSince(t);
+		if (hashed &&
+			cache->lookup(contentHash, view.imageSize, view.found, view.corners))
+		{
+			// unchanged image : no decoding nor detection
+			view.loaded = true;
+			lock_guard<mutex> lock(statisticsMutex);
+			statistics.loaded++;
+			statistics.found += view.found ? 1 : 0;
+			statistics.cached++;
+			statistics.hashTime += hashTime;
+			return;
+		}
+	}
+
+	t = Clock::now();
+	image = imread(filename, 1);
+	readTime = secondsSince(t);
+
+	view.loaded = image.data != NULL;
+	if (view.loaded)
+	{
+		view.imageSize = image.size();
+
+		if (flipVertical)
+		{
+			flip(image, image, 0);
+		}
+
+		t = Clock::now();
+		cvtColor(image, imageGray, CV_BGR2GRAY);
+		convertTime = secondsSince(t);
+
+		t = Clock::now();
+		view.found = detector.findCorners(imageGray, view.corners);
+		findTime = secondsSince(t);
+
+		if (view.found)
+		{
+			t = Clock::now();
+			detector.refineCorners(imageGray, view.corners);
+			refineTime = secondsSince(t);
+		}
+		else
+		{
+			view.corners.clear();
+		}
+
+		if (hashed)
+		{
+			cache->insert(contentHash, view.imageSize, view.found, view.corners);
+		}
+	}
+
+	lock_guard<mutex> lock(statisticsMutex);
+	statistics.loaded += view.loaded ? 1 : 0;
+	statistics.found += view.found ? 1 : 0;
+	statistics.hashTime += hashTime;
+	statistics.readTime += readTime;
+	statistics.convertTime += convertTime;
+	statistics.findTime += findTime;
+	statistics.refineTime += refineTime;
+}
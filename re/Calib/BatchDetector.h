@@ -0,0 +1,205 @@
+/*
+ * BatchDetector.h
+ *
+ * Parallel chessboard detection over a list of stored images.
+ */
+
+#ifndef BATCHDETECTOR_H_
+#define BATCHDETECTOR_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include "opencv2/core/core.hpp"
+
+#include "ChessboardDetector.h"
+#include "CornerCache.h"
+#include "ThreadPool.h"
+
+/**
+ * Detection result for one image of the list
+ */
+struct BatchView
+{
+	/**
+	 * Image has been read successfully
+	 */
+	bool loaded;
+
+	/**
+	 * Chessboard has been found in the image
+	 */
+	bool found;
+
+	/**
+	 * Image size
+	 */
+	cv::Size imageSize;
+
+	/**
+	 * Refined chessboard corners (empty if not found)
+	 */
+	std::vector<cv::Point2f> corners;
+
+	/**
+	 * Default constructor : image not loaded
+	 */
+	BatchView();
+};
+
+/**
+ * Batch detection statistics.
+ * Stage times are summed over all images (and therefore over all workers)
+ */
+struct BatchStatistics
+{
+	/**
+	 * Number of images in the list
+	 */
+	size_t images;
+
+	/**
+	 * Number of images successfully read
+	 */
+	size_t loaded;
+
+	/**
+	 * Number of images where the chessboard has been found
+	 */
+	size_t found;
+
+	/**
+	 * Number of images whose detection result came from the corner cache
+	 */
+	size_t cached;
+
+	/**
+	 * Number of workers used
+	 */
+	size_t workers;
+
+	/**
+	 * Elapsed (wall clock) time in seconds
+	 */
+	double wallTime;
+
+	/**
+	 * Time spent hashing image files for the corner cache in seconds
+	 */
+	double hashTime;
+
+	/**
+	 * Time spent reading and decoding images (imread) in seconds
+	 */
+	double readTime;
+
+	/**
+	 * Time spent converting images to gray level (cvtColor) in seconds
+	 */
+	double convertTime;
+
+	/**
+	 * Time spent searching chessboards (findChessboardCorners) in seconds
+	 */
+	double findTime;
+
+	/**
+	 * Time spent refining corners (cornerSubPix) in seconds
+	 */
+	double refineTime;
+
+	/**
+	 * Default constructor : everything set to 0
+	 */
+	BatchStatistics();
+
+	/**
+	 * Print throughput report
+	 * @param out the stream to print to
+	 */
+	void print(FILE * out) const;
+};
+
+/**
+ * Detects chessboards in a list of stored images using a pool of workers.
+ * Each image is read, converted, searched and refined by a single task
+ * submitted to the pool. Results are stored by index so they come back in
+ * the list order regardless of the completion order.
+ * When a corner cache is used, images found in the cache are only hashed and
+ * new results are added to the cache.
+ * The pool may be shared with other batches : a run only waits for its own
+ * tasks.
+ */
+class BatchDetector
+{
+	public:
+		/**
+		 * Constructor
+		 * @param detector the chessboard detector used by all workers
+		 * @param pool the workers pool
+		 * @param flipVertical flip images around the horizontal axis
+		 * before detection
+		 * @param cache the corner cache to look images up in (NULL to
+		 * detect all images)
+		 */
+		BatchDetector(const ChessboardDetector & detector,
+					  ThreadPool & pool,
+					  bool flipVertical = false,
+					  CornerCache * cache = NULL);
+
+		/**
+		 * Detect chessboards in all images of the list
+		 * @param imageList images file names
+		 * @param views detection results in the same order as imageList
+		 */
+		void run(const std::vector<std::string> & imageList,
+				 std::vector<BatchView> & views);
+
+		/**
+		 * Statistics of the last run
+		 * @return the statistics of the last run
+		 */
+		const BatchStatistics & getStatistics() const;
+
+	private:
+		/**
+		 * Read and detect a single image (runs on a worker)
+		 * @param filename the image file name
+		 * @param view the result to fill
+		 */
+		void processImage(const std::string & filename, BatchView & view);
+
+		/**
+		 * Chessboard detector
+		 */
+		const ChessboardDetector & detector;
+
+		/**
+		 * Workers pool
+		 */
+		ThreadPool & pool;
+
+		/**
+		 * Flip images around the horizontal axis
+		 */
+		bool flipVertical;
+
+		/**
+		 * Corner cache (NULL if not used)
+		 */
+		CornerCache * cache;
+
+		/**
+		 * Statistics of the last run
+		 */
+		BatchStatistics statistics;
+
+		/**
+		 * Lock protecting statistics while workers are running
+		 */
+		std::mutex statisticsMutex;
+};
+
+#endif /* BATCHDETECTOR_H_ */
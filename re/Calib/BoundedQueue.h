@@ -0,0 +1,141 @@
+/*
+ * BoundedQueue.h
+ *
+ * Blocking FIFO queue with a fixed capacity shared between producer and
+ * consumer threads.
+ */
+
+#ifndef BOUNDEDQUEUE_H_
+#define BOUNDEDQUEUE_H_
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Blocking FIFO queue with a maximum capacity.
+ * 	- push blocks while the queue is full
+ * 	- pop blocks while the queue is empty
+ * 	- close wakes up everyone : subsequent pushes fail and pops drain the
+ * 	remaining elements before failing
+ * @tparam T the type of queued elements
+ */
+template <typename T>
+class BoundedQueue
+{
+	public:
+		/**
+		 * Constructor
+		 * @param capacity maximum number of elements in the queue (at least 1)
+		 */
+		explicit BoundedQueue(size_t capacity) :
+			maxSize(capacity > 0 ? capacity : 1),
+			closed(false)
+		{
+		}
+
+		/**
+		 * Push an element at the back of the queue, waiting for room if the
+		 * queue is full
+		 * @param element the element to push
+		 * @return true if the element has been queued, false if the queue
+		 * has been closed
+		 */
+		bool push(const T & element)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			notFull.wait(lock, [this] { return closed || elements.size() < maxSize; });
+			if (closed)
+			{
+				return false;
+			}
+			elements.push_back(element);
+			notEmpty.notify_one();
+			return true;
+		}
+
+		/**
+		 * Pop the element at the front of the queue, waiting for one if the
+		 * queue is empty
+		 * @param element the popped element
+		 * @return true if an element has been popped, false if the queue has
+		 * been closed and is empty
+		 */
+		bool pop(T & element)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			notEmpty.wait(lock, [this] { return closed || !elements.empty(); });
+			if (elements.empty())
+			{
+				return false;
+			}
+			element = elements.front();
+			elements.pop_front();
+			notFull.notify_one();
+			return true;
+		}
+
+		/**
+		 * Close the queue : wakes up all waiting producers and consumers
+		 */
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+			notFull.notify_all();
+			notEmpty.notify_all();
+		}
+
+		/**
+		 * Current number of elements in the queue
+		 * @return the number of queued elements
+		 */
+		size_t size() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return elements.size();
+		}
+
+		/**
+		 * Maximum number of elements in the queue
+		 * @return the queue capacity
+		 */
+		size_t capacity() const
+		{
+			return maxSize;
+		}
+
+	private:
+		/**
+		 * Queued elements
+		 */
+		std::deque<T> elements;
+
+		/**
+		 * Maximum number of queued elements
+		 */
+		const size_t maxSize;
+
+		/**
+		 * Closed state
+		 */
+		bool closed;
+
+		/**
+		 * Lock protecting elements and closed state
+		 */
+		mutable std::mutex mutex;
+
+		/**
+		 * Signaled when an element has been popped
+		 */
+		std::condition_variable notFull;
+
+		/**
+		 * Signaled when an element has been pushed
+		 */
+		std::condition_variable notEmpty;
+};
+
+#endif /* BOUNDEDQUEUE_H_ */
@@ -0,0 +1,779 @@
+/*
+ * CalibrationFile.cpp
+ *
+ * Calibration results files : YAML / XML and binary memory mappable format.
+ */
+
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include "CalibrationFile.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Binary calibration file magic number
+ */
+static const char binaryMagic[8] = { 'C', 'A', 'L', 'I', 'B', 'B', 'I', 'N' };
+
+/**
+ * Binary calibration file format version
+ */
+static const uint32_t binaryVersion = 1;
+
+/**
+ * Binary calibration file extension
+ */
+static const string binaryExtension = ".calb";
+
+/**
+ * Sections data alignment in binary files
+ */
+static const size_t sectionAlignment = 8;
+
+/**
+ * Matrix type of each section of binary files (the only types written)
+ */
+static const int sectionTypes[CalibrationFileHeader::NB_SECTIONS] =
+{
+	CV_64FC1,	// CAMERA_MATRIX
+	CV_64FC1,	// DISTORTION
+	CV_32FC1,	// PER_VIEW_ERRORS
+	CV_32FC1,	// EXTRINSICS
+	CV_32FC2	// IMAGE_POINTS
+};
+
+/**
+ * Comment preceding the extrinsic parameters
+ */
+static const char * const extrinsicsComment =
+	"a set of 6-tuples (rotation vector + translation vector) for each view";
+
+/**
+ * Top level keys of the calibration data in YAML / XML files
+ */
+static const char * const calibrationKeys[] =
+{
+	"calibration_time", "nframes", "image_width", "image_height",
+	"board_width", "board_height", "square_size", "aspectRatio", "flags",
+	"camera_matrix", "distortion_coefficients", "avg_reprojection_error",
+	"per_view_reprojection_errors", "extrinsic_parameters", "image_points"
+};
+
+/**
+ * Check if a top level key is part of the calibration data
+ * @param name the key
+ * @return true if the key is read into CalibrationData members
+ */
+static bool isCalibrationKey(const string & name)
+{
+	for (size_t k = 0; k < sizeof(calibrationKeys) / sizeof(calibrationKeys[0]);
+		 k++)
+	{
+		if (name == calibrationKeys[k])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Copy a YAML / XML node and its children to a storage
+ * @param fs the storage to write to
+ * @param name the node name (empty inside a sequence)
+ * @param node the node to copy
+ */
+static void copyNode(FileStorage & fs, const string & name, const FileNode & node)
+{
+	if (!name.empty())
+	{
+		fs << name;
+	}
+
+	if (node.isMap() && !node["dt"].empty() && !node["data"].empty())
+	{
+		// matrix
+		Mat m;
+		node >> m;
+		fs << m;
+	}
+	else if (node.isMap() || node.isSeq())
+	{
+		fs << (node.isMap() ? "{" : "[");
+		for (FileNodeIterator it = node.begin(); it != node.end(); ++it)
+		{
+			FileNode child = *it;
+			copyNode(fs, node.isMap() ? child.name() : string(), child);
+		}
+		fs << (node.isMap() ? "}" : "]");
+	}
+	else if (node.isInt())
+	{
+		fs << (int) node;
+	}
+	else if (node.isReal())
+	{
+		fs << (double) node;
+	}
+	else
+	{
+		fs << (string) node;
+	}
+}
+
+/**
+ * FileStorage elements format of a matrix type
+ * @param type the matrix type
+ * @return the elements format (i.e. "2f" for CV_32FC2)
+ */
+static string elementsFormat(int type)
+{
+	static const char depths[] = "ucwsifd";
+	char dt[8];
+	int channels = CV_MAT_CN(type);
+	if (channels > 1)
+	{
+		sprintf(dt, "%d%c", channels, depths[CV_MAT_DEPTH(type)]);
+	}
+	else
+	{
+		sprintf(dt, "%c", depths[CV_MAT_DEPTH(type)]);
+	}
+	return dt;
+}
+
+/**
+ * Size of a file
+ * @param filename the file name
+ * @return the file size in bytes (0 if the file does not exist)
+ */
+static size_t fileSize(const string & filename)
+{
+	struct stat status;
+	return stat(filename.c_str(), &status) == 0 ? (size_t) status.st_size : 0;
+}
+
+/*
+ * Default constructor : empty calibration
+ */
+CalibrationData::CalibrationData() :
+	nframes(0),
+	imageSize(0, 0),
+	boardSize(0, 0),
+	squareSize(0),
+	aspectRatio(1.f),
+	flags(0),
+	avgReprojectionError(0)
+{
+}
+
+/*
+ * Read a calibration file of either format
+ */
+bool CalibrationData::read(const string & filename)
+{
+	return isBinary(filename) ? readBinary(filename) : readText(filename);
+}
+
+/*
+ * Write a calibration file in the format selected by the file extension
+ */
+bool CalibrationData::write(const string & filename) const
+{
+	if (hasBinaryExtension(filename))
+	{
+		return writeBinary(filename);
+	}
+
+	FileStorage fs(filename, FileStorage::WRITE);
+	if (!fs.isOpened())
+	{
+		return false;
+	}
+	writeText(fs);
+	return true;
+}
+
+/*
+ * Read a YAML / XML calibration file
+ */
+bool CalibrationData::readText(const string & filename)
+{
+	FileStorage fs(filename, FileStorage::READ);
+	if (!fs.isOpened())
+	{
+		return false;
+	}
+
+	*this = CalibrationData();
+	calibrationTime = (string) fs["calibration_time"];
+	fs["nframes"] >> nframes;
+	fs["image_width"] >> imageSize.width;
+	fs["image_height"] >> imageSize.height;
+	fs["board_width"] >> boardSize.width;
+	fs["board_height"] >> boardSize.height;
+	fs["square_size"] >> squareSize;
+	if (!fs["aspectRatio"].empty())
+	{
+		fs["aspectRatio"] >> aspectRatio;
+	}
+	fs["flags"] >> flags;
+	fs["camera_matrix"] >> cameraMatrix;
+	fs["distortion_coefficients"] >> distCoeffs;
+	fs["avg_reprojection_error"] >> avgReprojectionError;
+	fs["per_view_reprojection_errors"] >> perViewErrors;
+	fs["extrinsic_parameters"] >> extrinsics;
+	fs["image_points"] >> imagePoints;
+
+	// a camera matrix without distortion coefficients (i.e. written by
+	// hand) describes a distortion free camera
+	if (!cameraMatrix.empty() && distCoeffs.empty())
+	{
+		distCoeffs = Mat::zeros(5, 1, CV_64F);
+	}
+
+	// other keys (robust calibration, uncertainty ...) are kept as YAML text
+	// so that writeText carries them over
+	FileNode root = fs.root();
+	for (FileNodeIterator it = root.begin(); it != root.end(); ++it)
+	{
+		string name = (*it).name();
+		if (!isCalibrationKey(name))
+		{
+			extraKeys.push_back(name);
+		}
+	}
+	if (!extraKeys.empty())
+	{
+		FileStorage others(".yml", FileStorage::WRITE + FileStorage::MEMORY);
+		for (size_t k = 0; k < extraKeys.size(); k++)
+		{
+			copyNode(others, extraKeys[k], fs[extraKeys[k]]);
+		}
+		extras = others.releaseAndGetString();
+	}
+
+	return !cameraMatrix.empty();
+}
+
+/*
+ * Write the calibration to an opened YAML / XML storage
+ */
+void CalibrationData::writeText(FileStorage & fs) const
+{
+	char buf[1024];
+
+	fs << "calibration_time" << calibrationTime;
+
+	if (nframes > 0)
+	{
+		fs << "nframes" << nframes;
+	}
+	fs << "image_width" << imageSize.width;
+	fs << "image_height" << imageSize.height;
+	fs << "board_width" << boardSize.width;
+	fs << "board_height" << boardSize.height;
+	fs << "square_size" << squareSize;
+
+	if (flags & CV_CALIB_FIX_ASPECT_RATIO)
+		fs << "aspectRatio" << aspectRatio;
+
+	if (flags != 0)
+	{
+		sprintf(buf,
+				"flags: %s%s%s%s",
+				flags & CV_CALIB_USE_INTRINSIC_GUESS ? "+use_intrinsic_guess" : "",
+				flags & CV_CALIB_FIX_ASPECT_RATIO ? "+fix_aspectRatio" : "",
+				flags & CV_CALIB_FIX_PRINCIPAL_POINT ? "+fix_principal_point" : "",
+				flags & CV_CALIB_ZERO_TANGENT_DIST ? "+zero_tangent_dist" : "");
+		cvWriteComment(*fs, buf, 0);
+	}
+
+	fs << "flags" << flags;
+
+	fs << "camera_matrix" << cameraMatrix;
+	fs << "distortion_coefficients" << distCoeffs;
+
+	fs << "avg_reprojection_error" << avgReprojectionError;
+	if (!perViewErrors.empty())
+	{
+		fs << "per_view_reprojection_errors" << perViewErrors;
+	}
+
+	if (!extrinsics.empty())
+	{
+		cvWriteComment(*fs, extrinsicsComment, 0);
+		fs << "extrinsic_parameters" << extrinsics;
+	}
+
+	if (!imagePoints.empty())
+	{
+		fs << "image_points" << imagePoints;
+	}
+
+	if (!extras.empty())
+	{
+		FileStorage others(extras, FileStorage::READ + FileStorage::MEMORY);
+		for (size_t k = 0; k < extraKeys.size(); k++)
+		{
+			copyNode(fs, extraKeys[k], others[extraKeys[k]]);
+		}
+	}
+}
+
+/*
+ * Stream extrinsic parameters to an opened YAML / XML storage
+ */
+void CalibrationData::writeExtrinsics(FileStorage & fs,
+									  const vector<Mat> & rvecs,
+									  const vector<Mat> & tvecs)
+{
+	cvWriteComment(*fs, extrinsicsComment, 0);
+	MatrixRowWriter writer(fs,
+						   "extrinsic_parameters",
+						   (int) rvecs.size(),
+						   6,
+						   CV_32F);
+	for (size_t i = 0; i < rvecs.size(); i++)
+	{
+		float row[6];
+		Mat r(1, 3, CV_32F, row);
+		Mat t(1, 3, CV_32F, row + 3);
+		rvecs[i].reshape(1, 1).convertTo(r, CV_32F);
+		tvecs[i].reshape(1, 1).convertTo(t, CV_32F);
+		writer.write(row);
+	}
+}
+
+/*
+ * Stream image points to an opened YAML / XML storage
+ */
+void CalibrationData::writeImagePoints(
+	FileStorage & fs,
+	const vector<vector<Point2f> > & imagePoints)
+{
+	MatrixRowWriter writer(fs,
+						   "image_points",
+						   (int) imagePoints.size(),
+						   (int) imagePoints[0].size(),
+						   CV_32FC2);
+	for (size_t i = 0; i < imagePoints.size(); i++)
+	{
+		writer.write(&imagePoints[i][0]);
+	}
+}
+
+/*
+ * Read a binary calibration file
+ */
+bool CalibrationData::readBinary(const string & filename)
+{
+	MappedCalibration mapped;
+	if (!mapped.open(filename))
+	{
+		return false;
+	}
+	mapped.copyTo(*this);
+	if (!cameraMatrix.empty() && distCoeffs.empty())
+	{
+		distCoeffs = Mat::zeros(5, 1, CV_64F);
+	}
+	return !cameraMatrix.empty();
+}
+
+/*
+ * Write a binary calibration file
+ */
+bool CalibrationData::writeBinary(const string & filename) const
+{
+	CalibrationFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+	header.version = binaryVersion;
+	header.headerSize = sizeof(header);
+	header.imageWidth = imageSize.width;
+	header.imageHeight = imageSize.height;
+	header.boardWidth = boardSize.width;
+	header.boardHeight = boardSize.height;
+	header.flags = flags;
+	header.nframes = nframes;
+	header.squareSize = squareSize;
+	header.aspectRatio = aspectRatio;
+	header.avgReprojectionError = avgReprojectionError;
+	strncpy(header.calibrationTime,
+			calibrationTime.c_str(),
+			sizeof(header.calibrationTime) - 1);
+
+	// sections in their canonical types, continuous
+	Mat sections[CalibrationFileHeader::NB_SECTIONS];
+	cameraMatrix.convertTo(sections[CalibrationFileHeader::CAMERA_MATRIX],
+						   CV_64F);
+	distCoeffs.convertTo(sections[CalibrationFileHeader::DISTORTION], CV_64F);
+	perViewErrors.convertTo(sections[CalibrationFileHeader::PER_VIEW_ERRORS],
+							CV_32F);
+	extrinsics.convertTo(sections[CalibrationFileHeader::EXTRINSICS], CV_32F);
+	imagePoints.convertTo(sections[CalibrationFileHeader::IMAGE_POINTS],
+						  CV_32F);
+
+	size_t offset = sizeof(header);
+	for (int s = 0; s < CalibrationFileHeader::NB_SECTIONS; s++)
+	{
+		const Mat & m = sections[s];
+		if (m.empty())
+		{
+			continue;
+		}
+		offset = (offset + sectionAlignment - 1) / sectionAlignment *
+			sectionAlignment;
+		header.sections[s].offset = offset;
+		header.sections[s].type = m.type();
+		header.sections[s].rows = m.rows;
+		header.sections[s].cols = m.cols;
+		offset += m.total() * m.elemSize();
+	}
+
+	string temporary = filename + ".tmp";
+	FILE * out = fopen(temporary.c_str(), "wb");
+	if (out == NULL)
+	{
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+	static const char padding[sectionAlignment] = { 0 };
+	offset = sizeof(header);
+	for (int s = 0; ok && s < CalibrationFileHeader::NB_SECTIONS; s++)
+	{
+		const Mat & m = sections[s];
+		if (m.empty())
+		{
+			continue;
+		}
+		size_t pad = header.sections[s].offset - offset;
+		ok = pad == 0 || fwrite(padding, 1, pad, out) == pad;
+		size_t size = m.total() * m.elemSize();
+		ok = ok && fwrite(m.ptr(), 1, size, out) == size;
+		offset = header.sections[s].offset + size;
+	}
+	ok = fclose(out) == 0 && ok;
+
+	if (!ok || rename(temporary.c_str(), filename.c_str()) != 0)
+	{
+		unlink(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Check if a file is a binary calibration file
+ */
+bool CalibrationData::isBinary(const string & filename)
+{
+	FILE * in = fopen(filename.c_str(), "rb");
+	if (in == NULL)
+	{
+		return false;
+	}
+	char magic[sizeof(binaryMagic)];
+	bool binary = fread(magic, sizeof(magic), 1, in) == 1 &&
+		memcmp(magic, binaryMagic, sizeof(binaryMagic)) == 0;
+	fclose(in);
+	return binary;
+}
+
+/*
+ * Check if a file name has the binary calibration extension
+ */
+bool CalibrationData::hasBinaryExtension(const string & filename)
+{
+	return filename.size() >= binaryExtension.size() &&
+		filename.compare(filename.size() - binaryExtension.size(),
+						 binaryExtension.size(),
+						 binaryExtension) == 0;
+}
+
+/*
+ * Compare load times of the same calibration as YAML / XML and as binary
+ */
+void CalibrationData::benchmark(const string & textFilename,
+								const string & binaryFilename,
+								int iterations,
+								FILE * out)
+{
+	if (iterations <= 0)
+	{
+		return;
+	}
+
+	double times[4] = { 0, 0, 0, 0 };
+	double checksum = 0;
+	for (int i = 0; i < iterations; i++)
+	{
+		// full text load
+		Clock::time_point t = Clock::now();
+		CalibrationData text;
+		text.readText(textFilename);
+		times[0] += secondsSince(t);
+		checksum += text.avgReprojectionError;
+
+		// camera matrix only text load (as readCalibrationMatrix)
+		t = Clock::now();
+		{
+			FileStorage fs(textFilename, FileStorage::READ);
+			Mat cameraMatrix;
+			fs["camera_matrix"] >> cameraMatrix;
+			if (!cameraMatrix.empty())
+			{
+				checksum += cameraMatrix.at<double>(0, 0);
+			}
+		}
+		times[1] += secondsSince(t);
+
+		// full binary load
+		t = Clock::now();
+		CalibrationData binary;
+		binary.readBinary(binaryFilename);
+		times[2] += secondsSince(t);
+		checksum += binary.avgReprojectionError;
+
+		// camera matrix only mapped load
+		t = Clock::now();
+		{
+			MappedCalibration mapped;
+			if (mapped.open(binaryFilename))
+			{
+				Mat cameraMatrix =
+					mapped.section(CalibrationFileHeader::CAMERA_MATRIX);
+				checksum += cameraMatrix.at<double>(0, 0);
+			}
+		}
+		times[3] += secondsSince(t);
+	}
+
+	fprintf(out, "Calibration load benchmark (%d loads, checksum %g):\n",
+			iterations, checksum);
+	fprintf(out, "  %-30s %12s %10s\n", "method", "size (bytes)", "time (us)");
+	const char * methods[4] =
+	{
+		"text full load", "text camera matrix",
+		"binary full load", "binary mapped camera matrix"
+	};
+	for (int m = 0; m < 4; m++)
+	{
+		fprintf(out, "  %-30s %12u %10.1f\n",
+				methods[m],
+				(unsigned) fileSize(m < 2 ? textFilename : binaryFilename),
+				1e6 * times[m] / iterations);
+	}
+}
+
+/*
+ * Constructor : starts the matrix node
+ */
+MatrixRowWriter::MatrixRowWriter(FileStorage & fs,
+								 const string & name,
+								 int rows,
+								 int cols,
+								 int type) :
+	fs(fs),
+	cols(cols),
+	dt(elementsFormat(type))
+{
+	cvStartWriteStruct(*fs, name.c_str(), CV_NODE_MAP, "opencv-matrix");
+	cvWriteInt(*fs, "rows", rows);
+	cvWriteInt(*fs, "cols", cols);
+	cvWriteString(*fs, "dt", dt.c_str(), 0);
+	cvStartWriteStruct(*fs, "data", CV_NODE_SEQ + CV_NODE_FLOW);
+}
+
+/*
+ * Destructor : ends the matrix node
+ */
+MatrixRowWriter::~MatrixRowWriter()
+{
+	cvEndWriteStruct(*fs);
+	cvEndWriteStruct(*fs);
+}
+
+/*
+ * Write a row
+ */
+void MatrixRowWriter::write(const void * row)
+{
+	cvWriteRawData(*fs, row, cols, dt.c_str());
+}
+
+/*
+ * Default constructor : nothing mapped
+ */
+MappedCalibration::MappedCalibration() :
+	mapped(NULL),
+	mappedSize(0)
+{
+}
+
+/*
+ * Destructor : unmaps the file
+ */
+MappedCalibration::~MappedCalibration()
+{
+	close();
+}
+
+/*
+ * Map a binary calibration file
+ */
+bool MappedCalibration::open(const string & filename)
+{
+	close();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) != 0 ||
+		(size_t) status.st_size < sizeof(CalibrationFileHeader))
+	{
+		::close(fd);
+		return false;
+	}
+
+	size_t size = status.st_size;
+	void * data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	const CalibrationFileHeader * h = (const CalibrationFileHeader *) data;
+	bool valid = memcmp(h->magic, binaryMagic, sizeof(binaryMagic)) == 0 &&
+		h->version == binaryVersion &&
+		h->headerSize >= sizeof(CalibrationFileHeader) &&
+		h->headerSize <= size;
+
+	// every present section must have its expected type and lie within the
+	// file : sizes are compared to the room left after the offset so that a
+	// corrupt header cannot overflow them
+	for (int s = 0; valid && s < CalibrationFileHeader::NB_SECTIONS; s++)
+	{
+		const CalibrationSection & section = h->sections[s];
+		if (section.offset == 0)
+		{
+			continue;
+		}
+		valid = section.type == sectionTypes[s] &&
+			section.rows > 0 && section.cols > 0 &&
+			section.offset % sectionAlignment == 0 &&
+			section.offset >= h->headerSize &&
+			section.offset <= size &&
+			(uint64_t) section.rows * (uint64_t) section.cols <=
+				(size - section.offset) / CV_ELEM_SIZE(section.type);
+	}
+
+	if (!valid)
+	{
+		munmap(data, size);
+		return false;
+	}
+
+	mapped = (const char *) data;
+	mappedSize = size;
+	return true;
+}
+
+/*
+ * Unmap the file
+ */
+void MappedCalibration::close()
+{
+	if (mapped != NULL)
+	{
+		munmap((void *) mapped, mappedSize);
+		mapped = NULL;
+		mappedSize = 0;
+	}
+}
+
+/*
+ * A file is mapped
+ */
+bool MappedCalibration::isOpened() const
+{
+	return mapped != NULL;
+}
+
+/*
+ * Mapped file header
+ */
+const CalibrationFileHeader & MappedCalibration::header() const
+{
+	return *(const CalibrationFileHeader *) mapped;
+}
+
+/*
+ * Matrix of a section
+ */
+Mat MappedCalibration::section(CalibrationFileHeader::Section section) const
+{
+	if (mapped == NULL)
+	{
+		return Mat();
+	}
+	const CalibrationSection & s = header().sections[section];
+	if (s.offset == 0)
+	{
+		return Mat();
+	}
+	return Mat(s.rows, s.cols, s.type, (void *) (mapped + s.offset));
+}
+
+/*
+ * Copy the mapped calibration
+ */
+void MappedCalibration::copyTo(CalibrationData & data) const
+{
+	const CalibrationFileHeader & h = header();
+	data.calibrationTime = string(h.calibrationTime,
+								  strnlen(h.calibrationTime,
+										  sizeof(h.calibrationTime)));
+	data.nframes = h.nframes;
+	data.imageSize = Size(h.imageWidth, h.imageHeight);
+	data.boardSize = Size(h.boardWidth, h.boardHeight);
+	data.squareSize = h.squareSize;
+	data.aspectRatio = h.aspectRatio;
+	data.flags = h.flags;
+	data.avgReprojectionError = h.avgReprojectionError;
+	data.cameraMatrix =
+		section(CalibrationFileHeader::CAMERA_MATRIX).clone();
+	data.distCoeffs = section(CalibrationFileHeader::DISTORTION).clone();
+	data.perViewErrors =
+		section(CalibrationFileHeader::PER_VIEW_ERRORS).clone();
+	data.extrinsics = section(CalibrationFileHeader::EXTRINSICS).clone();
+	data.imagePoints = section(CalibrationFileHeader::IMAGE_POINTS).clone();
+}
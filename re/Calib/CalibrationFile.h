@@ -0,0 +1,456 @@
+/*
+ * CalibrationFile.h
+ *
+ * Calibration results files : YAML / XML and binary memory mappable format.
+ */
+
+#ifndef CALIBRATIONFILE_H_
+#define CALIBRATIONFILE_H_
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+/**
+ * Binary calibration file section : a matrix stored at an offset of the
+ * file
+ */
+struct CalibrationSection
+{
+	/**
+	 * Offset of the matrix data from the beginning of the file (8 bytes
+	 * aligned, 0 if the section is absent)
+	 */
+	uint64_t offset;
+
+	/**
+	 * OpenCV matrix type (i.e. CV_64FC1)
+	 */
+	int32_t type;
+
+	/**
+	 * Matrix rows
+	 */
+	int32_t rows;
+
+	/**
+	 * Matrix columns
+	 */
+	int32_t cols;
+
+	/**
+	 * Reserved (0)
+	 */
+	int32_t reserved;
+};
+
+/**
+ * Binary calibration file header, followed by the sections data.
+ * All values are stored in the writer native byte order.
+ */
+struct CalibrationFileHeader
+{
+	/**
+	 * Binary calibration file sections
+	 */
+	enum Section
+	{
+		CAMERA_MATRIX = 0,		//!< 3x3 CV_64FC1 camera matrix
+		DISTORTION,				//!< nx1 CV_64FC1 distortion coefficients
+		PER_VIEW_ERRORS,		//!< nframes x 1 CV_32FC1 per view errors
+		EXTRINSICS,				//!< nframes x 6 CV_32FC1 extrinsic parameters
+		IMAGE_POINTS,			//!< nframes x points CV_32FC2 image points
+		NB_SECTIONS
+	};
+
+	/**
+	 * Magic number ("CALIBBIN")
+	 */
+	char magic[8];
+
+	/**
+	 * Format version
+	 */
+	uint32_t version;
+
+	/**
+	 * Header size in bytes : newer versions may only append fields
+	 */
+	uint32_t headerSize;
+
+	/**
+	 * Calibrated images width
+	 */
+	int32_t imageWidth;
+
+	/**
+	 * Calibrated images height
+	 */
+	int32_t imageHeight;
+
+	/**
+	 * Board width in inner corners
+	 */
+	int32_t boardWidth;
+
+	/**
+	 * Board height in inner corners
+	 */
+	int32_t boardHeight;
+
+	/**
+	 * OpenCV calibration flags
+	 */
+	int32_t flags;
+
+	/**
+	 * Number of views (0 if unknown)
+	 */
+	int32_t nframes;
+
+	/**
+	 * Board square size
+	 */
+	float squareSize;
+
+	/**
+	 * Fixed aspect ratio (meaningful with CV_CALIB_FIX_ASPECT_RATIO)
+	 */
+	float aspectRatio;
+
+	/**
+	 * Average reprojection error
+	 */
+	double avgReprojectionError;
+
+	/**
+	 * Calibration date (nul terminated)
+	 */
+	char calibrationTime[64];
+
+	/**
+	 * Sections table
+	 */
+	CalibrationSection sections[NB_SECTIONS];
+};
+
+/**
+ * Calibration result : the content of a calibration output file.
+ * Results are either written as YAML / XML through FileStorage (the
+ * historical format) or in a compact binary format : a fixed size header
+ * (see CalibrationFileHeader) holding scalar values and the offset of each
+ * matrix, matrices data following the header. Binary files are recognized
+ * by their magic number, and are written when the file name has the .calb
+ * extension.
+ */
+struct CalibrationData
+{
+	/**
+	 * Default constructor : empty calibration
+	 */
+	CalibrationData();
+
+	/**
+	 * Read a calibration file of either format
+	 * @param filename the file name
+	 * @return true if the camera matrix was read (see readText for missing
+	 * distortion coefficients)
+	 */
+	bool read(const std::string & filename);
+
+	/**
+	 * Write a calibration file in the format selected by the file
+	 * extension
+	 * @param filename the file name
+	 * @return true if the file was written
+	 */
+	bool write(const std::string & filename) const;
+
+	/**
+	 * Read a YAML / XML calibration file. Missing distortion coefficients
+	 * are read as 5 zero coefficients.
+	 * @param filename the file name
+	 * @return true if the camera matrix was read
+	 */
+	bool readText(const std::string & filename);
+
+	/**
+	 * Write the calibration to an opened YAML / XML storage, other values
+	 * can be appended afterwards
+	 * @param fs the opened storage
+	 */
+	void writeText(cv::FileStorage & fs) const;
+
+	/**
+	 * Stream extrinsic parameters to an opened YAML / XML storage in the
+	 * layout of the extrinsics matrix written by writeText, one view at a
+	 * time
+	 * @param fs the opened storage
+	 * @param rvecs rotation vector of each view
+	 * @param tvecs translation vector of each view
+	 */
+	static void writeExtrinsics(cv::FileStorage & fs,
+								const std::vector<cv::Mat> & rvecs,
+								const std::vector<cv::Mat> & tvecs);
+
+	/**
+	 * Stream image points to an opened YAML / XML storage in the layout of
+	 * the image points matrix written by writeText, one view at a time
+	 * @param fs the opened storage
+	 * @param imagePoints image points of each view (all views must have
+	 * the same number of points)
+	 */
+	static void writeImagePoints(
+		cv::FileStorage & fs,
+		const std::vector<std::vector<cv::Point2f> > & imagePoints);
+
+	/**
+	 * Read a binary calibration file
+	 * @param filename the file name
+	 * @return true if the file is a valid binary calibration file
+	 */
+	bool readBinary(const std::string & filename);
+
+	/**
+	 * Write a binary calibration file
+	 * @param filename the file name
+	 * @return true if the file was written
+	 */
+	bool writeBinary(const std::string & filename) const;
+
+	/**
+	 * Check if a file is a binary calibration file
+	 * @param filename the file name
+	 * @return true if the file starts with the binary magic number
+	 */
+	static bool isBinary(const std::string & filename);
+
+	/**
+	 * Check if a file name has the binary calibration extension
+	 * @param filename the file name
+	 * @return true if filename ends with .calb
+	 */
+	static bool hasBinaryExtension(const std::string & filename);
+
+	/**
+	 * Compare load times of the same calibration as YAML / XML and as
+	 * binary : full and camera matrix only loads
+	 * @param textFilename YAML / XML file name
+	 * @param binaryFilename binary file name
+	 * @param iterations number of loads per method
+	 * @param out the stream to print results to
+	 */
+	static void benchmark(const std::string & textFilename,
+						  const std::string & binaryFilename,
+						  int iterations,
+						  FILE * out);
+
+	/**
+	 * Calibration date
+	 */
+	std::string calibrationTime;
+
+	/**
+	 * Number of views (0 if unknown)
+	 */
+	int nframes;
+
+	/**
+	 * Calibrated images size
+	 */
+	cv::Size imageSize;
+
+	/**
+	 * Board size in inner corners
+	 */
+	cv::Size boardSize;
+
+	/**
+	 * Board square size
+	 */
+	float squareSize;
+
+	/**
+	 * Fixed aspect ratio (meaningful with CV_CALIB_FIX_ASPECT_RATIO)
+	 */
+	float aspectRatio;
+
+	/**
+	 * OpenCV calibration flags
+	 */
+	int flags;
+
+	/**
+	 * Camera matrix (3x3 CV_64FC1)
+	 */
+	cv::Mat cameraMatrix;
+
+	/**
+	 * Distortion coefficients (CV_64FC1)
+	 */
+	cv::Mat distCoeffs;
+
+	/**
+	 * Average reprojection error
+	 */
+	double avgReprojectionError;
+
+	/**
+	 * Per view reprojection errors (nframes x 1 CV_32FC1, may be empty)
+	 */
+	cv::Mat perViewErrors;
+
+	/**
+	 * Rotation and translation vectors of each view (nframes x 6 CV_32FC1,
+	 * may be empty)
+	 */
+	cv::Mat extrinsics;
+
+	/**
+	 * Image points of each view (nframes x points CV_32FC2, may be empty)
+	 */
+	cv::Mat imagePoints;
+
+	/**
+	 * Other top level keys read from a YAML / XML file (i.e. robust
+	 * calibration or uncertainty results), in file order
+	 */
+	std::vector<std::string> extraKeys;
+
+	/**
+	 * Other top level nodes as YAML text, written back by writeText. Binary
+	 * files cannot hold them.
+	 */
+	std::string extras;
+};
+
+/**
+ * Matrix written row by row to a YAML / XML storage, in the same layout as
+ * FileStorage << Mat, so that large matrices need not be materialized
+ * before being written. Rows are formatted as soon as they are written.
+ */
+class MatrixRowWriter
+{
+	public:
+		/**
+		 * Constructor : starts the matrix node
+		 * @param fs the opened storage
+		 * @param name the matrix node name
+		 * @param rows number of rows that will be written
+		 * @param cols number of columns
+		 * @param type matrix type (i.e. CV_32FC2)
+		 */
+		MatrixRowWriter(cv::FileStorage & fs,
+						const std::string & name,
+						int rows,
+						int cols,
+						int type);
+
+		/**
+		 * Destructor : ends the matrix node
+		 */
+		~MatrixRowWriter();
+
+		/**
+		 * Write a row
+		 * @param row cols elements of the matrix type
+		 */
+		void write(const void * row);
+
+	private:
+		/**
+		 * Opened storage
+		 */
+		cv::FileStorage & fs;
+
+		/**
+		 * Number of columns
+		 */
+		int cols;
+
+		/**
+		 * Elements format (i.e. "2f")
+		 */
+		std::string dt;
+
+		// Non copyable
+		MatrixRowWriter(const MatrixRowWriter &);
+		MatrixRowWriter & operator =(const MatrixRowWriter &);
+};
+
+/**
+ * Read only memory mapping of a binary calibration file : sections are
+ * accessed in place without parsing nor copy.
+ */
+class MappedCalibration
+{
+	public:
+		/**
+		 * Default constructor : nothing mapped
+		 */
+		MappedCalibration();
+
+		/**
+		 * Destructor : unmaps the file
+		 */
+		~MappedCalibration();
+
+		/**
+		 * Map a binary calibration file
+		 * @param filename the file name
+		 * @return true if the file is a valid binary calibration file
+		 */
+		bool open(const std::string & filename);
+
+		/**
+		 * Unmap the file
+		 */
+		void close();
+
+		/**
+		 * A file is mapped
+		 * @return true if a valid file is mapped
+		 */
+		bool isOpened() const;
+
+		/**
+		 * Mapped file header
+		 * @return the mapped header (only valid while the file is mapped)
+		 */
+		const CalibrationFileHeader & header() const;
+
+		/**
+		 * Matrix of a section
+		 * @param section the section
+		 * @return a matrix header on the mapped data (empty if the section
+		 * is absent, only valid while the file is mapped, must not be
+		 * modified)
+		 */
+		cv::Mat section(CalibrationFileHeader::Section section) const;
+
+		/**
+		 * Copy the mapped calibration
+		 * @param data the calibration to fill
+		 */
+		void copyTo(CalibrationData & data) const;
+
+	private:
+		/**
+		 * Mapped file
+		 */
+		const char * mapped;
+
+		/**
+		 * Mapped file size
+		 */
+		size_t mappedSize;
+
+		// Non copyable
+		MappedCalibration(const MappedCalibration &);
+		MappedCalibration & operator =(const MappedCalibration &);
+};
+
+#endif /* CALIBRATIONFILE_H_ */
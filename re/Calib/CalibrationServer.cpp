@@ -0,0 +1,548 @@
+/*
+ * CalibrationServer.cpp
+ *
+ * Headless calibration server processing jobs from a spool directory.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include "BatchDetector.h"
+#include "CalibrationServer.h"
+#include "ChessboardDetector.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Maximum number of claimed jobs waiting for a runner : further job files
+ * are left in the spool directory until the queue drains
+ */
+static const size_t maxQueuedJobs = 64;
+
+/**
+ * Number of processed jobs kept in the metrics
+ */
+static const size_t maxRecentJobs = 32;
+
+/**
+ * Spool directory polling interval
+ */
+static const chrono::milliseconds pollInterval(500);
+
+/**
+ * Job files extension
+ */
+static const string jobExtension = ".job";
+
+/**
+ * Name of the file stopping the server when it appears in the spool
+ * directory
+ */
+static const string stopFilename = "stop";
+
+/**
+ * Metrics file name in the spool directory
+ */
+static const string metricsFilename = "metrics.yml";
+
+/**
+ * Resolve a file name relative to a directory
+ * @param directory the directory
+ * @param filename the file name
+ * @return filename if it is absolute, directory/filename otherwise
+ */
+static string resolve(const string & directory, const string & filename)
+{
+	if (filename.empty() || filename[0] == '/')
+	{
+		return filename;
+	}
+	return directory + "/" + filename;
+}
+
+volatile sig_atomic_t CalibrationServer::stopRequested = 0;
+
+/*
+ * Default constructor : empty job
+ */
+CalibrationJob::CalibrationJob() :
+	boardSize(0, 0),
+	squareSize(1.f),
+	aspectRatio(1.f),
+	flags(0),
+	flipVertical(false),
+	writeExtrinsics(false),
+	writePoints(false)
+{
+}
+
+/*
+ * Read the job parameters from a job file
+ */
+bool CalibrationJob::read(const string & filename, const string & directory)
+{
+	FileStorage fs(filename, FileStorage::READ);
+	if (!fs.isOpened())
+	{
+		return false;
+	}
+
+	imageList.clear();
+	FileNode images = fs["images"];
+	if (images.isString())
+	{
+		// images list file : its first top level node is the list
+		FileStorage list(resolve(directory, (string) images),
+						 FileStorage::READ);
+		if (!list.isOpened())
+		{
+			return false;
+		}
+		images = list.getFirstTopLevelNode();
+		for (FileNodeIterator it = images.begin(); it != images.end(); ++it)
+		{
+			imageList.push_back(resolve(directory, (string) *it));
+		}
+	}
+	else if (images.isSeq())
+	{
+		for (FileNodeIterator it = images.begin(); it != images.end(); ++it)
+		{
+			imageList.push_back(resolve(directory, (string) *it));
+		}
+	}
+
+	boardSize.width = (int) fs["board_width"];
+	boardSize.height = (int) fs["board_height"];
+	if (!fs["square_size"].empty())
+	{
+		squareSize = (float) fs["square_size"];
+	}
+	flags = 0;
+	if (!fs["aspect_ratio"].empty())
+	{
+		aspectRatio = (float) fs["aspect_ratio"];
+		flags |= CV_CALIB_FIX_ASPECT_RATIO;
+	}
+	if ((int) fs["zero_tangent_dist"] != 0)
+	{
+		flags |= CV_CALIB_ZERO_TANGENT_DIST;
+	}
+	if ((int) fs["fix_principal_point"] != 0)
+	{
+		flags |= CV_CALIB_FIX_PRINCIPAL_POINT;
+	}
+	flipVertical = (int) fs["flip_vertical"] != 0;
+	writeExtrinsics = (int) fs["write_extrinsics"] != 0;
+	writePoints = (int) fs["write_points"] != 0;
+
+	outputFilename = (string) fs["output"];
+	outputFilename = outputFilename.empty() ?
+		directory + "/" + name + "_camera_data.yml" :
+		resolve(directory, outputFilename);
+
+	return !imageList.empty() &&
+		boardSize.width > 0 && boardSize.height > 0 &&
+		squareSize > 0 && aspectRatio > 0;
+}
+
+/*
+ * Default constructor : nothing processed
+ */
+JobRecord::JobRecord() :
+	ok(false),
+	views(0),
+	waitTime(0),
+	detectionTime(0),
+	solveTime(0),
+	latency(0)
+{
+}
+
+/*
+ * Default constructor : nothing processed
+ */
+ServerStatistics::ServerStatistics() :
+	submitted(0),
+	queued(0),
+	running(0),
+	completed(0),
+	failed(0),
+	uptime(0),
+	totalLatency(0),
+	maxLatency(0)
+{
+}
+
+/*
+ * Print queue state, throughput and latencies
+ */
+void ServerStatistics::print(FILE * out) const
+{
+	size_t processed = completed + failed;
+	fprintf(out, "Calibration server: %u jobs submitted, %u queued, %u running, "
+			"%u completed, %u failed in %.1f s\n",
+			(unsigned) submitted,
+			(unsigned) queued,
+			(unsigned) running,
+			(unsigned) completed,
+			(unsigned) failed,
+			uptime);
+	fprintf(out, "  %-22s %10.2f\n", "throughput (jobs/min)",
+			uptime > 0 ? 60.0 * processed / uptime : 0.0);
+	fprintf(out, "  %-22s %10.3f\n", "mean latency (s)",
+			processed > 0 ? totalLatency / processed : 0.0);
+	fprintf(out, "  %-22s %10.3f\n", "max latency (s)", maxLatency);
+}
+
+/*
+ * Write queue state, throughput and recent jobs timings
+ */
+bool ServerStatistics::write(const string & filename) const
+{
+	// same extension so that the format is the same
+	string temporary = filename + ".tmp.yml";
+	{
+		FileStorage fs(temporary, FileStorage::WRITE);
+		if (!fs.isOpened())
+		{
+			return false;
+		}
+
+		size_t processed = completed + failed;
+		fs << "submitted" << (int) submitted;
+		fs << "queue_depth" << (int) queued;
+		fs << "running" << (int) running;
+		fs << "completed" << (int) completed;
+		fs << "failed" << (int) failed;
+		fs << "uptime" << uptime;
+		fs << "throughput_jobs_per_minute" <<
+			(uptime > 0 ? 60.0 * processed / uptime : 0.0);
+		fs << "mean_latency" << (processed > 0 ? totalLatency / processed : 0.0);
+		fs << "max_latency" << maxLatency;
+
+		cvWriteComment(*fs, "most recent jobs timings in seconds", 0);
+		fs << "recent_jobs" << "[";
+		for (size_t i = 0; i < recent.size(); i++)
+		{
+			const JobRecord & r = recent[i];
+			fs << "{";
+			fs << "name" << r.name;
+			fs << "ok" << (int) r.ok;
+			fs << "views" << (int) r.views;
+			fs << "wait" << r.waitTime;
+			fs << "detection" << r.detectionTime;
+			fs << "solve" << r.solveTime;
+			fs << "latency" << r.latency;
+			fs << "}";
+		}
+		fs << "]";
+	}
+	return rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+/*
+ * Constructor
+ */
+CalibrationServer::CalibrationServer(const string & spoolDirectory,
+									 ThreadPool & pool,
+									 size_t nbRunners,
+									 int findFlags,
+									 int pyramidLevel,
+									 const Solver & solver) :
+	directory(spoolDirectory),
+	pool(pool),
+	nbRunners(std::max(nbRunners, (size_t) 1)),
+	findFlags(findFlags),
+	pyramidLevel(pyramidLevel),
+	solver(solver),
+	jobs(maxQueuedJobs)
+{
+}
+
+/*
+ * Serve jobs until stopped
+ */
+size_t CalibrationServer::run()
+{
+	start = Clock::now();
+	{
+		lock_guard<mutex> lock(statisticsMutex);
+		statistics = ServerStatistics();
+	}
+
+	for (size_t i = 0; i < nbRunners; i++)
+	{
+		runners.push_back(thread(&CalibrationServer::runnerLoop, this));
+	}
+
+	publish();
+	while (stopRequested == 0)
+	{
+		if (scan())
+		{
+			break;
+		}
+		this_thread::sleep_for(pollInterval);
+	}
+
+	// let runners process the jobs already claimed
+	jobs.close();
+	for (size_t i = 0; i < runners.size(); i++)
+	{
+		runners[i].join();
+	}
+	runners.clear();
+	publish();
+
+	return getStatistics().failed;
+}
+
+/*
+ * Metrics snapshot
+ */
+ServerStatistics CalibrationServer::getStatistics() const
+{
+	lock_guard<mutex> lock(statisticsMutex);
+	ServerStatistics snapshot(statistics);
+	snapshot.uptime = secondsSince(start);
+	return snapshot;
+}
+
+/*
+ * Request all servers to stop
+ */
+void CalibrationServer::requestStop()
+{
+	stopRequested = 1;
+}
+
+/*
+ * Claim and queue the new job files of the spool directory
+ */
+bool CalibrationServer::scan()
+{
+	DIR * dir = opendir(directory.c_str());
+	if (dir == NULL)
+	{
+		fprintf(stderr, "Could not read spool directory %s\n",
+				directory.c_str());
+		return false;
+	}
+
+	bool stop = false;
+	vector<string> names;
+	struct dirent * entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		string name(entry->d_name);
+		if (name == stopFilename)
+		{
+			stop = true;
+		}
+		else if (name.size() > jobExtension.size() &&
+				 name.compare(name.size() - jobExtension.size(),
+							  jobExtension.size(),
+							  jobExtension) == 0)
+		{
+			names.push_back(name);
+		}
+	}
+	closedir(dir);
+
+	if (stop)
+	{
+		unlink(resolve(directory, stopFilename).c_str());
+	}
+
+	// jobs are claimed in file names order
+	sort(names.begin(), names.end());
+	for (size_t i = 0; i < names.size() && jobs.size() < maxQueuedJobs; i++)
+	{
+		CalibrationJob job;
+		job.name = names[i].substr(0, names[i].size() - jobExtension.size());
+		job.filename = resolve(directory, names[i]);
+		job.submitted = Clock::now();
+		if (!mark(job, "running"))
+		{
+			continue;
+		}
+
+		if (!job.read(job.filename, directory))
+		{
+			fprintf(stderr, "Invalid job file %s\n", names[i].c_str());
+			mark(job, "failed");
+			{
+				lock_guard<mutex> lock(statisticsMutex);
+				statistics.submitted++;
+				statistics.failed++;
+			}
+			publish();
+			continue;
+		}
+
+		{
+			lock_guard<mutex> lock(statisticsMutex);
+			statistics.submitted++;
+			statistics.queued++;
+		}
+		jobs.push(job);
+	}
+
+	return stop;
+}
+
+/*
+ * Runner thread : process queued jobs until the queue is closed
+ */
+void CalibrationServer::runnerLoop()
+{
+	CalibrationJob job;
+	while (jobs.pop(job))
+	{
+		JobRecord record;
+		record.name = job.name;
+		record.waitTime = secondsSince(job.submitted);
+		{
+			lock_guard<mutex> lock(statisticsMutex);
+			statistics.queued--;
+			statistics.running++;
+		}
+
+		process(job, record);
+		record.latency = secondsSince(job.submitted);
+		mark(job, record.ok ? "done" : "failed");
+
+		printf("Job %s %s : %u views, wait %.3f s, detection %.3f s, "
+			   "solve %.3f s, latency %.3f s\n",
+			   record.name.c_str(),
+			   record.ok ? "done" : "failed",
+			   (unsigned) record.views,
+			   record.waitTime,
+			   record.detectionTime,
+			   record.solveTime,
+			   record.latency);
+
+		{
+			lock_guard<mutex> lock(statisticsMutex);
+			statistics.running--;
+			if (record.ok)
+			{
+				statistics.completed++;
+			}
+			else
+			{
+				statistics.failed++;
+			}
+			statistics.totalLatency += record.latency;
+			statistics.maxLatency = std::max(statistics.maxLatency,
+											 record.latency);
+			statistics.recent.push_back(record);
+			if (statistics.recent.size() > maxRecentJobs)
+			{
+				statistics.recent.pop_front();
+			}
+		}
+		publish();
+	}
+}
+
+/*
+ * Detect, calibrate and save a job
+ */
+void CalibrationServer::process(const CalibrationJob & job, JobRecord & record)
+{
+	ChessboardDetector detector(job.boardSize, findFlags);
+	detector.setPyramidLevel(pyramidLevel);
+
+	// detections of concurrent jobs share the pool
+	Clock::time_point t = Clock::now();
+	BatchDetector batch(detector, pool, job.flipVertical);
+	vector<BatchView> views;
+	batch.run(job.imageList, views);
+	record.detectionTime = secondsSince(t);
+
+	// collect views in list order
+	Size imageSize;
+	vector<vector<Point2f> > imagePoints;
+	for (size_t i = 0; i < views.size(); i++)
+	{
+		if (!views[i].loaded)
+		{
+			fprintf(stderr, "Job %s : could not read image %s\n",
+					job.name.c_str(), job.imageList[i].c_str());
+			continue;
+		}
+		if (imageSize.area() == 0)
+		{
+			imageSize = views[i].imageSize;
+		}
+		else if (views[i].imageSize != imageSize)
+		{
+			fprintf(stderr, "Job %s : skipping image %s with a different size\n",
+					job.name.c_str(), job.imageList[i].c_str());
+			continue;
+		}
+		if (views[i].found)
+		{
+			imagePoints.push_back(views[i].corners);
+		}
+	}
+	record.views = imagePoints.size();
+
+	if (imagePoints.empty())
+	{
+		fprintf(stderr, "Job %s : no chessboard found, nothing to calibrate\n",
+				job.name.c_str());
+		return;
+	}
+
+	t = Clock::now();
+	record.ok = solver(job, imagePoints, imageSize);
+	record.solveTime = secondsSince(t);
+}
+
+/*
+ * Rename a job file to mark its state
+ */
+bool CalibrationServer::mark(CalibrationJob & job, const char * state)
+{
+	string filename = resolve(directory, job.name + jobExtension + "." + state);
+	if (rename(job.filename.c_str(), filename.c_str()) != 0)
+	{
+		fprintf(stderr, "Could not rename job file %s\n", job.filename.c_str());
+		return false;
+	}
+	job.filename = filename;
+	return true;
+}
+
+/*
+ * Write metrics to the spool directory
+ */
+void CalibrationServer::publish()
+{
+	ServerStatistics snapshot = getStatistics();
+	lock_guard<mutex> lock(statisticsMutex);
+	if (!snapshot.write(resolve(directory, metricsFilename)))
+	{
+		fprintf(stderr, "Could not write server metrics\n");
+	}
+}
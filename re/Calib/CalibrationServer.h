@@ -0,0 +1,392 @@
+/*
+ * CalibrationServer.h
+ *
+ * Headless calibration server processing jobs from a spool directory.
+ */
+
+#ifndef CALIBRATIONSERVER_H_
+#define CALIBRATIONSERVER_H_
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+#include "BoundedQueue.h"
+#include "ThreadPool.h"
+
+/**
+ * Calibration job read from a job file of the spool directory.
+ * A job file is an OpenCV FileStorage (YAML or XML) file with the keys :
+ * 	- images : images file names sequence, or the name of an images list
+ * 	file (as written by imagelist_creator)
+ * 	- board_width, board_height : board size in inner corners
+ * 	- square_size : board square size (optional, 1 by default)
+ * 	- aspect_ratio : fixes the aspect ratio (optional, as -a)
+ * 	- zero_tangent_dist, fix_principal_point : as -zt and -p (optional)
+ * 	- flip_vertical : as -v (optional)
+ * 	- write_extrinsics, write_points : as -oe and -op (optional)
+ * 	- output : output file name (optional, <job>_camera_data.yml in the
+ * 	spool directory by default)
+ * Relative file names are relative to the spool directory.
+ */
+struct CalibrationJob
+{
+	/**
+	 * Default constructor : empty job
+	 */
+	CalibrationJob();
+
+	/**
+	 * Read the job parameters from a job file
+	 * @param filename the job file name
+	 * @param directory the directory relative file names refer to
+	 * @return true if the job file is valid
+	 */
+	bool read(const std::string & filename, const std::string & directory);
+
+	/**
+	 * Job name (job file name without directory and extension)
+	 */
+	std::string name;
+
+	/**
+	 * Current job file name (renamed along the job life cycle)
+	 */
+	std::string filename;
+
+	/**
+	 * Images file names
+	 */
+	std::vector<std::string> imageList;
+
+	/**
+	 * Board size in inner corners
+	 */
+	cv::Size boardSize;
+
+	/**
+	 * Board square size
+	 */
+	float squareSize;
+
+	/**
+	 * Image aspect ratio
+	 */
+	float aspectRatio;
+
+	/**
+	 * OpenCV calibration flags
+	 */
+	int flags;
+
+	/**
+	 * Flip images vertically before detection
+	 */
+	bool flipVertical;
+
+	/**
+	 * Also write extrinsic parameters
+	 */
+	bool writeExtrinsics;
+
+	/**
+	 * Also write image points
+	 */
+	bool writePoints;
+
+	/**
+	 * Output file name
+	 */
+	std::string outputFilename;
+
+	/**
+	 * Time the job was claimed from the spool directory
+	 */
+	std::chrono::steady_clock::time_point submitted;
+};
+
+/**
+ * Timings of a processed job
+ */
+struct JobRecord
+{
+	/**
+	 * Default constructor : nothing processed
+	 */
+	JobRecord();
+
+	/**
+	 * Job name
+	 */
+	std::string name;
+
+	/**
+	 * Job succeeded
+	 */
+	bool ok;
+
+	/**
+	 * Number of views the chessboard was found in
+	 */
+	size_t views;
+
+	/**
+	 * Time spent in the queue in seconds
+	 */
+	double waitTime;
+
+	/**
+	 * Detection time in seconds
+	 */
+	double detectionTime;
+
+	/**
+	 * Calibration and save time in seconds
+	 */
+	double solveTime;
+
+	/**
+	 * Time from claim to completion in seconds
+	 */
+	double latency;
+};
+
+/**
+ * Calibration server metrics
+ */
+struct ServerStatistics
+{
+	/**
+	 * Default constructor : nothing processed
+	 */
+	ServerStatistics();
+
+	/**
+	 * Print queue state, throughput and latencies
+	 * @param out the stream to print to
+	 */
+	void print(FILE * out) const;
+
+	/**
+	 * Write queue state, throughput and recent jobs timings
+	 * @param filename the file to write (replaced atomically)
+	 * @return true if the file was written
+	 */
+	bool write(const std::string & filename) const;
+
+	/**
+	 * Number of jobs claimed
+	 */
+	size_t submitted;
+
+	/**
+	 * Number of claimed jobs waiting for a runner
+	 */
+	size_t queued;
+
+	/**
+	 * Number of jobs being processed
+	 */
+	size_t running;
+
+	/**
+	 * Number of successful jobs
+	 */
+	size_t completed;
+
+	/**
+	 * Number of failed jobs
+	 */
+	size_t failed;
+
+	/**
+	 * Server running time in seconds
+	 */
+	double uptime;
+
+	/**
+	 * Sum of the latencies of processed jobs in seconds
+	 */
+	double totalLatency;
+
+	/**
+	 * Largest latency of processed jobs in seconds
+	 */
+	double maxLatency;
+
+	/**
+	 * Most recent processed jobs, oldest first
+	 */
+	std::deque<JobRecord> recent;
+};
+
+/**
+ * Headless calibration server.
+ * Job files (*.job) dropped in the spool directory are claimed by renaming
+ * them to *.job.running and queued. Jobs runners take jobs from the queue :
+ * chessboards are detected on the shared workers pool, then the solver
+ * callback calibrates and saves results on the runner thread, so that the
+ * solve of a job overlaps with the detection of the next ones. Finished job
+ * files are renamed to *.job.done or *.job.failed.
+ * Job files should be written elsewhere then moved into the spool
+ * directory, so they are never claimed while incomplete.
+ * Metrics are written to metrics.yml in the spool directory after each job.
+ * The server stops when a file named stop appears in the spool directory or
+ * when requestStop is called, after the queued jobs are processed.
+ */
+class CalibrationServer
+{
+	public:
+		/**
+		 * Job solver : calibrates a job from its detected views and saves
+		 * results to the job output file
+		 * @param job the job
+		 * @param imagePoints chessboard corners of the views it was found in
+		 * @param imageSize images size
+		 * @return true if calibration succeeded and was saved
+		 */
+		typedef std::function<bool(
+			const CalibrationJob & job,
+			const std::vector<std::vector<cv::Point2f> > & imagePoints,
+			cv::Size imageSize)> Solver;
+
+		/**
+		 * Constructor
+		 * @param spoolDirectory the directory to take job files from
+		 * @param pool the workers pool shared by the jobs detections
+		 * @param nbRunners number of jobs processed concurrently
+		 * @param findFlags chessboard search flags
+		 * @param pyramidLevel chessboard search pyramid level (see
+		 * ChessboardDetector::setPyramidLevel)
+		 * @param solver the job solver
+		 */
+		CalibrationServer(const std::string & spoolDirectory,
+						  ThreadPool & pool,
+						  size_t nbRunners,
+						  int findFlags,
+						  int pyramidLevel,
+						  const Solver & solver);
+
+		/**
+		 * Serve jobs until stopped
+		 * @return the number of failed jobs
+		 */
+		size_t run();
+
+		/**
+		 * Metrics snapshot
+		 * @return the current metrics
+		 */
+		ServerStatistics getStatistics() const;
+
+		/**
+		 * Request all servers to stop (async signal safe)
+		 */
+		static void requestStop();
+
+	private:
+		/**
+		 * Claim and queue the new job files of the spool directory
+		 * @return true if the stop file was found
+		 */
+		bool scan();
+
+		/**
+		 * Runner thread : process queued jobs until the queue is closed
+		 */
+		void runnerLoop();
+
+		/**
+		 * Detect, calibrate and save a job
+		 * @param job the job
+		 * @param record the job timings
+		 */
+		void process(const CalibrationJob & job, JobRecord & record);
+
+		/**
+		 * Rename a job file to mark its state
+		 * @param job the job
+		 * @param state the new state extension
+		 * @return true if the job file was renamed
+		 */
+		bool mark(CalibrationJob & job, const char * state);
+
+		/**
+		 * Write metrics to the spool directory
+		 */
+		void publish();
+
+		/**
+		 * Spool directory
+		 */
+		std::string directory;
+
+		/**
+		 * Workers pool shared by detections
+		 */
+		ThreadPool & pool;
+
+		/**
+		 * Number of jobs runners
+		 */
+		size_t nbRunners;
+
+		/**
+		 * Chessboard search flags
+		 */
+		int findFlags;
+
+		/**
+		 * Chessboard search pyramid level
+		 */
+		int pyramidLevel;
+
+		/**
+		 * Job solver
+		 */
+		Solver solver;
+
+		/**
+		 * Claimed jobs waiting for a runner
+		 */
+		BoundedQueue<CalibrationJob> jobs;
+
+		/**
+		 * Jobs runners
+		 */
+		std::vector<std::thread> runners;
+
+		/**
+		 * Server start time
+		 */
+		std::chrono::steady_clock::time_point start;
+
+		/**
+		 * Metrics
+		 */
+		ServerStatistics statistics;
+
+		/**
+		 * Metrics (and metrics file) lock
+		 */
+		mutable std::mutex statisticsMutex;
+
+		/**
+		 * Stop requested by requestStop
+		 */
+		static volatile std::sig_atomic_t stopRequested;
+
+		// Non copyable
+		CalibrationServer(const CalibrationServer &);
+		CalibrationServer & operator =(const CalibrationServer &);
+};
+
+#endif /* CALIBRATIONSERVER_H_ */
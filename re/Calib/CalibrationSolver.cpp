@@ -0,0 +1,449 @@
+/*
+ * CalibrationSolver.cpp
+ *
+ * Camera calibration from chessboard views : full and incremental solves.
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include "CalibrationFile.h"
+#include "CalibrationSolver.h"
+#include "ReprojectionEngine.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Termination criteria of the warm started refinement : starting next to the
+ * optimum, the relative parameters update quickly drops below epsilon whereas
+ * calibrateCamera default (DBL_EPSILON) would run all iterations. The cold
+ * comparison solve uses them too.
+ */
+static const TermCriteria warmCriteria(TermCriteria::COUNT + TermCriteria::EPS,
+									   30,
+									   1e-7);
+
+/*
+ * Compute chessboard corners from bordSize and squareSize
+ */
+void calcChessboardCorners(Size boardSize,
+						   float squareSize,
+						   vector<Point3f> & corners)
+{
+	corners.resize(0);
+
+	for (int i = 0; i < boardSize.height; i++)
+	{
+		for (int j = 0; j < boardSize.width; j++)
+		{
+			corners.push_back(
+				Point3f(float(j * squareSize), float(i * squareSize), 0));
+		}
+	}
+}
+
+/*
+ * Compute reprojection errors from calibrated camera
+ */
+double computeReprojectionErrors(
+	const vector<vector<Point3f> > & objectPoints,
+	const vector<vector<Point2f> > & imagePoints,
+	const vector<Mat> & rvecs,
+	const vector<Mat> & tvecs,
+	const Mat & cameraMatrix,
+	const Mat & distCoeffs,
+	vector<float> & perViewErrors)
+{
+	if (objectPoints.empty())
+	{
+		perViewErrors.clear();
+		return 0;
+	}
+
+	// all views show the same chessboard. Robust rejection, view selection
+	// and resampling call this once per trial, possibly from pool workers :
+	// each thread keeps its own engine whose buffers only grow
+	static thread_local ReprojectionEngine engine((vector<Point3f>()));
+	engine.setPattern(objectPoints[0]);
+	engine.setViews(imagePoints);
+	return engine.compute(rvecs,
+						  tvecs,
+						  cameraMatrix,
+						  distCoeffs,
+						  perViewErrors);
+}
+
+/*
+ * Run Calibration procedure
+ */
+bool runCalibration(const vector<vector<Point2f> > & imagePoints,
+					Size imageSize,
+					Size boardSize,
+					float squareSize,
+					float aspectRatio,
+					int flags,
+					Mat & cameraMatrix,
+					Mat & distCoeffs,
+					vector<Mat> & rvecs,
+					vector<Mat> & tvecs,
+					vector<float> & reprojErrs,
+					double & totalAvgErr,
+					bool verbose,
+					const TermCriteria & criteria)
+{
+	cameraMatrix = Mat::eye(3, 3, CV_64F);
+	if (flags & CV_CALIB_FIX_ASPECT_RATIO)
+	{
+		cameraMatrix.at<double>(0, 0) = aspectRatio;
+	}
+
+	distCoeffs = Mat::zeros(8, 1, CV_64F);
+
+	vector<vector<Point3f> > objectPoints(1);
+	calcChessboardCorners(boardSize, squareSize, objectPoints[0]);
+
+	objectPoints.resize(imagePoints.size(), objectPoints[0]);
+
+	double rms = calibrateCamera(objectPoints,
+								 imagePoints,
+								 imageSize,
+								 cameraMatrix,
+								 distCoeffs,
+								 rvecs,
+								 tvecs,
+								 flags | CV_CALIB_FIX_K4 | CV_CALIB_FIX_K5,
+								 criteria);
+	///*|CV_CALIB_FIX_K3*/|CV_CALIB_FIX_K4|CV_CALIB_FIX_K5);
+	if (verbose)
+	{
+		printf("RMS error reported by calibrateCamera: %g\n", rms);
+	}
+
+	bool ok = checkRange(cameraMatrix) && checkRange(distCoeffs);
+
+	totalAvgErr = computeReprojectionErrors(objectPoints,
+											imagePoints,
+											rvecs,
+											tvecs,
+											cameraMatrix,
+											distCoeffs,
+											reprojErrs);
+
+	return ok;
+}
+
+/*
+ * Evaluate intrinsics on views which may not have been used to compute them
+ */
+double evaluateCalibration(const vector<vector<Point2f> > & imagePoints,
+						   Size boardSize,
+						   float squareSize,
+						   const Mat & cameraMatrix,
+						   const Mat & distCoeffs,
+						   vector<float> & perViewErrors)
+{
+	vector<vector<Point3f> > objectPoints(1);
+	calcChessboardCorners(boardSize, squareSize, objectPoints[0]);
+	objectPoints.resize(imagePoints.size(), objectPoints[0]);
+
+	vector<Mat> rvecs(imagePoints.size()), tvecs(imagePoints.size());
+	for (size_t i = 0; i < imagePoints.size(); i++)
+	{
+		solvePnP(objectPoints[i],
+				 imagePoints[i],
+				 cameraMatrix,
+				 distCoeffs,
+				 rvecs[i],
+				 tvecs[i]);
+	}
+
+	return computeReprojectionErrors(objectPoints,
+									 imagePoints,
+									 rvecs,
+									 tvecs,
+									 cameraMatrix,
+									 distCoeffs,
+									 perViewErrors);
+}
+
+/*
+ * Default constructor : empty seed
+ */
+CalibrationSeed::CalibrationSeed() :
+	imageSize(0, 0),
+	boardSize(0, 0),
+	squareSize(0),
+	flags(0)
+{
+}
+
+/*
+ * Read a previous calibration file
+ */
+bool CalibrationSeed::read(const string & filename)
+{
+	CalibrationData data;
+	if (!data.read(filename))
+	{
+		return false;
+	}
+
+	imageSize = data.imageSize;
+	boardSize = data.boardSize;
+	squareSize = data.squareSize;
+	flags = data.flags;
+	cameraMatrix = data.cameraMatrix;
+	distCoeffs = data.distCoeffs;
+
+	if (imageSize.area() == 0 || boardSize.area() == 0)
+	{
+		return false;
+	}
+
+	// image points : one row of CV_32FC2 corners per view
+	const Mat & imagePtMat = data.imagePoints;
+	imagePoints.clear();
+	for (int i = 0; i < imagePtMat.rows; i++)
+	{
+		const Point2f * row = imagePtMat.ptr<Point2f>(i);
+		imagePoints.push_back(vector<Point2f>(row, row + imagePtMat.cols));
+	}
+
+	return true;
+}
+
+/*
+ * Check the seed was computed with the same images and board
+ */
+bool CalibrationSeed::isCompatible(Size imageSize,
+								   Size boardSize,
+								   float squareSize,
+								   FILE * out) const
+{
+	bool compatible = true;
+
+	if (imageSize != this->imageSize)
+	{
+		fprintf(out, "Seed image size %dx%d differs from %dx%d\n",
+				this->imageSize.width, this->imageSize.height,
+				imageSize.width, imageSize.height);
+		compatible = false;
+	}
+	if (boardSize != this->boardSize)
+	{
+		fprintf(out, "Seed board size %dx%d differs from %dx%d\n",
+				this->boardSize.width, this->boardSize.height,
+				boardSize.width, boardSize.height);
+		compatible = false;
+	}
+	if (std::abs(squareSize - this->squareSize) > 1e-6f * squareSize)
+	{
+		fprintf(out, "Seed square size %g differs from %g\n",
+				this->squareSize, squareSize);
+		compatible = false;
+	}
+
+	return compatible;
+}
+
+/*
+ * Default constructor : everything set to 0
+ */
+IncrementalStatistics::IncrementalStatistics() :
+	seedViews(0),
+	newViews(0),
+	newViewsSeedError(0),
+	poseTime(0),
+	refineTime(0),
+	warmError(0),
+	coldSolved(false),
+	coldTime(0),
+	coldError(0),
+	coldMatrixDifference(0)
+{
+}
+
+/*
+ * Print timings and errors of the incremental calibration
+ */
+void IncrementalStatistics::print(FILE * out) const
+{
+	fprintf(out, "Incremental calibration: %u seed views, %u new views\n",
+			(unsigned) seedViews,
+			(unsigned) newViews);
+	fprintf(out, "  new views error with seed intrinsics %.4f px\n",
+			newViewsSeedError);
+	fprintf(out, "  %-22s %10s %12s\n", "stage", "time (s)", "error (px)");
+	fprintf(out, "  %-22s %10.3f %12s\n", "pose estimation", poseTime, "");
+	fprintf(out, "  %-22s %10.3f %12.4f\n", "warm refinement",
+			refineTime, warmError);
+	if (coldSolved)
+	{
+		double warmTime = poseTime + refineTime;
+		fprintf(out, "  %-22s %10.3f %12.4f\n", "cold solve",
+				coldTime, coldError);
+		fprintf(out, "  speed-up x%.2f, camera matrix difference %.2e\n",
+				warmTime > 0 ? coldTime / warmTime : 0.0,
+				coldMatrixDifference);
+	}
+}
+
+/*
+ * Incremental calibration
+ */
+bool runIncrementalCalibration(const CalibrationSeed & seed,
+							   const vector<vector<Point2f> > & newImagePoints,
+							   Size imageSize,
+							   Size boardSize,
+							   float squareSize,
+							   float aspectRatio,
+							   int flags,
+							   bool compareCold,
+							   Mat & cameraMatrix,
+							   Mat & distCoeffs,
+							   vector<vector<Point2f> > & imagePoints,
+							   vector<Mat> & rvecs,
+							   vector<Mat> & tvecs,
+							   vector<float> & reprojErrs,
+							   double & totalAvgErr,
+							   IncrementalStatistics & statistics,
+							   bool verbose)
+{
+	statistics = IncrementalStatistics();
+
+	if (!seed.isCompatible(imageSize, boardSize, squareSize, stderr))
+	{
+		return false;
+	}
+
+	statistics.seedViews = seed.imagePoints.size();
+	statistics.newViews = newImagePoints.size();
+
+	imagePoints = seed.imagePoints;
+	imagePoints.insert(imagePoints.end(),
+					   newImagePoints.begin(),
+					   newImagePoints.end());
+
+	vector<vector<Point3f> > objectPoints(1);
+	calcChessboardCorners(boardSize, squareSize, objectPoints[0]);
+	objectPoints.resize(imagePoints.size(), objectPoints[0]);
+
+	// New views poses with the seed intrinsics. calibrateCamera takes no
+	// extrinsic guess and estimates every pose again, so seed views poses
+	// are not needed here
+	Clock::time_point start = Clock::now();
+	vector<Mat> newRvecs(newImagePoints.size());
+	vector<Mat> newTvecs(newImagePoints.size());
+	for (size_t i = 0; i < newImagePoints.size(); i++)
+	{
+		solvePnP(objectPoints[0],
+				 newImagePoints[i],
+				 seed.cameraMatrix,
+				 seed.distCoeffs,
+				 newRvecs[i],
+				 newTvecs[i]);
+	}
+	statistics.poseTime = secondsSince(start);
+
+	// New views against the seed model : a large error means the new views
+	// do not agree with the previous calibration (moved lens, other camera)
+	if (!newImagePoints.empty())
+	{
+		vector<vector<Point3f> > newObjectPoints(newImagePoints.size(),
+												 objectPoints[0]);
+		vector<float> newErrs;
+		statistics.newViewsSeedError =
+			computeReprojectionErrors(newObjectPoints,
+									  newImagePoints,
+									  newRvecs,
+									  newTvecs,
+									  seed.cameraMatrix,
+									  seed.distCoeffs,
+									  newErrs);
+	}
+
+	// Warm started refinement from the seed intrinsics
+	start = Clock::now();
+	cameraMatrix = seed.cameraMatrix.clone();
+	distCoeffs = Mat::zeros(8, 1, CV_64F);
+	int nbCoeffs = std::min((int) seed.distCoeffs.total(), 8);
+	Mat seedCoeffs = seed.distCoeffs.reshape(1, (int) seed.distCoeffs.total());
+	seedCoeffs.rowRange(0, nbCoeffs).convertTo(distCoeffs.rowRange(0, nbCoeffs),
+											   CV_64F);
+	double rms = calibrateCamera(objectPoints,
+								 imagePoints,
+								 imageSize,
+								 cameraMatrix,
+								 distCoeffs,
+								 rvecs,
+								 tvecs,
+								 flags | CV_CALIB_USE_INTRINSIC_GUESS |
+								 CV_CALIB_FIX_K4 | CV_CALIB_FIX_K5,
+								 warmCriteria);
+	statistics.refineTime = secondsSince(start);
+	if (verbose)
+	{
+		printf("RMS error reported by warm started calibrateCamera: %g\n",
+			   rms);
+	}
+
+	bool ok = checkRange(cameraMatrix) && checkRange(distCoeffs);
+
+	totalAvgErr = computeReprojectionErrors(objectPoints,
+											imagePoints,
+											rvecs,
+											tvecs,
+											cameraMatrix,
+											distCoeffs,
+											reprojErrs);
+	statistics.warmError = totalAvgErr;
+
+	if (compareCold)
+	{
+		Mat coldCameraMatrix, coldDistCoeffs;
+		vector<Mat> coldRvecs, coldTvecs;
+		vector<float> coldErrs;
+
+		// same stopping rule as the warm refinement : the speed-up only
+		// measures the warm start
+		start = Clock::now();
+		runCalibration(imagePoints,
+					   imageSize,
+					   boardSize,
+					   squareSize,
+					   aspectRatio,
+					   flags,
+					   coldCameraMatrix,
+					   coldDistCoeffs,
+					   coldRvecs,
+					   coldTvecs,
+					   coldErrs,
+					   statistics.coldError,
+					   verbose,
+					   warmCriteria);
+		statistics.coldTime = secondsSince(start);
+		statistics.coldSolved = true;
+		statistics.coldMatrixDifference =
+			norm(cameraMatrix, coldCameraMatrix, NORM_INF) /
+			std::max(norm(coldCameraMatrix, NORM_INF), DBL_EPSILON);
+	}
+
+	return ok;
+}
@@ -0,0 +1,348 @@
+/*
+ * CalibrationSolver.h
+ *
+ * Camera calibration from chessboard views : full and incremental solves.
+ */
+
+#ifndef CALIBRATIONSOLVER_H_
+#define CALIBRATIONSOLVER_H_
+
+#include <cfloat>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+/**
+ * Compute chessboard corners from bordSize and squareSize
+ * @param boardSize board size (i.e. [6,8])
+ * @param squareSize square size on the board (i.e. 30 mm)
+ * @param corners inner corner points on the chessboard
+ */
+void calcChessboardCorners(cv::Size boardSize,
+						   float squareSize,
+						   std::vector<cv::Point3f> & corners);
+
+/**
+ * Compute reprojection errors from calibrated camera by comparing reprojected
+ * object points to image extracted points.
+ * All views show the same pattern : errors are computed by a
+ * ReprojectionEngine on objectPoints[0], kept per thread so its buffers are
+ * reused from call to call.
+ * @param objectPoints 3D object points
+ * @param imagePoints 2D image points
+ * @param rvecs rotation vectors
+ * @param tvecs translation vectors
+ * @param cameraMatrix calibrated camera matrix
+ * @param distCoeffs distorsion coefficients
+ * @param perViewErrors RMS reprojection error of each view
+ * @return the RMS reprojection error over all points
+ */
+double computeReprojectionErrors(
+	const std::vector<std::vector<cv::Point3f> > & objectPoints,
+	const std::vector<std::vector<cv::Point2f> > & imagePoints,
+	const std::vector<cv::Mat> & rvecs,
+	const std::vector<cv::Mat> & tvecs,
+	const cv::Mat & cameraMatrix,
+	const cv::Mat & distCoeffs,
+	std::vector<float> & perViewErrors);
+
+/**
+ * Run Calibration procedure
+ * @param imagePoints chessboard image points on all views
+ * @param imageSize image size
+ * @param boardSize board size
+ * @param squareSize square size on the chessboard
+ * @param aspectRatio image aspect ratio
+ * @param flags OpenCV calibration flags.
+ * 	- CV_CALIB_USE_INTRINSIC_GUESS  1
+ * 	- CV_CALIB_FIX_ASPECT_RATIO     2
+ * 	- CV_CALIB_FIX_PRINCIPAL_POINT  4
+ * 	- CV_CALIB_ZERO_TANGENT_DIST    8
+ * 	- CV_CALIB_FIX_FOCAL_LENGTH 16
+ * 	- CV_CALIB_FIX_K1  32
+ * 	- CV_CALIB_FIX_K2  64
+ * 	- CV_CALIB_FIX_K3  128
+ * 	- CV_CALIB_FIX_K4  2048
+ * 	- CV_CALIB_FIX_K5  4096
+ * 	- CV_CALIB_FIX_K6  8192
+ * 	- CV_CALIB_RATIONAL_MODEL 16384
+ * @param cameraMatrix 3x3 camera matrix.
+ * \f[
+ * A = \left(
+ * 	\begin{array}{ccc}
+ * 		f_x & 0 & c_x \\
+ * 		0 & f_y & c_y \\
+ * 		0 & 0 & 1
+ * 	\end{array}
+ * \right)
+ * \f]
+ * @param distCoeffs 1x8 distorsion coefficients vector.
+ * Such as if
+ * \f[
+ * \left(
+ * 	\begin{array}{c}
+ * 		x \\
+ * 		y \\
+ * 		y
+ * 	\end{array}
+ * \right) = R
+ * \left(
+ * 	\begin{array}{c}
+ * 		X \\
+ * 		Y \\
+ * 		Z
+ * 	\end{array}
+ * \right) + t
+ * \f]
+ * \f$x' = \frac{x}{z}\f$
+ *
+ * \f$y' = \frac{y}{z}\f$
+ *
+ * \f$x'' = x' \frac{1+k_1r^2+k_2r^4+k_3r^6}{1+k_4r^2+k_5r^4+k_6r^6}
+ * + 2p_1x'y' + p_2(r^2 + 2x'^2)\f$
+ *
+ * \f$ y'' = y' \frac{1+k_1r^2+k_2r^4+k_3r^6}{1+k_4r^2+k_5r^4+k_6r^6}
+ * + 2p_2x'y' + p_1(r^2 + 2y'^2) \f$ where
+ * \f$ r^2 = x'^2 + y'^2\f$
+ *
+ * \f$u = f_x \cdot x'' + c_x\f$
+ *
+ * \f$v = f_y \cdot y'' + c_y\f$
+ * @param rvecs Rotation vectors for each view
+ * @param tvecs TRanslation vector for each view
+ * @param reprojErrs Points reprojection errors
+ * @param totalAvgErr total average error
+ * @param verbose print the RMS error reported by calibrateCamera
+ * @param criteria calibrateCamera termination criteria (its default ones by
+ * default)
+ * @return true if calibration went right
+ */
+bool runCalibration(const std::vector<std::vector<cv::Point2f> > & imagePoints,
+					cv::Size imageSize,
+					cv::Size boardSize,
+					float squareSize,
+					float aspectRatio,
+					int flags,
+					cv::Mat & cameraMatrix,
+					cv::Mat & distCoeffs,
+					std::vector<cv::Mat> & rvecs,
+					std::vector<cv::Mat> & tvecs,
+					std::vector<float> & reprojErrs,
+					double & totalAvgErr,
+					bool verbose = true,
+					const cv::TermCriteria & criteria =
+						cv::TermCriteria(cv::TermCriteria::COUNT +
+										 cv::TermCriteria::EPS,
+										 30,
+										 DBL_EPSILON));
+
+/**
+ * Evaluate intrinsics on views which may not have been used to compute
+ * them : each view pose is estimated with solvePnP then its reprojection
+ * error is computed
+ * @param imagePoints chessboard image points on the evaluated views
+ * @param boardSize board size
+ * @param squareSize square size on the chessboard
+ * @param cameraMatrix camera matrix
+ * @param distCoeffs distortion coefficients
+ * @param perViewErrors RMS reprojection error of each view
+ * @return the RMS reprojection error over all points
+ */
+double evaluateCalibration(
+	const std::vector<std::vector<cv::Point2f> > & imagePoints,
+	cv::Size boardSize,
+	float squareSize,
+	const cv::Mat & cameraMatrix,
+	const cv::Mat & distCoeffs,
+	std::vector<float> & perViewErrors);
+
+/**
+ * Previous calibration result used to seed an incremental calibration.
+ * Read from a file written by calibration : intrinsics are always required,
+ * cached views need the file to be written with -op (image points).
+ * Extrinsic parameters are not read : the refinement estimates every pose
+ * again.
+ */
+struct CalibrationSeed
+{
+	/**
+	 * Default constructor : empty seed
+	 */
+	CalibrationSeed();
+
+	/**
+	 * Read a previous calibration file (YAML / XML or binary)
+	 * @param filename the calibration file name
+	 * @return true if intrinsics and board description have been read
+	 */
+	bool read(const std::string & filename);
+
+	/**
+	 * Check the seed was computed with the same images and board
+	 * @param imageSize images size of the new views
+	 * @param boardSize board size of the new views
+	 * @param squareSize board square size of the new views
+	 * @param out the stream to report mismatches to
+	 * @return true if the seed can be used with the new views
+	 */
+	bool isCompatible(cv::Size imageSize,
+					  cv::Size boardSize,
+					  float squareSize,
+					  FILE * out) const;
+
+	/**
+	 * Images size
+	 */
+	cv::Size imageSize;
+
+	/**
+	 * Board size (inner corners)
+	 */
+	cv::Size boardSize;
+
+	/**
+	 * Board square size
+	 */
+	float squareSize;
+
+	/**
+	 * Calibration flags
+	 */
+	int flags;
+
+	/**
+	 * Previous camera matrix
+	 */
+	cv::Mat cameraMatrix;
+
+	/**
+	 * Previous distortion coefficients
+	 */
+	cv::Mat distCoeffs;
+
+	/**
+	 * Image points of the previous views
+	 */
+	std::vector<std::vector<cv::Point2f> > imagePoints;
+};
+
+/**
+ * Incremental calibration statistics
+ */
+struct IncrementalStatistics
+{
+	/**
+	 * Default constructor : everything set to 0
+	 */
+	IncrementalStatistics();
+
+	/**
+	 * Print timings and errors of the incremental calibration (and of the
+	 * cold solve if it has been run)
+	 * @param out the stream to print to
+	 */
+	void print(FILE * out) const;
+
+	/**
+	 * Number of views from the seed
+	 */
+	size_t seedViews;
+
+	/**
+	 * Number of new views
+	 */
+	size_t newViews;
+
+	/**
+	 * RMS reprojection error of the new views with the seed intrinsics
+	 */
+	double newViewsSeedError;
+
+	/**
+	 * Time spent estimating new views poses in seconds
+	 */
+	double poseTime;
+
+	/**
+	 * Time spent in the warm started refinement in seconds
+	 */
+	double refineTime;
+
+	/**
+	 * RMS reprojection error after the warm started refinement
+	 */
+	double warmError;
+
+	/**
+	 * A cold solve has been run for comparison
+	 */
+	bool coldSolved;
+
+	/**
+	 * Time spent in the cold solve in seconds (with the termination criteria
+	 * of the warm refinement, so only warm starting is compared)
+	 */
+	double coldTime;
+
+	/**
+	 * RMS reprojection error of the cold solve
+	 */
+	double coldError;
+
+	/**
+	 * Largest relative difference between warm and cold camera matrices
+	 */
+	double coldMatrixDifference;
+};
+
+/**
+ * Incremental calibration : previous views and intrinsics are taken from a
+ * seed, poses are only estimated for the new views (solvePnP with the seed
+ * intrinsics) then all views are refined starting from the seed intrinsics
+ * (CV_CALIB_USE_INTRINSIC_GUESS), which converges in far fewer iterations
+ * than a solve starting from identity.
+ * calibrateCamera re-derives its initial extrinsics from the intrinsic
+ * guess, the new views poses are only used to check them against the seed
+ * model before the refinement.
+ * @param seed previous calibration
+ * @param newImagePoints chessboard image points on the new views
+ * @param imageSize image size
+ * @param boardSize board size
+ * @param squareSize square size on the chessboard
+ * @param aspectRatio image aspect ratio
+ * @param flags OpenCV calibration flags (see runCalibration)
+ * @param compareCold also run the full cold solve on all views to compare
+ * timings and results
+ * @param cameraMatrix refined camera matrix
+ * @param distCoeffs refined distortion coefficients
+ * @param imagePoints image points of all views (seed views then new views)
+ * @param rvecs rotation vectors of all views
+ * @param tvecs translation vectors of all views
+ * @param reprojErrs reprojection errors of all views
+ * @param totalAvgErr total average error
+ * @param statistics incremental calibration timings and errors
+ * @param verbose print the RMS error reported by calibrateCamera
+ * @return true if calibration went right
+ */
+bool runIncrementalCalibration(
+	const CalibrationSeed & seed,
+	const std::vector<std::vector<cv::Point2f> > & newImagePoints,
+	cv::Size imageSize,
+	cv::Size boardSize,
+	float squareSize,
+	float aspectRatio,
+	int flags,
+	bool compareCold,
+	cv::Mat & cameraMatrix,
+	cv::Mat & distCoeffs,
+	std::vector<std::vector<cv::Point2f> > & imagePoints,
+	std::vector<cv::Mat> & rvecs,
+	std::vector<cv::Mat> & tvecs,
+	std::vector<float> & reprojErrs,
+	double & totalAvgErr,
+	IncrementalStatistics & statistics,
+	bool verbose = true);
+
+#endif /* CALIBRATIONSOLVER_H_ */
@@ -0,0 +1,269 @@
+/*
+ * CameraModel.cpp
+ *
+ * Calibrated camera loaded once with its derived data cached, for
+ * in-process use by calibration consumers.
+ */
+
+#include <chrono>
+#include <cmath>
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include "CameraModel.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Unit ray through normalized image coordinates
+ * @param normalized normalized (distortion free) image coordinates
+ * @return the unit ray in the camera frame
+ */
+static Point3f unitRay(const Point2f & normalized)
+{
+	float inverseNorm = 1.f / sqrt(normalized.x * normalized.x +
+								   normalized.y * normalized.y + 1.f);
+	return Point3f(normalized.x * inverseNorm,
+				   normalized.y * inverseNorm,
+				   inverseNorm);
+}
+
+/*
+ * Default constructor : nothing loaded nor built
+ */
+CameraModelStatistics::CameraModelStatistics() :
+	loadTime(0),
+	mapsTime(0),
+	raysTime(0)
+{
+}
+
+/*
+ * Print load and build times
+ */
+void CameraModelStatistics::print(FILE * out) const
+{
+	fprintf(out, "Camera model:\n");
+	fprintf(out, "  %-22s %10s\n", "phase", "time (ms)");
+	fprintf(out, "  %-22s %10.3f\n", "load", 1e3 * loadTime);
+	fprintf(out, "  %-22s %10.3f\n", "undistortion maps", 1e3 * mapsTime);
+	fprintf(out, "  %-22s %10.3f\n", "rays table", 1e3 * raysTime);
+}
+
+/*
+ * Constructor
+ */
+CameraModel::CameraModel(int mapType, int interpolation, double alpha) :
+	alpha(alpha),
+	loaded(false),
+	maps(mapType, interpolation)
+{
+}
+
+/*
+ * Load a calibration file of either format
+ */
+bool CameraModel::load(const string & filename)
+{
+	Clock::time_point start = Clock::now();
+
+	loaded = false;
+	maps.invalidate();
+	rays.release();
+	statistics = CameraModelStatistics();
+
+	if (!calibration.read(filename) ||
+		calibration.imageSize.width <= 0 ||
+		calibration.imageSize.height <= 0)
+	{
+		return false;
+	}
+
+	// calibrations written by other tools may hold float matrices
+	calibration.cameraMatrix.convertTo(calibration.cameraMatrix, CV_64F);
+	calibration.distCoeffs.convertTo(calibration.distCoeffs, CV_64F);
+
+	inverseCameraMatrix = calibration.cameraMatrix.inv();
+	if (alpha < 0)
+	{
+		newCameraMatrix = calibration.cameraMatrix;
+	}
+	else
+	{
+		newCameraMatrix = getOptimalNewCameraMatrix(calibration.cameraMatrix,
+													calibration.distCoeffs,
+													calibration.imageSize,
+													alpha,
+													calibration.imageSize,
+													0);
+	}
+
+	statistics.loadTime = secondsSince(start);
+	loaded = true;
+	return true;
+}
+
+/*
+ * A calibration is loaded
+ */
+bool CameraModel::isLoaded() const
+{
+	return loaded;
+}
+
+/*
+ * Loaded calibration file content
+ */
+const CalibrationData & CameraModel::getCalibration() const
+{
+	return calibration;
+}
+
+/*
+ * Camera matrix
+ */
+const Mat & CameraModel::getCameraMatrix() const
+{
+	return calibration.cameraMatrix;
+}
+
+/*
+ * Distortion coefficients
+ */
+const Mat & CameraModel::getDistCoeffs() const
+{
+	return calibration.distCoeffs;
+}
+
+/*
+ * Calibrated images size
+ */
+Size CameraModel::getImageSize() const
+{
+	return calibration.imageSize;
+}
+
+/*
+ * Inverse camera matrix
+ */
+const Mat & CameraModel::getInverseCameraMatrix() const
+{
+	return inverseCameraMatrix;
+}
+
+/*
+ * Camera matrix of undistorted images
+ */
+const Mat & CameraModel::getNewCameraMatrix() const
+{
+	return newCameraMatrix;
+}
+
+/*
+ * Undistortion maps, built on first call
+ */
+const UndistortMaps & CameraModel::getUndistortMaps() const
+{
+	lock_guard<mutex> lock(derivedMutex);
+	if (maps.empty() && loaded)
+	{
+		Clock::time_point start = Clock::now();
+		maps.update(calibration.cameraMatrix,
+					calibration.distCoeffs,
+					calibration.imageSize,
+					newCameraMatrix);
+		statistics.mapsTime = secondsSince(start);
+	}
+	return maps;
+}
+
+/*
+ * Unit ray of each pixel center, built on first call
+ */
+const Mat & CameraModel::getRays() const
+{
+	lock_guard<mutex> lock(derivedMutex);
+	if (rays.empty() && loaded)
+	{
+		Clock::time_point start = Clock::now();
+		Size size = calibration.imageSize;
+		Mat table(size, CV_32FC3);
+		vector<Point2f> pixels(size.width);
+		vector<Point2f> normalized;
+
+		// one row at a time to bound the temporary points
+		for (int y = 0; y < size.height; y++)
+		{
+			for (int x = 0; x < size.width; x++)
+			{
+				pixels[x] = Point2f((float) x, (float) y);
+			}
+			undistortPoints(pixels,
+							normalized,
+							calibration.cameraMatrix,
+							calibration.distCoeffs);
+			Point3f * row = table.ptr<Point3f>(y);
+			for (int x = 0; x < size.width; x++)
+			{
+				row[x] = unitRay(normalized[x]);
+			}
+		}
+
+		rays = table;
+		statistics.raysTime = secondsSince(start);
+	}
+	return rays;
+}
+
+/*
+ * Undistort an image
+ */
+void CameraModel::undistort(const Mat & src, Mat & dst, int bands) const
+{
+	getUndistortMaps().apply(src, dst, bands);
+}
+
+/*
+ * Back project distorted pixels to unit rays in the camera frame
+ */
+void CameraModel::backProject(const vector<Point2f> & pixels,
+							  vector<Point3f> & rays) const
+{
+	rays.resize(pixels.size());
+	if (pixels.empty())
+	{
+		return;
+	}
+
+	vector<Point2f> normalized;
+	undistortPoints(pixels,
+					normalized,
+					calibration.cameraMatrix,
+					calibration.distCoeffs);
+	for (size_t i = 0; i < pixels.size(); i++)
+	{
+		rays[i] = unitRay(normalized[i]);
+	}
+}
+
+/*
+ * Load and build times
+ */
+CameraModelStatistics CameraModel::getStatistics() const
+{
+	lock_guard<mutex> lock(derivedMutex);
+	return statistics;
+}
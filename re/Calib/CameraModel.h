@@ -0,0 +1,219 @@
+/*
+ * CameraModel.h
+ *
+ * Calibrated camera loaded once with its derived data cached, for
+ * in-process use by calibration consumers.
+ */
+
+#ifndef CAMERAMODEL_H_
+#define CAMERAMODEL_H_
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "CalibrationFile.h"
+#include "UndistortMaps.h"
+
+/**
+ * Camera model loading and derived data build times
+ */
+struct CameraModelStatistics
+{
+	/**
+	 * Default constructor : nothing loaded nor built
+	 */
+	CameraModelStatistics();
+
+	/**
+	 * Print load and build times
+	 * @param out the stream to print to
+	 */
+	void print(FILE * out) const;
+
+	/**
+	 * Calibration file load time in seconds
+	 */
+	double loadTime;
+
+	/**
+	 * Undistortion maps build time in seconds (0 if not built)
+	 */
+	double mapsTime;
+
+	/**
+	 * Rays table build time in seconds (0 if not built)
+	 */
+	double raysTime;
+};
+
+/**
+ * Calibrated camera : a calibration file (YAML / XML or binary) loaded once
+ * with the data derived from it cached :
+ * 	- inverse camera matrix, computed on load
+ * 	- undistortion maps, built on first use
+ * 	- unit ray of each pixel center, built on first use
+ * Once loaded, all accessors are const and may be called concurrently from
+ * any number of threads : derived data are built at most once under a lock
+ * and never modified afterwards. Loading is not thread safe and invalidates
+ * every reference previously obtained.
+ */
+class CameraModel
+{
+	public:
+		/**
+		 * Constructor
+		 * @param mapType undistortion maps format (CV_16SC2, CV_32FC1 or
+		 * CV_32FC2)
+		 * @param interpolation undistortion remap interpolation method
+		 * @param alpha free scaling of undistorted images between 0 (only
+		 * valid pixels) and 1 (all source pixels), the camera matrix is kept
+		 * if negative
+		 */
+		CameraModel(int mapType = CV_16SC2,
+					int interpolation = cv::INTER_LINEAR,
+					double alpha = -1);
+
+		/**
+		 * Load a calibration file of either format. Not thread safe.
+		 * @param filename the file name
+		 * @return true if the file holds a camera matrix, distortion
+		 * coefficients and image size
+		 */
+		bool load(const std::string & filename);
+
+		/**
+		 * A calibration is loaded
+		 * @return true if a valid calibration is loaded
+		 */
+		bool isLoaded() const;
+
+		/**
+		 * Loaded calibration file content
+		 * @return the loaded calibration
+		 */
+		const CalibrationData & getCalibration() const;
+
+		/**
+		 * Camera matrix
+		 * @return the 3x3 CV_64FC1 camera matrix
+		 */
+		const cv::Mat & getCameraMatrix() const;
+
+		/**
+		 * Distortion coefficients
+		 * @return the CV_64FC1 distortion coefficients
+		 */
+		const cv::Mat & getDistCoeffs() const;
+
+		/**
+		 * Calibrated images size
+		 * @return the calibrated images size
+		 */
+		cv::Size getImageSize() const;
+
+		/**
+		 * Inverse camera matrix : maps homogeneous pixel coordinates of an
+		 * undistorted image to normalized coordinates
+		 * @return the 3x3 CV_64FC1 inverse camera matrix
+		 */
+		const cv::Mat & getInverseCameraMatrix() const;
+
+		/**
+		 * Camera matrix of undistorted images
+		 * @return the 3x3 CV_64FC1 undistorted images camera matrix
+		 */
+		const cv::Mat & getNewCameraMatrix() const;
+
+		/**
+		 * Undistortion maps, built on first call
+		 * @return the undistortion maps
+		 */
+		const UndistortMaps & getUndistortMaps() const;
+
+		/**
+		 * Unit ray of each pixel center in the camera frame (distortion
+		 * removed), built on first call
+		 * @return the image sized CV_32FC3 rays table
+		 */
+		const cv::Mat & getRays() const;
+
+		/**
+		 * Undistort an image
+		 * @param src distorted image (of the calibrated size)
+		 * @param dst undistorted image (must not be src)
+		 * @param bands number of row bands remapped concurrently
+		 */
+		void undistort(const cv::Mat & src, cv::Mat & dst, int bands = 1) const;
+
+		/**
+		 * Back project distorted pixels to unit rays in the camera frame
+		 * @param pixels pixel coordinates in distorted images
+		 * @param rays unit ray of each pixel
+		 */
+		void backProject(const std::vector<cv::Point2f> & pixels,
+						 std::vector<cv::Point3f> & rays) const;
+
+		/**
+		 * Load and build times
+		 * @return load and build times so far
+		 */
+		CameraModelStatistics getStatistics() const;
+
+	private:
+		/**
+		 * Free scaling of undistorted images (camera matrix kept if
+		 * negative)
+		 */
+		double alpha;
+
+		/**
+		 * Loaded calibration
+		 */
+		CalibrationData calibration;
+
+		/**
+		 * A valid calibration is loaded
+		 */
+		bool loaded;
+
+		/**
+		 * Inverse camera matrix
+		 */
+		cv::Mat inverseCameraMatrix;
+
+		/**
+		 * Undistorted images camera matrix
+		 */
+		cv::Mat newCameraMatrix;
+
+		/**
+		 * Lock on lazily built data and statistics
+		 */
+		mutable std::mutex derivedMutex;
+
+		/**
+		 * Undistortion maps (empty until first use)
+		 */
+		mutable UndistortMaps maps;
+
+		/**
+		 * Rays table (empty until first use)
+		 */
+		mutable cv::Mat rays;
+
+		/**
+		 * Load and build times
+		 */
+		mutable CameraModelStatistics statistics;
+
+		// Non copyable
+		CameraModel(const CameraModel &);
+		CameraModel & operator =(const CameraModel &);
+};
+
+#endif /* CAMERAMODEL_H_ */
@@ -0,0 +1,186 @@
+/*
+ * ChessboardDetector.cpp
+ *
+ * Chessboard inner corners detection and sub-pixel refinement.
+ */
+
+#include <algorithm>
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "ChessboardDetector.h"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Minimum square size (in pixels) on the searched pyramid level in automatic
+ * mode
+ */
+static const float minCoarseSquareSize = 10.f;
+
+/**
+ * Minimum image size (in pixels) of the searched pyramid level in automatic
+ * mode
+ */
+static const int minCoarseImageSize = 240;
+
+/*
+ * Constructor
+ */
+ChessboardDetector::ChessboardDetector(Size boardSize, int findFlags) :
+	boardSize(boardSize),
+	findFlags(findFlags),
+	pyramidLevel(0),
+	subPixWindow(11, 11),
+	subPixCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1)
+{
+}
+
+/*
+ * Board size accessor
+ */
+Size ChessboardDetector::getBoardSize() const
+{
+	return boardSize;
+}
+
+/*
+ * Set the pyramid level on which the board is searched
+ */
+void ChessboardDetector::setPyramidLevel(int level)
+{
+	pyramidLevel = level < 0 ? AUTO_PYRAMID_LEVEL : level;
+}
+
+/*
+ * Pyramid level setting
+ */
+int ChessboardDetector::getPyramidLevel() const
+{
+	return pyramidLevel;
+}
+
+/*
+ * findChessboardCorners flags accessor
+ */
+int ChessboardDetector::getFindFlags() const
+{
+	return findFlags;
+}
+
+/*
+ * cornerSubPix window accessor
+ */
+Size ChessboardDetector::getSubPixWindow() const
+{
+	return subPixWindow;
+}
+
+/*
+ * cornerSubPix termination criteria accessor
+ */
+TermCriteria ChessboardDetector::getSubPixCriteria() const
+{
+	return subPixCriteria;
+}
+
+/*
+ * Pyramid level used to search a board in an image of a given size.
+ */
+int ChessboardDetector::pyramidLevelFor(Size imageSize) const
+{
+	if (pyramidLevel != AUTO_PYRAMID_LEVEL)
+	{
+		return pyramidLevel;
+	}
+
+	int minDim = std::min(imageSize.width, imageSize.height);
+	int maxSquares = std::max(boardSize.width, boardSize.height) + 1;
+	float squareSize = minDim / (3.f * maxSquares);
+
+	int level = 0;
+	while (squareSize / (2 << level) >= minCoarseSquareSize &&
+		   minDim / (2 << level) >= minCoarseImageSize)
+	{
+		level++;
+	}
+
+	return level;
+}
+
+/*
+ * Search for the chessboard inner corners in an image
+ */
+bool ChessboardDetector::findCorners(const Mat & viewGray,
+									 vector<Point2f> & corners) const
+{
+	int level = pyramidLevelFor(viewGray.size());
+	if (level == 0)
+	{
+		return findChessboardCorners(viewGray, boardSize, corners, findFlags);
+	}
+
+	vector<Mat> pyramid(level + 1);
+	pyramid[0] = viewGray;
+	for (int l = 1; l <= level; l++)
+	{
+		pyrDown(pyramid[l - 1], pyramid[l]);
+	}
+
+	if (!findChessboardCorners(pyramid[level], boardSize, corners, findFlags))
+	{
+		return false;
+	}
+
+	// Bring corners back to full resolution one level at a time, refining
+	// them on each intermediate level so that the full resolution refinement
+	// starts within a pixel or so of the solution.
+	TermCriteria coarseCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 10, 0.05);
+	for (int l = level - 1; l >= 0; l--)
+	{
+		for (size_t i = 0; i < corners.size(); i++)
+		{
+			// pyrDown centers pixel x of level l+1 on pixel 2x of level l
+			corners[i].x *= 2.f;
+			corners[i].y *= 2.f;
+		}
+		if (l > 0)
+		{
+			cornerSubPix(pyramid[l],
+						 corners,
+						 Size(5, 5),
+						 Size(-1, -1),
+						 coarseCriteria);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Refine corners coordinates to sub-pixel accuracy
+ */
+void ChessboardDetector::refineCorners(const Mat & viewGray,
+									   vector<Point2f> & corners) const
+{
+	cornerSubPix(viewGray, corners, subPixWindow, Size(-1, -1), subPixCriteria);
+}
+
+/*
+ * Search then refine chessboard corners in an image
+ */
+bool ChessboardDetector::detect(const Mat & viewGray,
+								vector<Point2f> & corners) const
+{
+	bool found = findCorners(viewGray, corners);
+
+	// improve the found corners' coordinate accuracy
+	if (found)
+	{
+		refineCorners(viewGray, corners);
+	}
+
+	return found;
+}
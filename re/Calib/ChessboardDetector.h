@@ -0,0 +1,147 @@
+/*
+ * ChessboardDetector.h
+ *
+ * Chessboard inner corners detection and sub-pixel refinement.
+ */
+
+#ifndef CHESSBOARDDETECTOR_H_
+#define CHESSBOARDDETECTOR_H_
+
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+/**
+ * Chessboard inner corners detector.
+ * Detection is split in two stages so that each one can be timed or run
+ * separately :
+ * 	- findCorners searches the board in the image (findChessboardCorners)
+ * 	- refineCorners improves corners accuracy (cornerSubPix)
+ * When a pyramid level is set, findCorners searches the board on a decimated
+ * version of the image, then brings corners back to full resolution level by
+ * level, so that refineCorners still works at full resolution.
+ * A detector holds no state besides its settings so a single instance can be
+ * shared by several threads.
+ */
+class ChessboardDetector
+{
+	public:
+		/**
+		 * Automatic pyramid level selection
+		 * @see setPyramidLevel
+		 */
+		static const int AUTO_PYRAMID_LEVEL = -1;
+
+		/**
+		 * Constructor
+		 * @param boardSize board size (in inner corners numbers)
+		 * @param findFlags flags used by findChessboardCorners
+		 */
+		ChessboardDetector(cv::Size boardSize, int findFlags);
+
+		/**
+		 * Board size accessor
+		 * @return the board size (in inner corners numbers)
+		 */
+		cv::Size getBoardSize() const;
+
+		/**
+		 * Set the pyramid level on which the board is searched
+		 * @param level the pyramid level : 0 searches the full resolution
+		 * image, n searches the image decimated n times by 2, and
+		 * AUTO_PYRAMID_LEVEL chooses the level from image and board sizes
+		 * @see pyramidLevelFor
+		 */
+		void setPyramidLevel(int level);
+
+		/**
+		 * Pyramid level setting
+		 * @return the pyramid level setting (may be AUTO_PYRAMID_LEVEL)
+		 */
+		int getPyramidLevel() const;
+
+		/**
+		 * findChessboardCorners flags accessor
+		 * @return the findChessboardCorners flags
+		 */
+		int getFindFlags() const;
+
+		/**
+		 * cornerSubPix window accessor
+		 * @return half of the cornerSubPix search window size
+		 */
+		cv::Size getSubPixWindow() const;
+
+		/**
+		 * cornerSubPix termination criteria accessor
+		 * @return the cornerSubPix termination criteria
+		 */
+		cv::TermCriteria getSubPixCriteria() const;
+
+		/**
+		 * Pyramid level used to search a board in an image of a given size.
+		 * In automatic mode, the board is assumed to span at least a third of
+		 * the smallest image dimension and the coarsest level keeping
+		 * squares of at least 10 pixels and images of at least 240 pixels is
+		 * chosen.
+		 * @param imageSize the full resolution image size
+		 * @return the pyramid level to search
+		 */
+		int pyramidLevelFor(cv::Size imageSize) const;
+
+		/**
+		 * Search for the chessboard inner corners in an image
+		 * @param viewGray the gray level image to search
+		 * @param corners the detected corners (in full resolution
+		 * coordinates)
+		 * @return true if all corners have been found, false otherwise
+		 */
+		bool findCorners(const cv::Mat & viewGray,
+						 std::vector<cv::Point2f> & corners) const;
+
+		/**
+		 * Refine corners coordinates to sub-pixel accuracy
+		 * @param viewGray gray level image in which corners have been found
+		 * @param corners the corners to refine
+		 */
+		void refineCorners(const cv::Mat & viewGray,
+						   std::vector<cv::Point2f> & corners) const;
+
+		/**
+		 * Search then refine chessboard corners in an image
+		 * @param viewGray the gray level image to search
+		 * @param corners the detected corners
+		 * @return true if all corners have been found, false otherwise
+		 */
+		bool detect(const cv::Mat & viewGray,
+					std::vector<cv::Point2f> & corners) const;
+
+	private:
+		/**
+		 * Board size (in inner corners numbers)
+		 */
+		cv::Size boardSize;
+
+		/**
+		 * findChessboardCorners flags
+		 */
+		int findFlags;
+
+		/**
+		 * Pyramid level on which the board is searched (or
+		 * AUTO_PYRAMID_LEVEL)
+		 */
+		int pyramidLevel;
+
+		/**
+		 * Half of the search window size used by cornerSubPix
+		 */
+		cv::Size subPixWindow;
+
+		/**
+		 * cornerSubPix termination criteria
+		 */
+		cv::TermCriteria subPixCriteria;
+};
+
+#endif /* CHESSBOARDDETECTOR_H_ */
@@ -0,0 +1,215 @@
+/*
+ * ChessboardTracker.cpp
+ *
+ * Chessboard tracking between successive frames of a live capture.
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/video/tracking.hpp"
+
+#include "ChessboardTracker.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Predicted regions larger than this fraction of the image are not worth a
+ * region search
+ */
+static const double maxRegionRatio = 0.8;
+
+/*
+ * Constructor
+ */
+ChessboardTracker::ChessboardTracker(const ChessboardDetector & detector,
+									 bool useOpticalFlow) :
+	detector(detector),
+	useOpticalFlow(useOpticalFlow),
+	frames(0),
+	regionSearches(0),
+	regionHits(0),
+	fullSearches(0),
+	fullHits(0),
+	regionTime(0),
+	fullTime(0),
+	refineTime(0)
+{
+}
+
+/*
+ * Search then refine chessboard corners in a new frame
+ */
+bool ChessboardTracker::detect(const Mat & viewGray, vector<Point2f> & corners)
+{
+	bool found = false;
+	frames++;
+
+	Clock::time_point start = Clock::now();
+	Rect region = predictRegion(viewGray);
+	if (region.area() > 0)
+	{
+		regionSearches++;
+		found = detector.findCorners(viewGray(region), corners);
+		if (found)
+		{
+			regionHits++;
+			Point2f offset((float) region.x, (float) region.y);
+			for (size_t i = 0; i < corners.size(); i++)
+			{
+				corners[i] += offset;
+			}
+		}
+		regionTime += secondsSince(start);
+	}
+
+	if (!found)
+	{
+		// no previous board or board lost : search the whole frame
+		start = Clock::now();
+		fullSearches++;
+		found = detector.findCorners(viewGray, corners);
+		if (found)
+		{
+			fullHits++;
+		}
+		fullTime += secondsSince(start);
+	}
+
+	if (found)
+	{
+		start = Clock::now();
+		detector.refineCorners(viewGray, corners);
+		refineTime += secondsSince(start);
+		previousCorners = corners;
+	}
+	else
+	{
+		previousCorners.clear();
+	}
+
+	if (useOpticalFlow)
+	{
+		previousGray = viewGray;
+	}
+
+	return found;
+}
+
+/*
+ * Forget previous board
+ */
+void ChessboardTracker::reset()
+{
+	previousCorners.clear();
+	previousGray = Mat();
+}
+
+/*
+ * Print tracking hit rate and detection times
+ */
+void ChessboardTracker::printStatistics(FILE * out) const
+{
+	double total = regionTime + fullTime + refineTime;
+
+	fprintf(out, "Chessboard tracking%s: %lu frames, mean detection time "
+			"%.2f ms/frame\n",
+			useOpticalFlow ? " (optical flow)" : "",
+			frames,
+			frames > 0 ? 1e3 * total / frames : 0.0);
+	fprintf(out, "  region searches %8lu, hit rate %5.1f%%, "
+			"mean %.2f ms\n",
+			regionSearches,
+			regionSearches > 0 ? 100.0 * regionHits / regionSearches : 0.0,
+			regionSearches > 0 ? 1e3 * regionTime / regionSearches : 0.0);
+	fprintf(out, "  full searches   %8lu, found  %5.1f%%, mean %.2f ms\n",
+			fullSearches,
+			fullSearches > 0 ? 100.0 * fullHits / fullSearches : 0.0,
+			fullSearches > 0 ? 1e3 * fullTime / fullSearches : 0.0);
+	fprintf(out, "  refinements     %8lu, mean %.2f ms\n",
+			regionHits + fullHits,
+			regionHits + fullHits > 0 ?
+				1e3 * refineTime / (regionHits + fullHits) : 0.0);
+}
+
+/*
+ * Predict the region where the board should be searched in a new frame
+ */
+Rect ChessboardTracker::predictRegion(const Mat & viewGray) const
+{
+	if (previousCorners.empty())
+	{
+		return Rect();
+	}
+
+	vector<Point2f> predicted = previousCorners;
+	bool propagated = false;
+
+	if (useOpticalFlow && previousGray.size() == viewGray.size())
+	{
+		vector<Point2f> flowed;
+		vector<uchar> status;
+		vector<float> errors;
+		calcOpticalFlowPyrLK(previousGray,
+							 viewGray,
+							 previousCorners,
+							 flowed,
+							 status,
+							 errors);
+
+		vector<Point2f> tracked;
+		for (size_t i = 0; i < flowed.size(); i++)
+		{
+			if (status[i])
+			{
+				tracked.push_back(flowed[i]);
+			}
+		}
+
+		// a few lost corners are fine, the region only needs the board extent
+		if (2 * tracked.size() >= previousCorners.size())
+		{
+			predicted = tracked;
+			propagated = true;
+		}
+	}
+
+	Rect box = boundingRect(predicted);
+	Size boardSize = detector.getBoardSize();
+	int extent = std::max(box.width, box.height);
+	float squareSize =
+		extent / (float) std::max(std::max(boardSize.width, boardSize.height) - 1, 1);
+
+	// outer squares of the board and white border around the inner corners
+	// plus room for the motion between frames (smaller when the flow
+	// already followed the board)
+	int margin = cvRound(1.5f * squareSize +
+						 (propagated ? 0.05f : 0.25f) * extent);
+
+	Rect region(box.x - margin,
+				box.y - margin,
+				box.width + 2 * margin,
+				box.height + 2 * margin);
+	region &= Rect(0, 0, viewGray.cols, viewGray.rows);
+
+	if (region.area() > maxRegionRatio * viewGray.cols * viewGray.rows)
+	{
+		return Rect();
+	}
+
+	return region;
+}
@@ -0,0 +1,129 @@
+/*
+ * ChessboardTracker.h
+ *
+ * Chessboard tracking between successive frames of a live capture.
+ */
+
+#ifndef CHESSBOARDTRACKER_H_
+#define CHESSBOARDTRACKER_H_
+
+#include <cstdio>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+#include "ChessboardDetector.h"
+
+/**
+ * Chessboard tracker.
+ * Once a board has been found, the next frame is only searched in a padded
+ * region around the board predicted from the previous corners (optionally
+ * propagated to the new frame by optical flow). A full frame search is
+ * performed when there is no previous board or when the board is lost in the
+ * predicted region.
+ * A tracker holds the previous frame state so it must be used by a single
+ * thread.
+ */
+class ChessboardTracker
+{
+	public:
+		/**
+		 * Constructor
+		 * @param detector the detector used to search and refine corners
+		 * @param useOpticalFlow propagate previous corners to the new frame
+		 * by optical flow to predict the search region
+		 */
+		ChessboardTracker(const ChessboardDetector & detector,
+						  bool useOpticalFlow = false);
+
+		/**
+		 * Search then refine chessboard corners in a new frame
+		 * @param viewGray the new gray level frame
+		 * @param corners the detected corners
+		 * @return true if all corners have been found, false otherwise
+		 */
+		bool detect(const cv::Mat & viewGray,
+					std::vector<cv::Point2f> & corners);
+
+		/**
+		 * Forget previous board : next frame will be fully searched
+		 */
+		void reset();
+
+		/**
+		 * Print tracking hit rate and detection times
+		 * @param out the stream to print to
+		 */
+		void printStatistics(FILE * out) const;
+
+	private:
+		/**
+		 * Predict the region where the board should be searched in a new frame
+		 * @param viewGray the new gray level frame
+		 * @return the predicted search region (empty if it can not be
+		 * predicted)
+		 */
+		cv::Rect predictRegion(const cv::Mat & viewGray) const;
+
+		/**
+		 * Chessboard detector
+		 */
+		const ChessboardDetector & detector;
+
+		/**
+		 * Use optical flow to predict the search region
+		 */
+		bool useOpticalFlow;
+
+		/**
+		 * Corners found in the previous frame (empty if board was not found)
+		 */
+		std::vector<cv::Point2f> previousCorners;
+
+		/**
+		 * Previous frame (only kept when optical flow is used)
+		 */
+		cv::Mat previousGray;
+
+		/**
+		 * Number of processed frames
+		 */
+		unsigned long frames;
+
+		/**
+		 * Number of searches in a predicted region
+		 */
+		unsigned long regionSearches;
+
+		/**
+		 * Number of boards found in a predicted region
+		 */
+		unsigned long regionHits;
+
+		/**
+		 * Number of full frame searches
+		 */
+		unsigned long fullSearches;
+
+		/**
+		 * Number of boards found by full frame searches
+		 */
+		unsigned long fullHits;
+
+		/**
+		 * Time spent in region searches (including prediction) in seconds
+		 */
+		double regionTime;
+
+		/**
+		 * Time spent in full frame searches in seconds
+		 */
+		double fullTime;
+
+		/**
+		 * Time spent refining corners in seconds
+		 */
+		double refineTime;
+};
+
+#endif /* CHESSBOARDTRACKER_H_ */
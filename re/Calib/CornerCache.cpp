@@ -0,0 +1,384 @@
+/*
+ * CornerCache.cpp
+ *
+ * Persistent cache of chessboard detection results keyed by image content.
+ */
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CornerCache.h"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Cache file magic number
+ */
+static const char cacheMagic[8] = { 'C', 'O', 'R', 'N', 'C', 'A', 'C', 'H' };
+
+/**
+ * Cache file format version (to be increased whenever the layout or the
+ * detection algorithm changes)
+ */
+static const uint32_t cacheVersion = 1;
+
+/**
+ * Cache file header
+ */
+struct CacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t entries;
+};
+
+/**
+ * 64 bits FNV-1a offset basis
+ */
+static const uint64_t fnvOffset = 14695981039346656037ULL;
+
+/**
+ * 64 bits FNV-1a prime
+ */
+static const uint64_t fnvPrime = 1099511628211ULL;
+
+/**
+ * Continue a 64 bits FNV-1a hash over a buffer
+ * @param hash the hash so far
+ * @param data the buffer
+ * @param size the buffer size
+ * @return the updated hash
+ */
+static uint64_t fnv1a(uint64_t hash, const void * data, size_t size)
+{
+	const unsigned char * bytes = (const unsigned char *) data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= fnvPrime;
+	}
+	return hash;
+}
+
+/*
+ * Constructor
+ */
+CornerCache::CornerCache(const string & filename, uint64_t parametersKey) :
+	filename(filename),
+	parametersKey(parametersKey),
+	mapped(NULL),
+	mappedSize(0),
+	hits(0),
+	misses(0)
+{
+}
+
+/*
+ * Destructor : unmaps the cache file
+ */
+CornerCache::~CornerCache()
+{
+	if (mapped != NULL)
+	{
+		munmap((void *) mapped, mappedSize);
+	}
+}
+
+/*
+ * Map the existing cache file
+ */
+bool CornerCache::open()
+{
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) != 0 ||
+		(size_t) status.st_size < sizeof(CacheHeader))
+	{
+		close(fd);
+		return false;
+	}
+
+	mappedSize = status.st_size;
+	void * data = mmap(NULL, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+	mapped = (const char *) data;
+
+	const CacheHeader * header = (const CacheHeader *) mapped;
+	bool valid = memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+		header->version == cacheVersion;
+
+	// index entries in place, a truncated file keeps its complete entries
+	size_t offset = sizeof(CacheHeader);
+	for (uint32_t i = 0; valid && i < header->entries; i++)
+	{
+		if (offset + sizeof(EntryHeader) > mappedSize)
+		{
+			break;
+		}
+		const EntryHeader * entry = (const EntryHeader *) (mapped + offset);
+		size_t entrySize =
+			sizeof(EntryHeader) + entry->nbCorners * sizeof(Point2f);
+		if (offset + entrySize > mappedSize)
+		{
+			break;
+		}
+		mappedEntries[Key(entry->contentHash, entry->parametersKey)] = entry;
+		offset += entrySize;
+	}
+
+	if (!valid)
+	{
+		munmap(data, mappedSize);
+		mapped = NULL;
+		mappedSize = 0;
+	}
+
+	return valid;
+}
+
+/*
+ * Look for the detection result of an image
+ */
+bool CornerCache::lookup(uint64_t contentHash,
+						 Size & imageSize,
+						 bool & found,
+						 vector<Point2f> & corners)
+{
+	Key key(contentHash, parametersKey);
+	lock_guard<mutex> lock(entriesMutex);
+
+	map<Key, Entry>::const_iterator added = newEntries.find(key);
+	if (added != newEntries.end())
+	{
+		imageSize = added->second.imageSize;
+		found = added->second.found;
+		corners = added->second.corners;
+		hits++;
+		return true;
+	}
+
+	map<Key, const EntryHeader *>::const_iterator it = mappedEntries.find(key);
+	if (it != mappedEntries.end())
+	{
+		const EntryHeader * entry = it->second;
+		const Point2f * points = (const Point2f *) (entry + 1);
+		imageSize = Size(entry->width, entry->height);
+		found = entry->found != 0;
+		corners.assign(points, points + entry->nbCorners);
+		hits++;
+		return true;
+	}
+
+	misses++;
+	return false;
+}
+
+/*
+ * Add the detection result of an image
+ */
+void CornerCache::insert(uint64_t contentHash,
+						 Size imageSize,
+						 bool found,
+						 const vector<Point2f> & corners)
+{
+	Entry entry;
+	entry.imageSize = imageSize;
+	entry.found = found;
+	if (found)
+	{
+		entry.corners = corners;
+	}
+
+	lock_guard<mutex> lock(entriesMutex);
+	newEntries[Key(contentHash, parametersKey)] = entry;
+}
+
+/*
+ * Write cached and new entries to the cache file
+ */
+bool CornerCache::save()
+{
+	lock_guard<mutex> lock(entriesMutex);
+
+	string temporary = filename + ".tmp";
+	FILE * out = fopen(temporary.c_str(), "wb");
+	if (out == NULL)
+	{
+		return false;
+	}
+
+	CacheHeader header;
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.entries = 0;
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+
+	// mapped entries are copied as is unless replaced by a new entry
+	for (map<Key, const EntryHeader *>::const_iterator it =
+			 mappedEntries.begin();
+		 ok && it != mappedEntries.end();
+		 ++it)
+	{
+		if (newEntries.count(it->first) > 0)
+		{
+			continue;
+		}
+		size_t entrySize =
+			sizeof(EntryHeader) + it->second->nbCorners * sizeof(Point2f);
+		ok = fwrite(it->second, entrySize, 1, out) == 1;
+		header.entries++;
+	}
+
+	for (map<Key, Entry>::const_iterator it = newEntries.begin();
+		 ok && it != newEntries.end();
+		 ++it)
+	{
+		EntryHeader entry;
+		entry.contentHash = it->first.first;
+		entry.parametersKey = it->first.second;
+		entry.width = it->second.imageSize.width;
+		entry.height = it->second.imageSize.height;
+		entry.found = it->second.found ? 1 : 0;
+		entry.nbCorners = (uint32_t) it->second.corners.size();
+		ok = fwrite(&entry, sizeof(entry), 1, out) == 1;
+		if (ok && entry.nbCorners > 0)
+		{
+			ok = fwrite(&it->second.corners[0],
+						sizeof(Point2f),
+						entry.nbCorners,
+						out) == entry.nbCorners;
+		}
+		header.entries++;
+	}
+
+	// number of entries is only known at the end
+	ok = ok && fseek(out, 0, SEEK_SET) == 0 &&
+		fwrite(&header, sizeof(header), 1, out) == 1;
+	ok = fclose(out) == 0 && ok;
+
+	// the mapping of the replaced file stays valid until unmapped
+	if (!ok || rename(temporary.c_str(), filename.c_str()) != 0)
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Number of cache hits
+ */
+size_t CornerCache::getHits() const
+{
+	lock_guard<mutex> lock(entriesMutex);
+	return hits;
+}
+
+/*
+ * Number of cache misses
+ */
+size_t CornerCache::getMisses() const
+{
+	lock_guard<mutex> lock(entriesMutex);
+	return misses;
+}
+
+/*
+ * Cache file name
+ */
+const string & CornerCache::getFilename() const
+{
+	return filename;
+}
+
+/*
+ * Print cache usage
+ */
+void CornerCache::printStatistics(FILE * out) const
+{
+	lock_guard<mutex> lock(entriesMutex);
+	fprintf(out, "Corner cache %s: %u hits, %u misses, %u cached + %u new "
+			"entries\n",
+			filename.c_str(),
+			(unsigned) hits,
+			(unsigned) misses,
+			(unsigned) mappedEntries.size(),
+			(unsigned) newEntries.size());
+}
+
+/*
+ * Content hash of a file
+ */
+bool CornerCache::hashFile(const string & filename, uint64_t & hash)
+{
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	hash = fnvOffset;
+	size_t size = status.st_size;
+	if (size > 0)
+	{
+		void * data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			close(fd);
+			return false;
+		}
+		madvise(data, size, MADV_SEQUENTIAL);
+		hash = fnv1a(hash, data, size);
+		munmap(data, size);
+	}
+	close(fd);
+
+	return true;
+}
+
+/*
+ * Detection parameters key
+ */
+uint64_t CornerCache::parametersKeyOf(const ChessboardDetector & detector,
+									  bool flipVertical)
+{
+	Size boardSize = detector.getBoardSize();
+	Size subPixWindow = detector.getSubPixWindow();
+	TermCriteria subPixCriteria = detector.getSubPixCriteria();
+	int parameters[] = {
+		boardSize.width,
+		boardSize.height,
+		detector.getFindFlags(),
+		detector.getPyramidLevel(),
+		subPixWindow.width,
+		subPixWindow.height,
+		subPixCriteria.type,
+		subPixCriteria.maxCount,
+		flipVertical ? 1 : 0
+	};
+
+	uint64_t key = fnv1a(fnvOffset, parameters, sizeof(parameters));
+	return fnv1a(key, &subPixCriteria.epsilon, sizeof(subPixCriteria.epsilon));
+}
@@ -0,0 +1,210 @@
+/*
+ * CornerCache.h
+ *
+ * Persistent cache of chessboard detection results keyed by image content.
+ */
+
+#ifndef CORNERCACHE_H_
+#define CORNERCACHE_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+#include "ChessboardDetector.h"
+
+/**
+ * Sidecar cache of detected chessboard corners.
+ * Each entry is keyed by the image file content hash (64 bits FNV-1a) and by
+ * a detection parameters key (board size, find flags, pyramid level,
+ * cornerSubPix parameters, flip) so a modified image or a detection setting
+ * change is a cache miss, whereas renamed or moved images are still hits.
+ * The cache file is memory mapped when opened : entries are read in place
+ * and only new entries are held in memory until the cache is saved.
+ * File layout (native endianness) :
+ * 	- header : "CORNCACH" magic, format version, number of entries
+ * 	- entries : content hash, parameters key, image width and height,
+ * 	found flag, number of corners, then the corners as (x, y) floats
+ * Lookups and insertions can be performed concurrently by several workers.
+ */
+class CornerCache
+{
+	public:
+		/**
+		 * Constructor
+		 * @param filename the cache file name
+		 * @param parametersKey the detection parameters key of this run
+		 * @see parametersKeyOf
+		 */
+		CornerCache(const std::string & filename, uint64_t parametersKey);
+
+		/**
+		 * Destructor : unmaps the cache file (new entries are not saved)
+		 */
+		~CornerCache();
+
+		/**
+		 * Map the existing cache file (if any)
+		 * @return true if the cache file has been mapped, false if there is
+		 * no cache file yet or if it is not a valid cache file (it will then
+		 * be overwritten on save)
+		 */
+		bool open();
+
+		/**
+		 * Look for the detection result of an image
+		 * @param contentHash the image file content hash
+		 * @param imageSize the cached image size
+		 * @param found the cached detection result
+		 * @param corners the cached refined corners (empty if not found)
+		 * @return true if the image is in the cache
+		 */
+		bool lookup(uint64_t contentHash,
+					cv::Size & imageSize,
+					bool & found,
+					std::vector<cv::Point2f> & corners);
+
+		/**
+		 * Add the detection result of an image
+		 * @param contentHash the image file content hash
+		 * @param imageSize the image size
+		 * @param found the detection result
+		 * @param corners the refined corners
+		 */
+		void insert(uint64_t contentHash,
+					cv::Size imageSize,
+					bool found,
+					const std::vector<cv::Point2f> & corners);
+
+		/**
+		 * Write cached and new entries to the cache file.
+		 * Entries are written to a temporary file which then replaces the
+		 * cache file.
+		 * @return true if the cache file has been written
+		 */
+		bool save();
+
+		/**
+		 * Number of lookups found in the cache
+		 * @return the number of cache hits
+		 */
+		size_t getHits() const;
+
+		/**
+		 * Number of lookups not found in the cache
+		 * @return the number of cache misses
+		 */
+		size_t getMisses() const;
+
+		/**
+		 * Cache file name
+		 * @return the cache file name
+		 */
+		const std::string & getFilename() const;
+
+		/**
+		 * Print cache usage
+		 * @param out the stream to print to
+		 */
+		void printStatistics(FILE * out) const;
+
+		/**
+		 * Content hash of a file (64 bits FNV-1a over the memory mapped
+		 * file)
+		 * @param filename the file name
+		 * @param hash the file content hash
+		 * @return true if the file has been read
+		 */
+		static bool hashFile(const std::string & filename, uint64_t & hash);
+
+		/**
+		 * Detection parameters key
+		 * @param detector the chessboard detector
+		 * @param flipVertical images are flipped before detection
+		 * @return the key of the parameters affecting detected corners
+		 */
+		static uint64_t parametersKeyOf(const ChessboardDetector & detector,
+										bool flipVertical);
+
+	private:
+		/**
+		 * Entry key : content hash and parameters key
+		 */
+		typedef std::pair<uint64_t, uint64_t> Key;
+
+		/**
+		 * Entry header as stored in the cache file, followed by the corners
+		 */
+		struct EntryHeader
+		{
+			uint64_t contentHash;
+			uint64_t parametersKey;
+			int32_t width;
+			int32_t height;
+			int32_t found;
+			uint32_t nbCorners;
+		};
+
+		/**
+		 * New entry held in memory until the cache is saved
+		 */
+		struct Entry
+		{
+			cv::Size imageSize;
+			bool found;
+			std::vector<cv::Point2f> corners;
+		};
+
+		/**
+		 * Cache file name
+		 */
+		std::string filename;
+
+		/**
+		 * Detection parameters key of this run
+		 */
+		uint64_t parametersKey;
+
+		/**
+		 * Mapped cache file (NULL if not mapped)
+		 */
+		const char * mapped;
+
+		/**
+		 * Mapped cache file size
+		 */
+		size_t mappedSize;
+
+		/**
+		 * Entries of the mapped cache file
+		 */
+		std::map<Key, const EntryHeader *> mappedEntries;
+
+		/**
+		 * Entries added since the cache file was mapped
+		 */
+		std::map<Key, Entry> newEntries;
+
+		/**
+		 * Number of cache hits
+		 */
+		size_t hits;
+
+		/**
+		 * Number of cache misses
+		 */
+		size_t misses;
+
+		/**
+		 * Lock protecting entries and counters while workers are running
+		 */
+		mutable std::mutex entriesMutex;
+};
+
+#endif /* CORNERCACHE_H_ */
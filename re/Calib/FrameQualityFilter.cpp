@@ -0,0 +1,225 @@
+/*
+ * FrameQualityFilter.cpp
+ *
+ * Cheap sharpness and exposure checks rejecting hopeless live frames before
+ * the chessboard search.
+ */
+
+#include <chrono>
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "FrameQualityFilter.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Gray levels up to this one are dark clipped pixels
+ */
+static const int darkClip = 8;
+
+/**
+ * Gray levels from this one are bright clipped pixels
+ */
+static const int brightClip = 247;
+
+/**
+ * Gray level reached by a fraction of the pixels
+ * @param histogram the gray levels histogram
+ * @param count the number of pixels
+ * @param fraction the fraction of pixels in [0, 1]
+ * @return the smallest gray level such that at least fraction of the pixels
+ * are darker or equal
+ */
+static int percentile(const unsigned * histogram, unsigned count, double fraction)
+{
+	unsigned target = (unsigned) (fraction * count);
+	unsigned cumulated = 0;
+	for (int level = 0; level < 256; level++)
+	{
+		cumulated += histogram[level];
+		if (cumulated > target)
+		{
+			return level;
+		}
+	}
+	return 255;
+}
+
+/*
+ * Constructor
+ */
+FrameQualityFilter::FrameQualityFilter(double minSharpness,
+									   int minContrast,
+									   double maxClipped,
+									   int analysisWidth) :
+	minSharpness(minSharpness),
+	minContrast(minContrast),
+	maxClipped(maxClipped),
+	analysisWidth(analysisWidth),
+	sharpness(0),
+	frames(0),
+	checkTime(0),
+	detections(0),
+	detectionTime(0)
+{
+	for (int v = 0; v < NB_VERDICTS; v++)
+	{
+		verdicts[v] = 0;
+	}
+}
+
+/*
+ * Check a frame
+ */
+FrameQualityFilter::Verdict FrameQualityFilter::check(const Mat & viewGray)
+{
+	Clock::time_point start = Clock::now();
+	frames++;
+	sharpness = 0;
+
+	// nearest neighbour decimation keeps edges as sharp as in the frame
+	int factor = (viewGray.cols + analysisWidth - 1) / analysisWidth;
+	if (factor > 1)
+	{
+		resize(viewGray,
+			   decimated,
+			   Size(viewGray.cols / factor, viewGray.rows / factor),
+			   0,
+			   0,
+			   INTER_NEAREST);
+	}
+	else
+	{
+		decimated = viewGray;
+	}
+
+	// exposure from the gray levels histogram
+	unsigned histogram[256] = { 0 };
+	for (int y = 0; y < decimated.rows; y++)
+	{
+		const uchar * row = decimated.ptr<uchar>(y);
+		for (int x = 0; x < decimated.cols; x++)
+		{
+			histogram[row[x]]++;
+		}
+	}
+	unsigned count = (unsigned) decimated.total();
+	unsigned dark = 0, bright = 0;
+	for (int level = 0; level <= darkClip; level++)
+	{
+		dark += histogram[level];
+	}
+	for (int level = brightClip; level < 256; level++)
+	{
+		bright += histogram[level];
+	}
+
+	Verdict verdict = ACCEPTED;
+	if (dark > maxClipped * count)
+	{
+		verdict = UNDEREXPOSED;
+	}
+	else if (bright > maxClipped * count)
+	{
+		verdict = OVEREXPOSED;
+	}
+	else if (percentile(histogram, count, 0.95) -
+				 percentile(histogram, count, 0.05) < minContrast)
+	{
+		verdict = LOW_CONTRAST;
+	}
+	else
+	{
+		// sharpness from the variance of the Laplacian
+		Scalar mean, stddev;
+		Laplacian(decimated, laplacian, CV_16S, 1);
+		meanStdDev(laplacian, mean, stddev);
+		sharpness = stddev[0] * stddev[0];
+		if (sharpness < minSharpness)
+		{
+			verdict = BLURRED;
+		}
+	}
+
+	verdicts[verdict]++;
+	checkTime += secondsSince(start);
+	return verdict;
+}
+
+/*
+ * Record the time of a chessboard search on an accepted frame
+ */
+void FrameQualityFilter::addDetectionTime(double seconds)
+{
+	detections++;
+	detectionTime += seconds;
+}
+
+/*
+ * Last computed sharpness
+ */
+double FrameQualityFilter::getSharpness() const
+{
+	return sharpness;
+}
+
+/*
+ * Verdict name
+ */
+const char * FrameQualityFilter::nameOf(Verdict verdict)
+{
+	switch (verdict)
+	{
+		case ACCEPTED:
+			return "accepted";
+		case UNDEREXPOSED:
+			return "underexposed";
+		case OVEREXPOSED:
+			return "overexposed";
+		case LOW_CONTRAST:
+			return "low contrast";
+		case BLURRED:
+			return "blurred";
+		default:
+			return "unknown";
+	}
+}
+
+/*
+ * Print skipped frames by reason, check time and estimated time saved
+ */
+void FrameQualityFilter::printStatistics(FILE * out) const
+{
+	unsigned long skipped = frames - verdicts[ACCEPTED];
+	double meanDetection = detections > 0 ? detectionTime / detections : 0.0;
+
+	fprintf(out, "Frame quality pre-filter : %lu frames, %lu skipped "
+			"(%.1f%%), mean check %.3f ms\n",
+			frames,
+			skipped,
+			frames > 0 ? 100.0 * skipped / frames : 0.0,
+			frames > 0 ? 1e3 * checkTime / frames : 0.0);
+	for (int v = UNDEREXPOSED; v < NB_VERDICTS; v++)
+	{
+		fprintf(out, "  %-14s %8lu\n", nameOf((Verdict) v), verdicts[v]);
+	}
+	fprintf(out, "  estimated net time saved %.3f s (%.2f ms per search, "
+			"%.3f s spent checking)\n",
+			skipped * meanDetection - checkTime,
+			1e3 * meanDetection,
+			checkTime);
+}
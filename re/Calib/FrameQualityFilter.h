@@ -0,0 +1,158 @@
+/*
+ * FrameQualityFilter.h
+ *
+ * Cheap sharpness and exposure checks rejecting hopeless live frames before
+ * the chessboard search.
+ */
+
+#ifndef FRAMEQUALITYFILTER_H_
+#define FRAMEQUALITYFILTER_H_
+
+#include <cstdio>
+
+#include "opencv2/core/core.hpp"
+
+/**
+ * Frame quality pre-filter.
+ * Motion blurred or badly exposed live frames almost always fail the
+ * chessboard search, which is at its slowest when it fails. Each frame is
+ * first decimated (nearest neighbour, so that edges are not smoothed) to at
+ * most analysisWidth columns, then :
+ * 	- its gray levels histogram rejects frames whose dark or bright clipped
+ * 	pixels exceed a fraction of the image, or whose contrast (spread between
+ * 	the 5th and 95th percentiles) is too low for a board to be seen
+ * 	- the variance of its Laplacian rejects blurred frames
+ * Both checks cost a small fraction of a millisecond on a VGA frame.
+ * Skipped frames are counted by reason, and the time saved is estimated
+ * from the mean time of the searches which were not skipped.
+ * A filter holds counters so it must be used by a single thread.
+ */
+class FrameQualityFilter
+{
+	public:
+		/**
+		 * Check verdicts
+		 */
+		enum Verdict
+		{
+			ACCEPTED = 0,	//!< frame worth a chessboard search
+			UNDEREXPOSED,	//!< too many dark clipped pixels
+			OVEREXPOSED,	//!< too many bright clipped pixels
+			LOW_CONTRAST,	//!< gray levels spread too narrow
+			BLURRED,		//!< Laplacian variance too low
+			NB_VERDICTS
+		};
+
+		/**
+		 * Constructor
+		 * @param minSharpness minimum variance of the Laplacian of the
+		 * decimated frame
+		 * @param minContrast minimum spread between the 5th and 95th
+		 * percentiles of gray levels
+		 * @param maxClipped maximum fraction of dark or bright clipped pixels
+		 * @param analysisWidth maximum width of the decimated frame
+		 */
+		FrameQualityFilter(double minSharpness = 20,
+						   int minContrast = 32,
+						   double maxClipped = 0.4,
+						   int analysisWidth = 320);
+
+		/**
+		 * Check a frame
+		 * @param viewGray the gray level frame
+		 * @return ACCEPTED if the frame is worth a chessboard search, the
+		 * rejection reason otherwise
+		 */
+		Verdict check(const cv::Mat & viewGray);
+
+		/**
+		 * Record the time of a chessboard search on an accepted frame, used
+		 * to estimate the time saved by skipped frames
+		 * @param seconds the search time in seconds
+		 */
+		void addDetectionTime(double seconds);
+
+		/**
+		 * Last computed sharpness (Laplacian variance, 0 if the frame was
+		 * rejected on exposure)
+		 * @return the sharpness of the last checked frame
+		 */
+		double getSharpness() const;
+
+		/**
+		 * Verdict name
+		 * @param verdict the verdict
+		 * @return a printable name
+		 */
+		static const char * nameOf(Verdict verdict);
+
+		/**
+		 * Print skipped frames by reason, check time and estimated time
+		 * saved
+		 * @param out the stream to print to
+		 */
+		void printStatistics(FILE * out) const;
+
+	private:
+		/**
+		 * Minimum Laplacian variance
+		 */
+		double minSharpness;
+
+		/**
+		 * Minimum 5th to 95th percentiles spread
+		 */
+		int minContrast;
+
+		/**
+		 * Maximum fraction of clipped pixels
+		 */
+		double maxClipped;
+
+		/**
+		 * Maximum width of the decimated frame
+		 */
+		int analysisWidth;
+
+		/**
+		 * Decimated frame (reused between frames)
+		 */
+		cv::Mat decimated;
+
+		/**
+		 * Laplacian of the decimated frame (reused between frames)
+		 */
+		cv::Mat laplacian;
+
+		/**
+		 * Last computed sharpness
+		 */
+		double sharpness;
+
+		/**
+		 * Number of checked frames
+		 */
+		unsigned long frames;
+
+		/**
+		 * Number of frames of each verdict
+		 */
+		unsigned long verdicts[NB_VERDICTS];
+
+		/**
+		 * Time spent checking frames in seconds
+		 */
+		double checkTime;
+
+		/**
+		 * Number of recorded chessboard searches
+		 */
+		unsigned long detections;
+
+		/**
+		 * Time spent in recorded chessboard searches in seconds
+		 */
+		double detectionTime;
+};
+
+#endif /* FRAMEQUALITYFILTER_H_ */
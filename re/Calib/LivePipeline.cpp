@@ -0,0 +1,314 @@
+/*
+ * LivePipeline.cpp
+ *
+ * Decoupled capture / detection stages for live calibration.
+ */
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "LivePipeline.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time between two time points
+ * @param start the starting time point
+ * @param end the ending time point
+ * @return the elapsed time in seconds
+ */
+static double seconds(const Clock::time_point & start,
+					  const Clock::time_point & end)
+{
+	return chrono::duration<double>(end - start).count();
+}
+
+/*
+ * Default constructor : empty frame
+ */
+LiveFrame::LiveFrame() :
+	sequence(0),
+	found(false)
+{
+}
+
+/*
+ * Default constructor : no samples
+ */
+StageLatency::StageLatency() :
+	count(0),
+	total(0),
+	max(0)
+{
+}
+
+/*
+ * Add a new sample
+ */
+void StageLatency::add(double seconds)
+{
+	count++;
+	total += seconds;
+	if (seconds > max)
+	{
+		max = seconds;
+	}
+}
+
+/*
+ * Print mean and max latency
+ */
+void StageLatency::print(FILE * out, const char * name) const
+{
+	fprintf(out, "  %-12s %8lu samples, mean %8.2f ms, max %8.2f ms\n",
+			name,
+			count,
+			count > 0 ? 1e3 * total / count : 0.0,
+			1e3 * max);
+}
+
+/*
+ * Constructor.
+ */
+LivePipeline::LivePipeline(VideoCapture & capture,
+						   const ChessboardDetector & detector,
+						   int reduceFactor,
+						   bool flipVertical,
+						   ChessboardTracker * tracker,
+						   FrameQualityFilter * qualityFilter) :
+	capture(capture),
+	detector(detector),
+	tracker(tracker),
+	qualityFilter(qualityFilter),
+	reduceFactor(reduceFactor),
+	flipVertical(flipVertical),
+	captured(0),
+	detecting(0),
+	detected(0),
+	displayed(0),
+	stopping(false),
+	captureDone(false),
+	detectDone(false),
+	captureDrops(0),
+	resultDrops(0)
+{
+}
+
+/*
+ * Destructor : stops the pipeline if needed
+ */
+LivePipeline::~LivePipeline()
+{
+	stop();
+}
+
+/*
+ * Start capture and detection threads
+ */
+void LivePipeline::start()
+{
+	startTime = Clock::now();
+	captureThread = thread(&LivePipeline::captureLoop, this);
+	detectThread = thread(&LivePipeline::detectLoop, this);
+}
+
+/*
+ * Stop capture and detection threads
+ */
+void LivePipeline::stop()
+{
+	{
+		lock_guard<mutex> lock(stateMutex);
+		if (stopping)
+		{
+			return;
+		}
+		stopping = true;
+		frameReady.notify_all();
+		resultReady.notify_all();
+	}
+
+	if (captureThread.joinable())
+	{
+		captureThread.join();
+	}
+	if (detectThread.joinable())
+	{
+		detectThread.join();
+	}
+	stopTime = Clock::now();
+}
+
+/*
+ * Wait for a detection result newer than the last one returned
+ */
+bool LivePipeline::nextResult(LiveFrame & frame)
+{
+	unique_lock<mutex> lock(stateMutex);
+	resultReady.wait(lock, [this] {
+		return detected > displayed || detectDone || stopping;
+	});
+
+	if (detected == displayed)
+	{
+		return false;
+	}
+
+	frame = latestResult;
+	displayed = detected;
+	endToEndLatency.add(seconds(frame.captureTime, Clock::now()));
+	return true;
+}
+
+/*
+ * Print per stage latencies and drop counters
+ */
+void LivePipeline::printStatistics(FILE * out) const
+{
+	lock_guard<mutex> lock(stateMutex);
+	double elapsed = seconds(startTime, stopping ? stopTime : Clock::now());
+	if (elapsed <= 0)
+	{
+		elapsed = 1;
+	}
+
+	fprintf(out, "Live pipeline statistics (%.1f s):\n", elapsed);
+	fprintf(out, "  captured  %8lu frames (%.1f fps), %lu dropped before "
+			"detection\n", captured, captured / elapsed, captureDrops);
+	fprintf(out, "  detected  %8lu frames (%.1f fps), %lu dropped before "
+			"display\n", detected, detected / elapsed, resultDrops);
+	fprintf(out, "  displayed %8lu frames (%.1f fps)\n",
+			displayed, displayed / elapsed);
+	captureLatency.print(out, "capture");
+	queueLatency.print(out, "queue");
+	detectLatency.print(out, "detection");
+	endToEndLatency.print(out, "end to end");
+}
+
+/*
+ * Capture thread main loop
+ */
+void LivePipeline::captureLoop()
+{
+	Mat grabbed;
+
+	for (;;)
+	{
+		{
+			lock_guard<mutex> lock(stateMutex);
+			if (stopping)
+			{
+				break;
+			}
+		}
+
+		Clock::time_point start = Clock::now();
+		if (!capture.read(grabbed) || grabbed.empty())
+		{
+			break;
+		}
+
+		LiveFrame frame;
+		frame.captureTime = Clock::now();
+		// the capture device may reuse its buffer on next read
+		frame.view = grabbed.clone();
+
+		lock_guard<mutex> lock(stateMutex);
+		captureLatency.add(seconds(start, frame.captureTime));
+		if (latestFrame.sequence > detecting)
+		{
+			// previous frame has not been picked by the detector
+			captureDrops++;
+		}
+		frame.sequence = ++captured;
+		latestFrame = frame;
+		frameReady.notify_one();
+	}
+
+	lock_guard<mutex> lock(stateMutex);
+	captureDone = true;
+	frameReady.notify_all();
+}
+
+/*
+ * Detection thread main loop
+ */
+void LivePipeline::detectLoop()
+{
+	for (;;)
+	{
+		LiveFrame frame;
+		{
+			unique_lock<mutex> lock(stateMutex);
+			frameReady.wait(lock, [this] {
+				return stopping || captureDone || captured > detecting;
+			});
+			if (stopping || captured == detecting)
+			{
+				break;
+			}
+			frame = latestFrame;
+			latestFrame.view = Mat();
+			detecting = frame.sequence;
+			queueLatency.add(seconds(frame.captureTime, Clock::now()));
+		}
+
+		Clock::time_point start = Clock::now();
+		Mat viewGray;
+		if (reduceFactor != 1)
+		{
+			Mat view0 = frame.view;
+			resize(view0,
+				   frame.view,
+				   Size(view0.cols / reduceFactor, view0.rows / reduceFactor),
+				   0,
+				   0,
+				   INTER_AREA);
+		}
+		if (flipVertical)
+		{
+			flip(frame.view, frame.view, 0);
+		}
+		cvtColor(frame.view, viewGray, CV_BGR2GRAY);
+		if (qualityFilter != NULL &&
+			qualityFilter->check(viewGray) != FrameQualityFilter::ACCEPTED)
+		{
+			// hopeless frame : chessboard search skipped
+			frame.found = false;
+		}
+		else
+		{
+			Clock::time_point searchStart = Clock::now();
+			if (tracker != NULL)
+			{
+				frame.found = tracker->detect(viewGray, frame.corners);
+			}
+			else
+			{
+				frame.found = detector.detect(viewGray, frame.corners);
+			}
+			if (qualityFilter != NULL)
+			{
+				qualityFilter->addDetectionTime(
+					seconds(searchStart, Clock::now()));
+			}
+		}
+
+		lock_guard<mutex> lock(stateMutex);
+		detectLatency.add(seconds(start, Clock::now()));
+		if (latestResult.sequence > displayed)
+		{
+			// previous result has not been picked by the display
+			resultDrops++;
+		}
+		latestResult = frame;
+		detected = frame.sequence;
+		resultReady.notify_all();
+	}
+
+	lock_guard<mutex> lock(stateMutex);
+	detectDone = true;
+	resultReady.notify_all();
+}
@@ -0,0 +1,310 @@
+/*
+ * LivePipeline.h
+ *
+ * Decoupled capture / detection stages for live calibration.
+ */
+
+#ifndef LIVEPIPELINE_H_
+#define LIVEPIPELINE_H_
+
+#include <cstdio>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/highgui/highgui.hpp"
+
+#include "ChessboardDetector.h"
+#include "ChessboardTracker.h"
+#include "FrameQualityFilter.h"
+
+/**
+ * A detected frame handed over from the detection stage to the display stage
+ */
+struct LiveFrame
+{
+	/**
+	 * Frame sequence number (in capture order, starting at 1)
+	 */
+	unsigned long sequence;
+
+	/**
+	 * Captured view (reduced and flipped if required)
+	 */
+	cv::Mat view;
+
+	/**
+	 * Chessboard has been found in the view
+	 */
+	bool found;
+
+	/**
+	 * Refined chessboard corners (empty if not found)
+	 */
+	std::vector<cv::Point2f> corners;
+
+	/**
+	 * Time at which the frame has been captured
+	 */
+	std::chrono::steady_clock::time_point captureTime;
+
+	/**
+	 * Default constructor : empty frame
+	 */
+	LiveFrame();
+};
+
+/**
+ * Latency accumulator for one pipeline stage
+ */
+struct StageLatency
+{
+	/**
+	 * Number of samples
+	 */
+	unsigned long count;
+
+	/**
+	 * Sum of samples in seconds
+	 */
+	double total;
+
+	/**
+	 * Maximum sample in seconds
+	 */
+	double max;
+
+	/**
+	 * Default constructor : no samples
+	 */
+	StageLatency();
+
+	/**
+	 * Add a new sample
+	 * @param seconds the sample to add
+	 */
+	void add(double seconds);
+
+	/**
+	 * Print mean and max latency
+	 * @param out the stream to print to
+	 * @param name the stage name
+	 */
+	void print(FILE * out, const char * name) const;
+};
+
+/**
+ * Live calibration pipeline.
+ * 	- a capture thread grabs frames as fast as the device delivers them and
+ * 	only keeps the newest one
+ * 	- a detection thread always works on the newest captured frame : frames
+ * 	captured while the detector is busy are dropped
+ * 	- the display stage (the caller's thread, since HighGUI must run on the
+ * 	main thread) fetches the newest detection result with nextResult
+ */
+class LivePipeline
+{
+	public:
+		/**
+		 * Constructor.
+		 * The capture device is used exclusively by the pipeline between
+		 * start and stop.
+		 * @param capture the opened capture device
+		 * @param detector the chessboard detector
+		 * @param reduceFactor image reduce factor
+		 * @param flipVertical flip images around the horizontal axis
+		 * @param tracker the chessboard tracker used instead of the detector
+		 * (if not NULL). It is used exclusively by the detection thread
+		 * between start and stop.
+		 * @param qualityFilter the pre-filter skipping hopeless frames
+		 * before the chessboard search (if not NULL). It is used
+		 * exclusively by the detection thread between start and stop.
+		 */
+		LivePipeline(cv::VideoCapture & capture,
+					 const ChessboardDetector & detector,
+					 int reduceFactor,
+					 bool flipVertical,
+					 ChessboardTracker * tracker = NULL,
+					 FrameQualityFilter * qualityFilter = NULL);
+
+		/**
+		 * Destructor : stops the pipeline if needed
+		 */
+		~LivePipeline();
+
+		/**
+		 * Start capture and detection threads
+		 */
+		void start();
+
+		/**
+		 * Stop capture and detection threads
+		 */
+		void stop();
+
+		/**
+		 * Wait for a detection result newer than the last one returned
+		 * @param frame the newest detection result
+		 * @return true if a new result has been returned, false if the
+		 * capture has ended and all frames have been processed
+		 */
+		bool nextResult(LiveFrame & frame);
+
+		/**
+		 * Print per stage latencies and drop counters
+		 * @param out the stream to print to
+		 */
+		void printStatistics(FILE * out) const;
+
+	private:
+		/**
+		 * Capture thread main loop
+		 */
+		void captureLoop();
+
+		/**
+		 * Detection thread main loop
+		 */
+		void detectLoop();
+
+		/**
+		 * Capture device
+		 */
+		cv::VideoCapture & capture;
+
+		/**
+		 * Chessboard detector
+		 */
+		const ChessboardDetector & detector;
+
+		/**
+		 * Chessboard tracker (or NULL)
+		 */
+		ChessboardTracker * tracker;
+
+		/**
+		 * Frame quality pre-filter (or NULL)
+		 */
+		FrameQualityFilter * qualityFilter;
+
+		/**
+		 * Image reduce factor
+		 */
+		int reduceFactor;
+
+		/**
+		 * Flip images around the horizontal axis
+		 */
+		bool flipVertical;
+
+		/**
+		 * Capture and detection threads
+		 */
+		std::thread captureThread, detectThread;
+
+		/**
+		 * Lock protecting everything below
+		 */
+		mutable std::mutex stateMutex;
+
+		/**
+		 * Signaled when a new frame has been captured or when capture ends
+		 */
+		std::condition_variable frameReady;
+
+		/**
+		 * Signaled when a new result has been detected or when detection
+		 * ends
+		 */
+		std::condition_variable resultReady;
+
+		/**
+		 * Newest captured frame (not yet detected)
+		 */
+		LiveFrame latestFrame;
+
+		/**
+		 * Newest detected frame (not yet displayed)
+		 */
+		LiveFrame latestResult;
+
+		/**
+		 * Sequence number of the last captured frame
+		 */
+		unsigned long captured;
+
+		/**
+		 * Sequence number of the last frame taken by the detector
+		 */
+		unsigned long detecting;
+
+		/**
+		 * Sequence number of the last detected frame
+		 */
+		unsigned long detected;
+
+		/**
+		 * Sequence number of the last frame returned by nextResult
+		 */
+		unsigned long displayed;
+
+		/**
+		 * Stop requested
+		 */
+		bool stopping;
+
+		/**
+		 * Capture has ended (device closed or end of video file)
+		 */
+		bool captureDone;
+
+		/**
+		 * Detection thread has processed its last frame
+		 */
+		bool detectDone;
+
+		/**
+		 * Frames captured but overwritten before detection
+		 */
+		unsigned long captureDrops;
+
+		/**
+		 * Frames detected but overwritten before display
+		 */
+		unsigned long resultDrops;
+
+		/**
+		 * Time spent grabbing and decoding frames
+		 */
+		StageLatency captureLatency;
+
+		/**
+		 * Time spent by frames waiting for the detector
+		 */
+		StageLatency queueLatency;
+
+		/**
+		 * Time spent reducing, converting and detecting frames
+		 */
+		StageLatency detectLatency;
+
+		/**
+		 * Time between capture and hand over to the display
+		 */
+		StageLatency endToEndLatency;
+
+		/**
+		 * Pipeline start time
+		 */
+		std::chrono::steady_clock::time_point startTime;
+
+		/**
+		 * Pipeline stop time
+		 */
+		std::chrono::steady_clock::time_point stopTime;
+};
+
+#endif /* LIVEPIPELINE_H_ */
@@ -0,0 +1,284 @@
+/*
+ * NoveltyGate.cpp
+ *
+ * Live capture policy accepting a view only when it brings a new board pose
+ * or new image coverage.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include "CalibrationSolver.h"
+#include "NoveltyGate.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Minimum number of accepted views before the intrinsics estimate is
+ * refined from them
+ */
+static const size_t minViewsForIntrinsics = 3;
+
+/**
+ * Angle between two rotations
+ * @param a the first rotation matrix
+ * @param b the second rotation matrix
+ * @return the angle of the rotation from a to b in radians
+ */
+static double rotationAngle(const Matx33d & a, const Matx33d & b)
+{
+	// trace(a^T b)
+	double trace = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			trace += a(i, j) * b(i, j);
+		}
+	}
+	double c = std::max(-1.0, std::min(1.0, (trace - 1) / 2));
+	return acos(c);
+}
+
+/*
+ * Default constructor : everything set to 0
+ */
+NoveltyStatistics::NoveltyStatistics() :
+	offered(0),
+	rateLimited(0),
+	duplicates(0),
+	newPoses(0),
+	newCoverage(0),
+	poseFailures(0),
+	intrinsicsUpdates(0),
+	gateTime(0)
+{
+}
+
+/*
+ * Print accepted and rejected views by reason
+ */
+void NoveltyStatistics::print(FILE * out) const
+{
+	size_t accepted = newPoses + newCoverage;
+	fprintf(out, "Novelty gate: %u of %u offered views accepted, mean "
+			"%.3f ms per view\n",
+			(unsigned) accepted,
+			(unsigned) offered,
+			offered > 0 ? 1e3 * gateTime / offered : 0.0);
+	fprintf(out, "  %-22s %8u\n", "accepted (new pose)", (unsigned) newPoses);
+	fprintf(out, "  %-22s %8u\n", "accepted (coverage)", (unsigned) newCoverage);
+	fprintf(out, "  %-22s %8u\n", "rejected (duplicate)", (unsigned) duplicates);
+	fprintf(out, "  %-22s %8u\n", "rejected (rate limit)",
+			(unsigned) rateLimited);
+	fprintf(out, "  %-22s %8u\n", "pose failures", (unsigned) poseFailures);
+	fprintf(out, "  %-22s %8u\n", "intrinsics updates",
+			(unsigned) intrinsicsUpdates);
+}
+
+/*
+ * Constructor
+ */
+NoveltyGate::NoveltyGate(Size imageSize,
+						 Size boardSize,
+						 float squareSize,
+						 double minInterval,
+						 double minRotation,
+						 double minTranslation,
+						 int minNewCells) :
+	imageSize(imageSize),
+	minInterval(chrono::duration_cast<Clock::duration>(
+		chrono::duration<double>(minInterval))),
+	minRotation(minRotation * CV_PI / 180.0),
+	minTranslation(minTranslation),
+	minNewCells(minNewCells),
+	selector(imageSize, boardSize),
+	externalIntrinsics(false)
+{
+	calcChessboardCorners(boardSize, squareSize, objectPoints);
+	covered.assign(selector.getGridSize().area(), false);
+
+	// 53 degrees horizontal field of view, centered principal point
+	double f = imageSize.width;
+	cameraMatrix = (Mat_<double>(3, 3) << f, 0, (imageSize.width - 1) / 2.0,
+										  0, f, (imageSize.height - 1) / 2.0,
+										  0, 0, 1);
+	distCoeffs = Mat::zeros(5, 1, CV_64F);
+}
+
+/*
+ * Judge a view and remember it if accepted
+ */
+bool NoveltyGate::offer(const vector<Point2f> & corners)
+{
+	Clock::time_point start = Clock::now();
+	statistics.offered++;
+
+	if (!acceptedCorners.empty() && start - lastAccepted < minInterval)
+	{
+		statistics.rateLimited++;
+		statistics.gateTime += secondsSince(start);
+		return false;
+	}
+
+	// pose novelty : distance to the closest accepted pose
+	Matx33d R;
+	Vec3d t;
+	bool posed = estimatePose(corners, R, t);
+	bool newPose = posed && rotations.empty();
+	if (posed && !newPose)
+	{
+		double closest = HUGE_VAL;
+		for (size_t i = 0; i < rotations.size(); i++)
+		{
+			double rotation = rotationAngle(rotations[i], R) / minRotation;
+			double translation = norm(t - translations[i]) /
+				std::max(norm(t), norm(translations[i])) / minTranslation;
+			closest = std::min(closest, std::max(rotation, translation));
+		}
+		newPose = closest >= 1;
+	}
+	if (!posed)
+	{
+		statistics.poseFailures++;
+	}
+
+	// coverage novelty
+	vector<int> cells;
+	selector.coveredCells(corners, cells);
+	int newCells = 0;
+	for (size_t i = 0; i < cells.size(); i++)
+	{
+		newCells += covered[cells[i]] ? 0 : 1;
+	}
+
+	if (!newPose && newCells < minNewCells)
+	{
+		statistics.duplicates++;
+		statistics.gateTime += secondsSince(start);
+		return false;
+	}
+
+	if (newPose)
+	{
+		statistics.newPoses++;
+	}
+	else
+	{
+		statistics.newCoverage++;
+	}
+	for (size_t i = 0; i < cells.size(); i++)
+	{
+		covered[cells[i]] = true;
+	}
+	acceptedCorners.push_back(corners);
+	lastAccepted = start;
+
+	if (!externalIntrinsics && acceptedCorners.size() >= minViewsForIntrinsics)
+	{
+		// closed form focal lengths from the accepted views homographies
+		vector<vector<Point3f> > allObjectPoints(acceptedCorners.size(),
+												 objectPoints);
+		cameraMatrix = initCameraMatrix2D(allObjectPoints,
+										  acceptedCorners,
+										  imageSize);
+		statistics.intrinsicsUpdates++;
+		updatePoses();
+	}
+	else if (posed)
+	{
+		rotations.push_back(R);
+		translations.push_back(t);
+	}
+
+	statistics.gateTime += secondsSince(start);
+	return true;
+}
+
+/*
+ * Replace the running intrinsics estimate
+ */
+void NoveltyGate::setIntrinsics(const Mat & cameraMatrix,
+								const Mat & distCoeffs)
+{
+	cameraMatrix.convertTo(this->cameraMatrix, CV_64F);
+	distCoeffs.convertTo(this->distCoeffs, CV_64F);
+	externalIntrinsics = true;
+	statistics.intrinsicsUpdates++;
+	updatePoses();
+}
+
+/*
+ * Number of accepted views
+ */
+size_t NoveltyGate::accepted() const
+{
+	return acceptedCorners.size();
+}
+
+/*
+ * Statistics
+ */
+const NoveltyStatistics & NoveltyGate::getStatistics() const
+{
+	return statistics;
+}
+
+/*
+ * Estimate again the poses of all accepted views
+ */
+void NoveltyGate::updatePoses()
+{
+	rotations.clear();
+	translations.clear();
+	for (size_t i = 0; i < acceptedCorners.size(); i++)
+	{
+		Matx33d R;
+		Vec3d t;
+		if (estimatePose(acceptedCorners[i], R, t))
+		{
+			rotations.push_back(R);
+			translations.push_back(t);
+		}
+	}
+}
+
+/*
+ * Estimate a board pose
+ */
+bool NoveltyGate::estimatePose(const vector<Point2f> & corners,
+							   Matx33d & R,
+							   Vec3d & t) const
+{
+	if (corners.size() != objectPoints.size())
+	{
+		return false;
+	}
+
+	Mat rvec, tvec, rotation;
+	if (!solvePnP(objectPoints, corners, cameraMatrix, distCoeffs, rvec, tvec) ||
+		!checkRange(rvec) || !checkRange(tvec))
+	{
+		return false;
+	}
+
+	Rodrigues(rvec, rotation);
+	R = Matx33d(rotation.ptr<double>());
+	t = Vec3d(tvec.ptr<double>());
+	return t[2] > 0;
+}
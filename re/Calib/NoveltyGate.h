@@ -0,0 +1,242 @@
+/*
+ * NoveltyGate.h
+ *
+ * Live capture policy accepting a view only when it brings a new board pose
+ * or new image coverage.
+ */
+
+#ifndef NOVELTYGATE_H_
+#define NOVELTYGATE_H_
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+#include "ViewSelector.h"
+
+/**
+ * Novelty gate statistics
+ */
+struct NoveltyStatistics
+{
+	/**
+	 * Default constructor : everything set to 0
+	 */
+	NoveltyStatistics();
+
+	/**
+	 * Print accepted and rejected views by reason
+	 * @param out the stream to print to
+	 */
+	void print(FILE * out) const;
+
+	/**
+	 * Number of offered views (frames with a detected board)
+	 */
+	size_t offered;
+
+	/**
+	 * Views rejected because the previous one was accepted too recently
+	 */
+	size_t rateLimited;
+
+	/**
+	 * Views rejected as near duplicates of an accepted view
+	 */
+	size_t duplicates;
+
+	/**
+	 * Views accepted for their pose
+	 */
+	size_t newPoses;
+
+	/**
+	 * Views accepted for their coverage only
+	 */
+	size_t newCoverage;
+
+	/**
+	 * Views whose pose could not be estimated (judged on coverage only)
+	 */
+	size_t poseFailures;
+
+	/**
+	 * Running intrinsics estimate updates
+	 */
+	size_t intrinsicsUpdates;
+
+	/**
+	 * Time spent judging views in seconds
+	 */
+	double gateTime;
+};
+
+/**
+ * Pose novelty gate for live capture.
+ * Each offered view is first rate limited on the steady clock, then its
+ * board pose is estimated by solvePnP against a running intrinsics
+ * estimate, and it is accepted when :
+ * 	- its rotation differs from the rotation of every accepted view by at
+ * 	least minRotation, or its translation by at least minTranslation of the
+ * 	board distance
+ * 	- or it covers at least minNewCells coverage grid cells no accepted view
+ * 	covers yet
+ * The running estimate starts as a camera of 53 degrees horizontal field of
+ * view, is refined by initCameraMatrix2D on the accepted views and can be
+ * replaced by a real calibration with setIntrinsics. Accepted poses are
+ * estimated again whenever the intrinsics change.
+ * A gate holds the accepted views so it must be used by a single thread.
+ */
+class NoveltyGate
+{
+	public:
+		/**
+		 * Constructor
+		 * @param imageSize images size
+		 * @param boardSize board size (inner corners)
+		 * @param squareSize board squares size
+		 * @param minInterval minimum delay between accepted views in seconds
+		 * @param minRotation minimum rotation to accepted views in degrees
+		 * @param minTranslation minimum translation to accepted views (as a
+		 * fraction of the board distance)
+		 * @param minNewCells minimum newly covered grid cells
+		 */
+		NoveltyGate(cv::Size imageSize,
+					cv::Size boardSize,
+					float squareSize,
+					double minInterval,
+					double minRotation = 10,
+					double minTranslation = 0.15,
+					int minNewCells = 2);
+
+		/**
+		 * Judge a view and remember it if accepted
+		 * @param corners the detected board corners
+		 * @return true if the view should be captured
+		 */
+		bool offer(const std::vector<cv::Point2f> & corners);
+
+		/**
+		 * Replace the running intrinsics estimate (i.e. by an intermediate
+		 * calibration). The estimate is no longer refined from the accepted
+		 * views afterwards.
+		 * @param cameraMatrix the camera matrix
+		 * @param distCoeffs the distortion coefficients
+		 */
+		void setIntrinsics(const cv::Mat & cameraMatrix,
+						   const cv::Mat & distCoeffs);
+
+		/**
+		 * Number of accepted views
+		 * @return the number of accepted views
+		 */
+		size_t accepted() const;
+
+		/**
+		 * Statistics
+		 * @return accepted and rejected views counters
+		 */
+		const NoveltyStatistics & getStatistics() const;
+
+	private:
+		/**
+		 * Estimate again the poses of all accepted views with the current
+		 * intrinsics
+		 */
+		void updatePoses();
+
+		/**
+		 * Estimate a board pose
+		 * @param corners the board corners
+		 * @param R the board rotation matrix
+		 * @param t the board translation
+		 * @return true if the pose has been estimated
+		 */
+		bool estimatePose(const std::vector<cv::Point2f> & corners,
+						  cv::Matx33d & R,
+						  cv::Vec3d & t) const;
+
+		/**
+		 * Images size
+		 */
+		cv::Size imageSize;
+
+		/**
+		 * Board corners in the board frame
+		 */
+		std::vector<cv::Point3f> objectPoints;
+
+		/**
+		 * Minimum delay between accepted views
+		 */
+		std::chrono::steady_clock::duration minInterval;
+
+		/**
+		 * Minimum rotation in radians
+		 */
+		double minRotation;
+
+		/**
+		 * Minimum relative translation
+		 */
+		double minTranslation;
+
+		/**
+		 * Minimum newly covered cells
+		 */
+		int minNewCells;
+
+		/**
+		 * Coverage grid
+		 */
+		ViewSelector selector;
+
+		/**
+		 * Cells covered by accepted views
+		 */
+		std::vector<bool> covered;
+
+		/**
+		 * Running camera matrix estimate
+		 */
+		cv::Mat cameraMatrix;
+
+		/**
+		 * Running distortion coefficients estimate
+		 */
+		cv::Mat distCoeffs;
+
+		/**
+		 * Intrinsics have been set by setIntrinsics
+		 */
+		bool externalIntrinsics;
+
+		/**
+		 * Corners of the accepted views
+		 */
+		std::vector<std::vector<cv::Point2f> > acceptedCorners;
+
+		/**
+		 * Rotations of the accepted views whose pose could be estimated
+		 */
+		std::vector<cv::Matx33d> rotations;
+
+		/**
+		 * Translations of the accepted views whose pose could be estimated
+		 */
+		std::vector<cv::Vec3d> translations;
+
+		/**
+		 * Time of the last accepted view
+		 */
+		std::chrono::steady_clock::time_point lastAccepted;
+
+		/**
+		 * Counters
+		 */
+		NoveltyStatistics statistics;
+};
+
+#endif /* NOVELTYGATE_H_ */
@@ -0,0 +1,180 @@
+/*
+ * Profiler.cpp
+ *
+ * Per stage timing instrumentation with percentile summaries and Chrome
+ * trace export.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Profiler.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Percentile of sorted values (nearest rank)
+ * @param sorted the values in increasing order (not empty)
+ * @param p the percentile in [0, 100]
+ * @return the smallest value greater than or equal to p percent of the
+ * values
+ */
+static double percentile(const vector<double> & sorted, double p)
+{
+	size_t rank = (size_t) ceil(p / 100.0 * sorted.size());
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/*
+ * Constructor : starts timing
+ */
+Profiler::Scope::Scope(Profiler * profiler, const char * stage) :
+	profiler(profiler),
+	stage(stage)
+{
+	if (profiler != NULL)
+	{
+		start = Clock::now();
+	}
+}
+
+/*
+ * Destructor : records the stage duration
+ */
+Profiler::Scope::~Scope()
+{
+	if (profiler != NULL)
+	{
+		profiler->record(stage, start, Clock::now());
+	}
+}
+
+/*
+ * Constructor
+ */
+Profiler::Profiler() :
+	origin(Clock::now())
+{
+}
+
+/*
+ * Record a timed interval of a stage
+ */
+void Profiler::record(const char * stage,
+					  const Clock::time_point & start,
+					  const Clock::time_point & end)
+{
+	ProfileEvent event;
+	event.stage = stage;
+	event.start = chrono::duration<double>(start - origin).count();
+	event.duration = chrono::duration<double>(end - start).count();
+
+	thread::id id = this_thread::get_id();
+	lock_guard<mutex> lock(eventsMutex);
+	vector<thread::id>::iterator it = find(threads.begin(), threads.end(), id);
+	event.thread = (unsigned) (it - threads.begin());
+	if (it == threads.end())
+	{
+		threads.push_back(id);
+	}
+	events.push_back(event);
+}
+
+/*
+ * Recorded intervals
+ */
+vector<ProfileEvent> Profiler::getEvents() const
+{
+	lock_guard<mutex> lock(eventsMutex);
+	return events;
+}
+
+/*
+ * Print stages summaries
+ */
+void Profiler::print(FILE * out) const
+{
+	vector<ProfileEvent> recorded;
+	size_t nbThreads;
+	{
+		lock_guard<mutex> lock(eventsMutex);
+		recorded = events;
+		nbThreads = threads.size();
+	}
+
+	// durations of each stage in order of first record
+	vector<const char *> stages;
+	vector<vector<double> > durations;
+	for (size_t i = 0; i < recorded.size(); i++)
+	{
+		size_t s = 0;
+		while (s < stages.size() && strcmp(stages[s], recorded[i].stage) != 0)
+		{
+			s++;
+		}
+		if (s == stages.size())
+		{
+			stages.push_back(recorded[i].stage);
+			durations.push_back(vector<double>());
+		}
+		durations[s].push_back(recorded[i].duration);
+	}
+
+	fprintf(out, "Stages timings (%u intervals, %u threads)\n",
+			(unsigned) recorded.size(), (unsigned) nbThreads);
+	fprintf(out, "  %-22s %8s %10s %10s %10s %10s %10s\n",
+			"stage", "count", "total (s)", "p50 (ms)", "p95 (ms)",
+			"p99 (ms)", "max (ms)");
+	for (size_t s = 0; s < stages.size(); s++)
+	{
+		vector<double> & d = durations[s];
+		sort(d.begin(), d.end());
+		double total = 0;
+		for (size_t i = 0; i < d.size(); i++)
+		{
+			total += d[i];
+		}
+		fprintf(out, "  %-22s %8u %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+				stages[s],
+				(unsigned) d.size(),
+				total,
+				1e3 * percentile(d, 50),
+				1e3 * percentile(d, 95),
+				1e3 * percentile(d, 99),
+				1e3 * d.back());
+	}
+}
+
+/*
+ * Write the recorded intervals as a Chrome trace event file
+ */
+bool Profiler::writeTrace(const string & filename) const
+{
+	vector<ProfileEvent> recorded = getEvents();
+
+	FILE * out = fopen(filename.c_str(), "w");
+	if (out == NULL)
+	{
+		return false;
+	}
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (size_t i = 0; i < recorded.size(); i++)
+	{
+		const ProfileEvent & e = recorded[i];
+		fprintf(out,
+				"{\"name\":\"%s\",\"cat\":\"calibration\",\"ph\":\"X\","
+				"\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}%s\n",
+				e.stage,
+				1e6 * e.start,
+				1e6 * e.duration,
+				e.thread,
+				i + 1 < recorded.size() ? "," : "");
+	}
+	fprintf(out, "]}\n");
+
+	return fclose(out) == 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Profiler.h
+ *
+ * Per stage timing instrumentation with percentile summaries and Chrome
+ * trace export.
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Timed interval of a stage
+ */
+struct ProfileEvent
+{
+	/**
+	 * Stage name (a string literal)
+	 */
+	const char * stage;
+
+	/**
+	 * Start time in seconds since the profiler creation
+	 */
+	double start;
+
+	/**
+	 * Duration in seconds
+	 */
+	double duration;
+
+	/**
+	 * Index of the recording thread (in order of first record)
+	 */
+	unsigned thread;
+};
+
+/**
+ * Stages timings recorder.
+ * Each timed interval of a stage (i.e. one findChessboardCorners call) is
+ * recorded with the steady clock, so that stages can be summarized by their
+ * duration percentiles and the whole run inspected as a timeline in
+ * chrome://tracing (or any viewer of the Chrome trace event format).
+ * Recording is thread safe. Stages are timed by Scope instances, which do
+ * nothing when given a NULL profiler so that instrumentation costs nothing
+ * when profiling is off.
+ */
+class Profiler
+{
+	public:
+		/**
+		 * Times a stage from construction to destruction
+		 */
+		class Scope
+		{
+			public:
+				/**
+				 * Constructor : starts timing
+				 * @param profiler the profiler to record to (NULL to time
+				 * nothing)
+				 * @param stage the stage name (a string literal)
+				 */
+				Scope(Profiler * profiler, const char * stage);
+
+				/**
+				 * Destructor : records the stage duration
+				 */
+				~Scope();
+
+			private:
+				/**
+				 * Profiler to record to (may be NULL)
+				 */
+				Profiler * profiler;
+
+				/**
+				 * Stage name
+				 */
+				const char * stage;
+
+				/**
+				 * Start time
+				 */
+				std::chrono::steady_clock::time_point start;
+
+				// Non copyable
+				Scope(const Scope &);
+				Scope & operator =(const Scope &);
+		};
+
+		/**
+		 * Constructor : timestamps are relative to the profiler creation
+		 */
+		Profiler();
+
+		/**
+		 * Record a timed interval of a stage
+		 * @param stage the stage name (a string literal)
+		 * @param start the interval start
+		 * @param end the interval end
+		 */
+		void record(const char * stage,
+					const std::chrono::steady_clock::time_point & start,
+					const std::chrono::steady_clock::time_point & end);
+
+		/**
+		 * Recorded intervals
+		 * @return a copy of the recorded intervals
+		 */
+		std::vector<ProfileEvent> getEvents() const;
+
+		/**
+		 * Print count, total time and p50 / p95 / p99 / max durations of
+		 * each stage, in order of first record
+		 * @param out the stream to print to
+		 */
+		void print(FILE * out) const;
+
+		/**
+		 * Write the recorded intervals as a Chrome trace event file
+		 * (complete events in microseconds)
+		 * @param filename the JSON file name
+		 * @return true if the file was written
+		 */
+		bool writeTrace(const std::string & filename) const;
+
+	private:
+		/**
+		 * Profiler creation time
+		 */
+		std::chrono::steady_clock::time_point origin;
+
+		/**
+		 * Lock on events and threads
+		 */
+		mutable std::mutex eventsMutex;
+
+		/**
+		 * Recorded intervals
+		 */
+		std::vector<ProfileEvent> events;
+
+		/**
+		 * Recording threads in order of first record
+		 */
+		std::vector<std::thread::id> threads;
+};
+
+#endif /* PROFILER_H_ */
@@ -0,0 +1,280 @@
+/*
+ * ProgressiveSolver.cpp
+ *
+ * Background calibration of the views captured so far during live capture.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "CalibrationSolver.h"
+#include "ProgressiveSolver.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Largest change of fx, fy, cx and cy between two camera matrices
+ * @param previous the previous camera matrix
+ * @param current the current camera matrix
+ * @return the largest change relative to the current focal length
+ */
+static double intrinsicsChange(const Mat & previous, const Mat & current)
+{
+	double f = std::max(current.at<double>(0, 0), current.at<double>(1, 1));
+	double change = 0;
+	const int rows[] = { 0, 1, 0, 1 };
+	const int cols[] = { 0, 1, 2, 2 };
+	for (int i = 0; i < 4; i++)
+	{
+		change = std::max(change,
+						  std::abs(current.at<double>(rows[i], cols[i]) -
+								   previous.at<double>(rows[i], cols[i])));
+	}
+	return f > 0 ? change / f : HUGE_VAL;
+}
+
+/*
+ * Default constructor : nothing solved
+ */
+ProgressiveResult::ProgressiveResult() :
+	round(0),
+	views(0),
+	error(0),
+	change(HUGE_VAL),
+	solveTime(0),
+	converged(false)
+{
+}
+
+/*
+ * Constructor
+ */
+ProgressiveSolver::ProgressiveSolver(Size imageSize,
+									 Size boardSize,
+									 float squareSize,
+									 float aspectRatio,
+									 int flags,
+									 double tolerance,
+									 int stableRounds,
+									 size_t minViews) :
+	imageSize(imageSize),
+	boardSize(boardSize),
+	squareSize(squareSize),
+	aspectRatio(aspectRatio),
+	flags(flags),
+	tolerance(tolerance),
+	stableRounds(stableRounds),
+	minViews(minViews),
+	hasPending(false),
+	stopping(false),
+	fetched(0),
+	superseded(0),
+	failures(0),
+	solveTime(0)
+{
+}
+
+/*
+ * Destructor : stops the solver thread
+ */
+ProgressiveSolver::~ProgressiveSolver()
+{
+	stop();
+}
+
+/*
+ * Start the solver thread
+ */
+void ProgressiveSolver::start()
+{
+	solverThread = thread(&ProgressiveSolver::solveLoop, this);
+}
+
+/*
+ * Stop the solver thread
+ */
+void ProgressiveSolver::stop()
+{
+	{
+		lock_guard<mutex> lock(stateMutex);
+		stopping = true;
+		submitted.notify_all();
+	}
+
+	if (solverThread.joinable())
+	{
+		solverThread.join();
+	}
+}
+
+/*
+ * Submit the views captured so far
+ */
+void ProgressiveSolver::submit(const vector<vector<Point2f> > & imagePoints)
+{
+	lock_guard<mutex> lock(stateMutex);
+	if (hasPending)
+	{
+		superseded++;
+	}
+	pending = imagePoints;
+	hasPending = true;
+	submitted.notify_one();
+}
+
+/*
+ * Fetch the newest result
+ */
+bool ProgressiveSolver::latest(ProgressiveResult & result)
+{
+	lock_guard<mutex> lock(stateMutex);
+	if (this->result.round == fetched)
+	{
+		return false;
+	}
+	result = this->result;
+	fetched = result.round;
+	return true;
+}
+
+/*
+ * Parameters have converged
+ */
+bool ProgressiveSolver::hasConverged() const
+{
+	lock_guard<mutex> lock(stateMutex);
+	return result.converged;
+}
+
+/*
+ * Print solves count and times
+ */
+void ProgressiveSolver::printStatistics(FILE * out) const
+{
+	lock_guard<mutex> lock(stateMutex);
+	fprintf(out, "Progressive calibration: %lu solves (%lu failed), mean "
+			"%.1f ms, %lu submissions superseded\n",
+			result.round,
+			failures,
+			result.round + failures > 0 ?
+				1e3 * solveTime / (result.round + failures) : 0.0,
+			superseded);
+	if (result.round > 0)
+	{
+		fprintf(out, "  last solve on %u views : fx %.2f fy %.2f cx %.2f "
+				"cy %.2f, error %.4f px%s\n",
+				(unsigned) result.views,
+				result.cameraMatrix.at<double>(0, 0),
+				result.cameraMatrix.at<double>(1, 1),
+				result.cameraMatrix.at<double>(0, 2),
+				result.cameraMatrix.at<double>(1, 2),
+				result.error,
+				result.converged ? ", converged" : "");
+	}
+}
+
+/*
+ * Solver thread main loop
+ */
+void ProgressiveSolver::solveLoop()
+{
+	// previous solve, seeding the next one
+	CalibrationSeed seed;
+	seed.imageSize = imageSize;
+	seed.boardSize = boardSize;
+	seed.squareSize = squareSize;
+	seed.flags = flags;
+	int stable = 0;
+
+	for (;;)
+	{
+		vector<vector<Point2f> > views;
+		{
+			unique_lock<mutex> lock(stateMutex);
+			submitted.wait(lock, [this] { return stopping || hasPending; });
+			if (stopping)
+			{
+				break;
+			}
+			views.swap(pending);
+			hasPending = false;
+		}
+
+		// captured views only grow : anything else (capture restarted)
+		// needs a cold solve
+		bool warm = !seed.imagePoints.empty() &&
+			views.size() > seed.imagePoints.size() &&
+			views[0] == seed.imagePoints[0];
+
+		Clock::time_point start = Clock::now();
+		Mat cameraMatrix, distCoeffs;
+		vector<vector<Point2f> > imagePoints;
+		vector<Mat> rvecs, tvecs;
+		vector<float> reprojErrs;
+		double totalAvgErr = 0;
+		bool ok;
+		if (warm)
+		{
+			vector<vector<Point2f> > newViews(
+				views.begin() + seed.imagePoints.size(), views.end());
+			IncrementalStatistics statistics;
+			ok = runIncrementalCalibration(seed, newViews, imageSize,
+										   boardSize, squareSize, aspectRatio,
+										   flags, false, cameraMatrix,
+										   distCoeffs, imagePoints, rvecs,
+										   tvecs, reprojErrs, totalAvgErr,
+										   statistics, false);
+		}
+		else
+		{
+			imagePoints = views;
+			stable = 0;
+			ok = runCalibration(imagePoints, imageSize, boardSize, squareSize,
+								aspectRatio, flags, cameraMatrix, distCoeffs,
+								rvecs, tvecs, reprojErrs, totalAvgErr, false);
+		}
+		double elapsed = secondsSince(start);
+
+		if (!ok)
+		{
+			lock_guard<mutex> lock(stateMutex);
+			failures++;
+			solveTime += elapsed;
+			continue;
+		}
+
+		double change = seed.cameraMatrix.empty() || !warm ? HUGE_VAL :
+			intrinsicsChange(seed.cameraMatrix, cameraMatrix);
+		stable = change < tolerance && imagePoints.size() >= minViews ?
+			stable + 1 : 0;
+
+		seed.cameraMatrix = cameraMatrix;
+		seed.distCoeffs = distCoeffs;
+		seed.imagePoints = imagePoints;
+
+		lock_guard<mutex> lock(stateMutex);
+		solveTime += elapsed;
+		result.round++;
+		result.views = imagePoints.size();
+		result.cameraMatrix = cameraMatrix.clone();
+		result.distCoeffs = distCoeffs.clone();
+		result.error = totalAvgErr;
+		result.change = change;
+		result.solveTime = elapsed;
+		result.converged = stable >= stableRounds;
+	}
+}
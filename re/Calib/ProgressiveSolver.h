@@ -0,0 +1,255 @@
+/*
+ * ProgressiveSolver.h
+ *
+ * Background calibration of the views captured so far during live capture.
+ */
+
+#ifndef PROGRESSIVESOLVER_H_
+#define PROGRESSIVESOLVER_H_
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+/**
+ * Intermediate calibration published by the progressive solver
+ */
+struct ProgressiveResult
+{
+	/**
+	 * Solve number (starting at 1, 0 if nothing has been solved yet)
+	 */
+	unsigned long round;
+
+	/**
+	 * Number of views used by this solve
+	 */
+	size_t views;
+
+	/**
+	 * Camera matrix
+	 */
+	cv::Mat cameraMatrix;
+
+	/**
+	 * Distortion coefficients
+	 */
+	cv::Mat distCoeffs;
+
+	/**
+	 * RMS reprojection error
+	 */
+	double error;
+
+	/**
+	 * Largest change of fx, fy, cx and cy since the previous solve, relative
+	 * to the focal length
+	 */
+	double change;
+
+	/**
+	 * Solve time in seconds
+	 */
+	double solveTime;
+
+	/**
+	 * Parameters have converged
+	 */
+	bool converged;
+
+	/**
+	 * Default constructor : nothing solved
+	 */
+	ProgressiveResult();
+};
+
+/**
+ * Progressive calibration solver.
+ * While live capture goes on, the capture loop submits the views captured
+ * so far every few views. A solver thread calibrates the newest submission :
+ * a cold solve the first time, then an incremental solve warm started from
+ * the previous result (see runIncrementalCalibration) so each round only
+ * costs a few iterations. Each result is published for the overlay, and
+ * parameters are deemed converged once the intrinsics changed by less than
+ * tolerance (relative to the focal length) over stableRounds consecutive
+ * solves of at least minViews views.
+ * Submitting and fetching results only copy data under a lock, so the
+ * capture loop is never blocked by a solve : a submission arriving while
+ * the solver is busy replaces any pending one.
+ */
+class ProgressiveSolver
+{
+	public:
+		/**
+		 * Constructor
+		 * @param imageSize images size
+		 * @param boardSize board size (inner corners)
+		 * @param squareSize board squares size
+		 * @param aspectRatio image aspect ratio
+		 * @param flags OpenCV calibration flags (see runCalibration)
+		 * @param tolerance relative intrinsics change below which a solve is
+		 * stable
+		 * @param stableRounds number of consecutive stable solves for
+		 * convergence
+		 * @param minViews minimum number of views of a stable solve
+		 */
+		ProgressiveSolver(cv::Size imageSize,
+						  cv::Size boardSize,
+						  float squareSize,
+						  float aspectRatio,
+						  int flags,
+						  double tolerance = 0.002,
+						  int stableRounds = 2,
+						  size_t minViews = 10);
+
+		/**
+		 * Destructor : stops the solver thread
+		 */
+		~ProgressiveSolver();
+
+		/**
+		 * Start the solver thread
+		 */
+		void start();
+
+		/**
+		 * Stop the solver thread (waits for the current solve to end)
+		 */
+		void stop();
+
+		/**
+		 * Submit the views captured so far
+		 * @param imagePoints the corners of all captured views
+		 */
+		void submit(const std::vector<std::vector<cv::Point2f> > & imagePoints);
+
+		/**
+		 * Fetch the newest result
+		 * @param result the newest result
+		 * @return true if result is newer than the last fetched one
+		 */
+		bool latest(ProgressiveResult & result);
+
+		/**
+		 * Parameters have converged
+		 * @return true once a converged result has been published
+		 */
+		bool hasConverged() const;
+
+		/**
+		 * Print solves count and times
+		 * @param out the stream to print to
+		 */
+		void printStatistics(FILE * out) const;
+
+	private:
+		/**
+		 * Solver thread main loop
+		 */
+		void solveLoop();
+
+		/**
+		 * Images size
+		 */
+		cv::Size imageSize;
+
+		/**
+		 * Board size
+		 */
+		cv::Size boardSize;
+
+		/**
+		 * Board squares size
+		 */
+		float squareSize;
+
+		/**
+		 * Image aspect ratio
+		 */
+		float aspectRatio;
+
+		/**
+		 * Calibration flags
+		 */
+		int flags;
+
+		/**
+		 * Relative intrinsics change of a stable solve
+		 */
+		double tolerance;
+
+		/**
+		 * Consecutive stable solves for convergence
+		 */
+		int stableRounds;
+
+		/**
+		 * Minimum number of views of a stable solve
+		 */
+		size_t minViews;
+
+		/**
+		 * Solver thread
+		 */
+		std::thread solverThread;
+
+		/**
+		 * Lock protecting everything below
+		 */
+		mutable std::mutex stateMutex;
+
+		/**
+		 * Signaled when views are submitted or on stop
+		 */
+		std::condition_variable submitted;
+
+		/**
+		 * Views waiting for the solver
+		 */
+		std::vector<std::vector<cv::Point2f> > pending;
+
+		/**
+		 * Views are waiting for the solver
+		 */
+		bool hasPending;
+
+		/**
+		 * Stop requested
+		 */
+		bool stopping;
+
+		/**
+		 * Newest published result
+		 */
+		ProgressiveResult result;
+
+		/**
+		 * Round of the last fetched result
+		 */
+		unsigned long fetched;
+
+		/**
+		 * Number of submissions replaced before being solved
+		 */
+		unsigned long superseded;
+
+		/**
+		 * Number of failed solves
+		 */
+		unsigned long failures;
+
+		/**
+		 * Total solve time in seconds
+		 */
+		double solveTime;
+
+		// Non copyable
+		ProgressiveSolver(const ProgressiveSolver &);
+		ProgressiveSolver & operator =(const ProgressiveSolver &);
+};
+
+#endif /* PROGRESSIVESOLVER_H_ */
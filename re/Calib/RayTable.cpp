@@ -0,0 +1,470 @@
+/*
+ * RayTable.cpp
+ *
+ * Precomputed per pixel unit rays for fast back projection.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "opencv2/core/hal/intrin.hpp"
+
+#include "RayTable.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Ray table file magic number
+ */
+static const char rayTableMagic[8] = { 'R', 'A', 'Y', 'T', 'A', 'B', 'L', 'E' };
+
+/**
+ * Ray table file format version
+ */
+static const uint32_t rayTableVersion = 1;
+
+/**
+ * Number of grid nodes along an image axis : nodes cover the last pixel, and
+ * each axis has at least one cell
+ * @param length the image width or height
+ * @param step the grid step in pixels
+ * @return the number of nodes
+ */
+static int gridNodes(int length, int step)
+{
+	// 64 bits sum : read headers may hold any positive length and step
+	return std::max(2, (int) (((int64_t) length - 1 + step - 1) / step + 1));
+}
+
+#if CV_SIMD128
+/**
+ * Bilinear interpolation of a grid plane at 4 pixels
+ * @param plane the grid plane
+ * @param offsets offset of the top left node of each pixel cell
+ * @param cols number of grid nodes per row
+ * @param ax horizontal position of each pixel in its cell
+ * @param ay vertical position of each pixel in its cell
+ * @return the interpolated values
+ */
+static inline v_float32x4 bilinear(const float * plane,
+								   const int * offsets,
+								   int cols,
+								   const v_float32x4 & ax,
+								   const v_float32x4 & ay)
+{
+	float p00[4], p01[4], p10[4], p11[4];
+	for (int j = 0; j < 4; j++)
+	{
+		const float * node = plane + offsets[j];
+		p00[j] = node[0];
+		p01[j] = node[1];
+		p10[j] = node[cols];
+		p11[j] = node[cols + 1];
+	}
+	v_float32x4 top = v_load(p00) + ax * (v_load(p01) - v_load(p00));
+	v_float32x4 bottom = v_load(p10) + ax * (v_load(p11) - v_load(p10));
+	return top + ay * (bottom - top);
+}
+#endif
+
+/*
+ * Default constructor : empty table
+ */
+RayTable::RayTable() :
+	imageSize(0, 0),
+	step(0),
+	gridCols(0),
+	gridRows(0)
+{
+}
+
+/*
+ * Build the table from a calibrated camera
+ */
+bool RayTable::build(const CameraModel & camera, int step)
+{
+	Size size = camera.getImageSize();
+	if (!camera.isLoaded() || step <= 0)
+	{
+		return false;
+	}
+
+	imageSize = size;
+	this->step = step;
+	gridCols = gridNodes(size.width, step);
+	gridRows = gridNodes(size.height, step);
+
+	vector<Point2f> nodes;
+	nodes.reserve((size_t) gridCols * gridRows);
+	for (int gy = 0; gy < gridRows; gy++)
+	{
+		for (int gx = 0; gx < gridCols; gx++)
+		{
+			nodes.push_back(Point2f((float) (gx * step), (float) (gy * step)));
+		}
+	}
+
+	vector<Point3f> rays;
+	camera.backProject(nodes, rays);
+	raysX.resize(rays.size());
+	raysY.resize(rays.size());
+	raysZ.resize(rays.size());
+	for (size_t i = 0; i < rays.size(); i++)
+	{
+		raysX[i] = rays[i].x;
+		raysY[i] = rays[i].y;
+		raysZ[i] = rays[i].z;
+	}
+	return true;
+}
+
+/*
+ * Read a ray table file
+ */
+bool RayTable::read(const string & filename)
+{
+	FILE * in = fopen(filename.c_str(), "rb");
+	if (in == NULL)
+	{
+		return false;
+	}
+
+	// other versions have another layout, and the grid must match the image
+	// size and step or lookups would fall outside of it
+	RayTableHeader header;
+	bool ok = fread(&header, sizeof(header), 1, in) == 1 &&
+		memcmp(header.magic, rayTableMagic, sizeof(rayTableMagic)) == 0 &&
+		header.version == rayTableVersion &&
+		header.headerSize >= sizeof(header) &&
+		header.imageWidth > 0 && header.imageHeight > 0 && header.step > 0 &&
+		header.gridCols == gridNodes(header.imageWidth, header.step) &&
+		header.gridRows == gridNodes(header.imageHeight, header.step) &&
+		fseek(in, header.headerSize, SEEK_SET) == 0;
+
+	if (ok)
+	{
+		size_t nodes = (size_t) header.gridCols * header.gridRows;
+		raysX.resize(nodes);
+		raysY.resize(nodes);
+		raysZ.resize(nodes);
+		ok = fread(&raysX[0], sizeof(float), nodes, in) == nodes &&
+			fread(&raysY[0], sizeof(float), nodes, in) == nodes &&
+			fread(&raysZ[0], sizeof(float), nodes, in) == nodes;
+	}
+	fclose(in);
+
+	if (!ok)
+	{
+		*this = RayTable();
+		return false;
+	}
+
+	imageSize = Size(header.imageWidth, header.imageHeight);
+	step = header.step;
+	gridCols = header.gridCols;
+	gridRows = header.gridRows;
+	return true;
+}
+
+/*
+ * Write a ray table file
+ */
+bool RayTable::write(const string & filename) const
+{
+	if (empty())
+	{
+		return false;
+	}
+
+	RayTableHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, rayTableMagic, sizeof(rayTableMagic));
+	header.version = rayTableVersion;
+	header.headerSize = sizeof(header);
+	header.imageWidth = imageSize.width;
+	header.imageHeight = imageSize.height;
+	header.step = step;
+	header.gridCols = gridCols;
+	header.gridRows = gridRows;
+
+	string temporary = filename + ".tmp";
+	FILE * out = fopen(temporary.c_str(), "wb");
+	if (out == NULL)
+	{
+		return false;
+	}
+
+	size_t nodes = raysX.size();
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+		fwrite(&raysX[0], sizeof(float), nodes, out) == nodes &&
+		fwrite(&raysY[0], sizeof(float), nodes, out) == nodes &&
+		fwrite(&raysZ[0], sizeof(float), nodes, out) == nodes;
+	ok = fclose(out) == 0 && ok;
+
+	if (!ok || rename(temporary.c_str(), filename.c_str()) != 0)
+	{
+		unlink(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+/*
+ * The table is empty
+ */
+bool RayTable::empty() const
+{
+	return raysX.empty();
+}
+
+/*
+ * Calibrated images size
+ */
+Size RayTable::getImageSize() const
+{
+	return imageSize;
+}
+
+/*
+ * Distance between grid nodes
+ */
+int RayTable::getStep() const
+{
+	return step;
+}
+
+/*
+ * Size of the table data
+ */
+size_t RayTable::byteSize() const
+{
+	return 3 * raysX.size() * sizeof(float);
+}
+
+/*
+ * Ray of a pixel
+ */
+Point3f RayTable::ray(const Point2f & pixel) const
+{
+	Point3f result(0, 0, 0);
+	lookup(&pixel.x, &pixel.y, &result.x, &result.y, &result.z, 1, false);
+	return result;
+}
+
+/*
+ * Rays of many pixels (structure of arrays)
+ */
+void RayTable::lookup(const float * u,
+					  const float * v,
+					  float * x,
+					  float * y,
+					  float * z,
+					  size_t n,
+					  bool vectorized) const
+{
+	if (empty())
+	{
+		return;
+	}
+
+	// positions are clamped just below the last node so that every cell
+	// has a right and a bottom neighbour
+	float invStep = 1.f / step;
+	float maxX = nextafter((float) (gridCols - 1), 0.f);
+	float maxY = nextafter((float) (gridRows - 1), 0.f);
+	const float * px = &raysX[0];
+	const float * py = &raysY[0];
+	const float * pz = &raysZ[0];
+	size_t i = 0;
+
+#if CV_SIMD128
+	if (vectorized)
+	{
+		v_float32x4 vInvStep = v_setall_f32(invStep);
+		v_float32x4 vMaxX = v_setall_f32(maxX), vMaxY = v_setall_f32(maxY);
+		v_float32x4 zero = v_setzero_f32(), one = v_setall_f32(1.f);
+		int cellX[4], cellY[4], offsets[4];
+
+		for (; i + 4 <= n; i += 4)
+		{
+			v_float32x4 fx = v_min(v_max(v_load(u + i) * vInvStep, zero), vMaxX);
+			v_float32x4 fy = v_min(v_max(v_load(v + i) * vInvStep, zero), vMaxY);
+			v_int32x4 cx = v_floor(fx), cy = v_floor(fy);
+			v_float32x4 ax = fx - v_cvt_f32(cx);
+			v_float32x4 ay = fy - v_cvt_f32(cy);
+			v_store(cellX, cx);
+			v_store(cellY, cy);
+			for (int j = 0; j < 4; j++)
+			{
+				offsets[j] = cellY[j] * gridCols + cellX[j];
+			}
+
+			v_float32x4 rx = bilinear(px, offsets, gridCols, ax, ay);
+			v_float32x4 ry = bilinear(py, offsets, gridCols, ax, ay);
+			v_float32x4 rz = bilinear(pz, offsets, gridCols, ax, ay);
+			v_float32x4 inverseNorm = one / v_sqrt(rx * rx + ry * ry + rz * rz);
+			v_store(x + i, rx * inverseNorm);
+			v_store(y + i, ry * inverseNorm);
+			v_store(z + i, rz * inverseNorm);
+		}
+	}
+#else
+	(void) vectorized;
+#endif
+
+	// remaining pixels (all pixels without SIMD support)
+	for (; i < n; i++)
+	{
+		float fx = std::min(std::max(u[i] * invStep, 0.f), maxX);
+		float fy = std::min(std::max(v[i] * invStep, 0.f), maxY);
+		int cx = (int) fx, cy = (int) fy;
+		float ax = fx - cx, ay = fy - cy;
+		int o = cy * gridCols + cx;
+
+		float r[3];
+		const float * planes[3] = { px, py, pz };
+		for (int c = 0; c < 3; c++)
+		{
+			const float * node = planes[c] + o;
+			float top = node[0] + ax * (node[1] - node[0]);
+			float bottom = node[gridCols] +
+				ax * (node[gridCols + 1] - node[gridCols]);
+			r[c] = top + ay * (bottom - top);
+		}
+		float inverseNorm = 1.f / sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+		x[i] = r[0] * inverseNorm;
+		y[i] = r[1] * inverseNorm;
+		z[i] = r[2] * inverseNorm;
+	}
+}
+
+/*
+ * Rays of many pixels
+ */
+void RayTable::lookup(const vector<Point2f> & pixels,
+					  vector<Point3f> & rays) const
+{
+	size_t n = pixels.size();
+	vector<float> u(n), v(n), x(n), y(n), z(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		u[i] = pixels[i].x;
+		v[i] = pixels[i].y;
+	}
+
+	rays.resize(n);
+	if (n == 0)
+	{
+		return;
+	}
+	lookup(&u[0], &v[0], &x[0], &y[0], &z[0], n);
+	for (size_t i = 0; i < n; i++)
+	{
+		rays[i] = Point3f(x[i], y[i], z[i]);
+	}
+}
+
+/*
+ * Compare tables of several steps against the exact back projection
+ */
+void RayTable::benchmark(const CameraModel & camera,
+						 const vector<int> & steps,
+						 int lookups,
+						 FILE * out)
+{
+	Size size = camera.getImageSize();
+	if (!camera.isLoaded() || lookups <= 0)
+	{
+		return;
+	}
+
+	// random sub pixel positions, reproducible between runs
+	RNG rng(0x5eed);
+	size_t n = (size_t) lookups;
+	vector<Point2f> pixels(n);
+	vector<float> u(n), v(n), x(n), y(n), z(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		u[i] = rng.uniform(0.f, (float) (size.width - 1));
+		v[i] = rng.uniform(0.f, (float) (size.height - 1));
+		pixels[i] = Point2f(u[i], v[i]);
+	}
+
+	vector<Point3f> exact;
+	Clock::time_point start = Clock::now();
+	camera.backProject(pixels, exact);
+	double exactTime = secondsSince(start);
+
+	// angular errors are expressed in pixels at the focal length
+	double focal = camera.getCameraMatrix().at<double>(0, 0);
+
+	fprintf(out, "Ray tables of %dx%d images (%d lookups)\n",
+			size.width, size.height, lookups);
+	fprintf(out, "  %-16s %10s %10s %12s %12s %12s %12s\n",
+			"method", "build (ms)", "size (KB)", "scalar (M/s)",
+			"SIMD (M/s)", "mean (px)", "max (px)");
+	fprintf(out, "  %-16s %10s %10s %12.2f %12s %12.6f %12.6f\n",
+			"back projection", "-", "-",
+			exactTime > 0 ? n / exactTime / 1e6 : 0.0, "-", 0.0, 0.0);
+
+	for (size_t s = 0; s < steps.size(); s++)
+	{
+		RayTable table;
+		start = Clock::now();
+		if (!table.build(camera, steps[s]))
+		{
+			continue;
+		}
+		double buildTime = secondsSince(start);
+
+		start = Clock::now();
+		table.lookup(&u[0], &v[0], &x[0], &y[0], &z[0], n, false);
+		double scalarTime = secondsSince(start);
+
+		start = Clock::now();
+		table.lookup(&u[0], &v[0], &x[0], &y[0], &z[0], n, true);
+		double simdTime = secondsSince(start);
+
+		double sumError = 0, maxError = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const Point3f & e = exact[i];
+			double cx = (double) y[i] * e.z - (double) z[i] * e.y;
+			double cy = (double) z[i] * e.x - (double) x[i] * e.z;
+			double cz = (double) x[i] * e.y - (double) y[i] * e.x;
+			double dot = (double) x[i] * e.x + (double) y[i] * e.y +
+				(double) z[i] * e.z;
+			double angle = atan2(sqrt(cx * cx + cy * cy + cz * cz), dot);
+			sumError += angle;
+			maxError = std::max(maxError, angle);
+		}
+
+		char name[32];
+		sprintf(name, "step %d", steps[s]);
+		fprintf(out, "  %-16s %10.3f %10.1f %12.2f %12.2f %12.6f %12.6f\n",
+				name,
+				1e3 * buildTime,
+				table.byteSize() / 1024.0,
+				scalarTime > 0 ? n / scalarTime / 1e6 : 0.0,
+				simdTime > 0 ? n / simdTime / 1e6 : 0.0,
+				focal * sumError / n,
+				focal * maxError);
+	}
+}
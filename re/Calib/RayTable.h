@@ -0,0 +1,222 @@
+/*
+ * RayTable.h
+ *
+ * Precomputed per pixel unit rays for fast back projection.
+ */
+
+#ifndef RAYTABLE_H_
+#define RAYTABLE_H_
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+#include "CameraModel.h"
+
+/**
+ * Ray table file header, followed by the x, y then z planes of the grid
+ * nodes rays (gridRows x gridCols floats each).
+ * All values are stored in the writer native byte order.
+ */
+struct RayTableHeader
+{
+	/**
+	 * Magic number ("RAYTABLE")
+	 */
+	char magic[8];
+
+	/**
+	 * Format version
+	 */
+	uint32_t version;
+
+	/**
+	 * Header size in bytes : newer versions may only append fields
+	 */
+	uint32_t headerSize;
+
+	/**
+	 * Calibrated images width
+	 */
+	int32_t imageWidth;
+
+	/**
+	 * Calibrated images height
+	 */
+	int32_t imageHeight;
+
+	/**
+	 * Distance in pixels between grid nodes (1 for a dense table)
+	 */
+	int32_t step;
+
+	/**
+	 * Number of grid nodes per row
+	 */
+	int32_t gridCols;
+
+	/**
+	 * Number of grid nodes per column
+	 */
+	int32_t gridRows;
+
+	/**
+	 * Reserved (0)
+	 */
+	int32_t reserved;
+};
+
+/**
+ * Unit rays in the camera frame of a grid of pixels, looked up instead of
+ * inverting the distortion model for each back projected pixel.
+ * Grid nodes are spaced by step pixels (every pixel center with a step of
+ * 1, a dense table) and cover the whole image. Rays of other pixels are
+ * bilinearly interpolated between the 4 surrounding nodes then
+ * renormalized, pixels outside the image use the border cells. Rays are
+ * stored as structure of arrays (one plane per coordinate) and bulk lookups
+ * are evaluated 4 pixels at a time with 128 bits SIMD registers when
+ * available.
+ */
+class RayTable
+{
+	public:
+		/**
+		 * Default constructor : empty table
+		 */
+		RayTable();
+
+		/**
+		 * Build the table from a calibrated camera
+		 * @param camera the loaded camera model
+		 * @param step distance in pixels between grid nodes (1 for a dense
+		 * table)
+		 * @return true if the table was built
+		 */
+		bool build(const CameraModel & camera, int step = 1);
+
+		/**
+		 * Read a ray table file
+		 * @param filename the file name
+		 * @return true if the file is a valid ray table file
+		 */
+		bool read(const std::string & filename);
+
+		/**
+		 * Write a ray table file
+		 * @param filename the file name
+		 * @return true if the file was written
+		 */
+		bool write(const std::string & filename) const;
+
+		/**
+		 * The table is empty
+		 * @return true if the table has not been built nor read
+		 */
+		bool empty() const;
+
+		/**
+		 * Calibrated images size
+		 * @return the size of the images covered by the table
+		 */
+		cv::Size getImageSize() const;
+
+		/**
+		 * Distance between grid nodes
+		 * @return the distance in pixels between grid nodes
+		 */
+		int getStep() const;
+
+		/**
+		 * Size of the table data
+		 * @return the grid nodes rays size in bytes
+		 */
+		size_t byteSize() const;
+
+		/**
+		 * Ray of a pixel
+		 * @param pixel pixel coordinates in distorted images
+		 * @return the interpolated unit ray
+		 */
+		cv::Point3f ray(const cv::Point2f & pixel) const;
+
+		/**
+		 * Rays of many pixels (structure of arrays)
+		 * @param u pixels x coordinates
+		 * @param v pixels y coordinates
+		 * @param x rays x coordinates
+		 * @param y rays y coordinates
+		 * @param z rays z coordinates
+		 * @param n number of pixels
+		 * @param vectorized use SIMD registers when available
+		 */
+		void lookup(const float * u,
+					const float * v,
+					float * x,
+					float * y,
+					float * z,
+					size_t n,
+					bool vectorized = true) const;
+
+		/**
+		 * Rays of many pixels
+		 * @param pixels pixels coordinates in distorted images
+		 * @param rays interpolated unit ray of each pixel
+		 */
+		void lookup(const std::vector<cv::Point2f> & pixels,
+					std::vector<cv::Point3f> & rays) const;
+
+		/**
+		 * Compare build time, size and accuracy against the exact back
+		 * projection of tables of several steps, and lookup throughput of
+		 * scalar and SIMD lookups against back projection
+		 * @param camera the loaded camera model
+		 * @param steps grid steps to compare
+		 * @param lookups number of random pixels looked up per table
+		 * @param out the stream to print results to
+		 */
+		static void benchmark(const CameraModel & camera,
+							  const std::vector<int> & steps,
+							  int lookups,
+							  FILE * out);
+
+	private:
+		/**
+		 * Calibrated images size
+		 */
+		cv::Size imageSize;
+
+		/**
+		 * Distance in pixels between grid nodes
+		 */
+		int step;
+
+		/**
+		 * Number of grid nodes per row
+		 */
+		int gridCols;
+
+		/**
+		 * Number of grid nodes per column
+		 */
+		int gridRows;
+
+		/**
+		 * Grid nodes rays x coordinates
+		 */
+		std::vector<float> raysX;
+
+		/**
+		 * Grid nodes rays y coordinates
+		 */
+		std::vector<float> raysY;
+
+		/**
+		 * Grid nodes rays z coordinates
+		 */
+		std::vector<float> raysZ;
+};
+
+#endif /* RAYTABLE_H_ */
@@ -0,0 +1,491 @@
+/*
+ * ReprojectionEngine.cpp
+ *
+ * Reprojection errors of many views of the same calibration pattern.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+
+#include "ReprojectionEngine.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Camera model in single precision
+ */
+struct CameraModel32f
+{
+	float fx, fy, cx, cy;
+	float k1, k2, p1, p2, k3, k4, k5, k6;
+};
+
+/**
+ * Projects the pattern on a range of views and stores the residuals
+ */
+class ProjectViews : public ParallelLoopBody
+{
+	public:
+		/**
+		 * Constructor
+		 * @param n number of points per view
+		 * @param patternX pattern points x coordinates
+		 * @param patternY pattern points y coordinates
+		 * @param patternZ pattern points z coordinates
+		 * @param imageX detected points x coordinates of all views
+		 * @param imageY detected points y coordinates of all views
+		 * @param residualX residuals x coordinates of all views
+		 * @param residualY residuals y coordinates of all views
+		 * @param squaredErrors sum of squared residuals of each view
+		 * @param rvecs rotation vector of each view
+		 * @param tvecs translation vector of each view
+		 * @param camera camera model
+		 */
+		ProjectViews(size_t n,
+					 const float * patternX,
+					 const float * patternY,
+					 const float * patternZ,
+					 const float * imageX,
+					 const float * imageY,
+					 float * residualX,
+					 float * residualY,
+					 double * squaredErrors,
+					 const vector<Mat> & rvecs,
+					 const vector<Mat> & tvecs,
+					 const CameraModel32f & camera) :
+			n(n),
+			patternX(patternX),
+			patternY(patternY),
+			patternZ(patternZ),
+			imageX(imageX),
+			imageY(imageY),
+			residualX(residualX),
+			residualY(residualY),
+			squaredErrors(squaredErrors),
+			rvecs(rvecs),
+			tvecs(tvecs),
+			camera(camera)
+		{
+		}
+
+		/**
+		 * Project views in range
+		 * @param range the views range
+		 */
+		void operator()(const Range & range) const
+		{
+			for (int v = range.start; v < range.end; v++)
+			{
+				// pose without allocation : Rodrigues into a fixed size
+				// matrix, translation converted through a header on a Vec
+				Matx33d R;
+				Vec3d t;
+				Mat tHeader(3, 1, CV_64F, t.val);
+				Rodrigues(rvecs[v], R);
+				tvecs[v].reshape(1, 3).convertTo(tHeader, CV_64F);
+
+				float pose[12];
+				for (int k = 0; k < 9; k++)
+				{
+					pose[k] = (float) R.val[k];
+				}
+				for (int k = 0; k < 3; k++)
+				{
+					pose[9 + k] = (float) t[k];
+				}
+
+				size_t offset = (size_t) v * n;
+				projectView(pose,
+							imageX + offset,
+							imageY + offset,
+							residualX + offset,
+							residualY + offset);
+
+				double sum = 0;
+				for (size_t i = 0; i < n; i++)
+				{
+					double dx = residualX[offset + i];
+					double dy = residualY[offset + i];
+					sum += dx * dx + dy * dy;
+				}
+				squaredErrors[v] = sum;
+			}
+		}
+
+	private:
+		/**
+		 * Project the pattern on a view
+		 * @param pose rotation matrix (row major) then translation vector
+		 * @param u detected points x coordinates of the view
+		 * @param w detected points y coordinates of the view
+		 * @param rx residuals x coordinates of the view
+		 * @param ry residuals y coordinates of the view
+		 */
+		void projectView(const float * pose,
+						 const float * u,
+						 const float * w,
+						 float * rx,
+						 float * ry) const
+		{
+			const CameraModel32f & c = camera;
+			size_t i = 0;
+
+#if CV_SIMD128
+			v_float32x4 r00 = v_setall_f32(pose[0]), r01 = v_setall_f32(pose[1]),
+				r02 = v_setall_f32(pose[2]), r10 = v_setall_f32(pose[3]),
+				r11 = v_setall_f32(pose[4]), r12 = v_setall_f32(pose[5]),
+				r20 = v_setall_f32(pose[6]), r21 = v_setall_f32(pose[7]),
+				r22 = v_setall_f32(pose[8]), t0 = v_setall_f32(pose[9]),
+				t1 = v_setall_f32(pose[10]), t2 = v_setall_f32(pose[11]);
+			v_float32x4 fx = v_setall_f32(c.fx), fy = v_setall_f32(c.fy),
+				cx = v_setall_f32(c.cx), cy = v_setall_f32(c.cy);
+			v_float32x4 k1 = v_setall_f32(c.k1), k2 = v_setall_f32(c.k2),
+				k3 = v_setall_f32(c.k3), k4 = v_setall_f32(c.k4),
+				k5 = v_setall_f32(c.k5), k6 = v_setall_f32(c.k6),
+				p1 = v_setall_f32(c.p1), p2 = v_setall_f32(c.p2);
+			v_float32x4 one = v_setall_f32(1.f), two = v_setall_f32(2.f);
+
+			for (; i + 4 <= n; i += 4)
+			{
+				v_float32x4 X = v_load(patternX + i);
+				v_float32x4 Y = v_load(patternY + i);
+				v_float32x4 Z = v_load(patternZ + i);
+
+				v_float32x4 x = r00 * X + r01 * Y + r02 * Z + t0;
+				v_float32x4 y = r10 * X + r11 * Y + r12 * Z + t1;
+				v_float32x4 z = r20 * X + r21 * Y + r22 * Z + t2;
+
+				v_float32x4 iz = one / z;
+				x = x * iz;
+				y = y * iz;
+
+				v_float32x4 r2 = x * x + y * y;
+				v_float32x4 r4 = r2 * r2;
+				v_float32x4 r6 = r4 * r2;
+				v_float32x4 radial = (one + k1 * r2 + k2 * r4 + k3 * r6) /
+					(one + k4 * r2 + k5 * r4 + k6 * r6);
+				v_float32x4 a1 = two * x * y;
+				v_float32x4 a2 = r2 + two * x * x;
+				v_float32x4 a3 = r2 + two * y * y;
+				v_float32x4 xd = x * radial + p1 * a1 + p2 * a2;
+				v_float32x4 yd = y * radial + p1 * a3 + p2 * a1;
+
+				v_store(rx + i, v_load(u + i) - (fx * xd + cx));
+				v_store(ry + i, v_load(w + i) - (fy * yd + cy));
+			}
+#endif
+
+			// remaining points (all points without SIMD support)
+			for (; i < n; i++)
+			{
+				float X = patternX[i], Y = patternY[i], Z = patternZ[i];
+				float x = pose[0] * X + pose[1] * Y + pose[2] * Z + pose[9];
+				float y = pose[3] * X + pose[4] * Y + pose[5] * Z + pose[10];
+				float z = pose[6] * X + pose[7] * Y + pose[8] * Z + pose[11];
+
+				float iz = 1.f / z;
+				x *= iz;
+				y *= iz;
+
+				float r2 = x * x + y * y;
+				float r4 = r2 * r2;
+				float r6 = r4 * r2;
+				float radial = (1.f + c.k1 * r2 + c.k2 * r4 + c.k3 * r6) /
+					(1.f + c.k4 * r2 + c.k5 * r4 + c.k6 * r6);
+				float a1 = 2.f * x * y;
+				float a2 = r2 + 2.f * x * x;
+				float a3 = r2 + 2.f * y * y;
+				float xd = x * radial + c.p1 * a1 + c.p2 * a2;
+				float yd = y * radial + c.p1 * a3 + c.p2 * a1;
+
+				rx[i] = u[i] - (c.fx * xd + c.cx);
+				ry[i] = w[i] - (c.fy * yd + c.cy);
+			}
+		}
+
+		size_t n;
+		const float * patternX;
+		const float * patternY;
+		const float * patternZ;
+		const float * imageX;
+		const float * imageY;
+		float * residualX;
+		float * residualY;
+		double * squaredErrors;
+		const vector<Mat> & rvecs;
+		const vector<Mat> & tvecs;
+		CameraModel32f camera;
+};
+
+/*
+ * Constructor
+ */
+ReprojectionEngine::ReprojectionEngine(const vector<Point3f> & pattern) :
+	nbViews(0)
+{
+	setPattern(pattern);
+}
+
+/*
+ * Replace the pattern
+ */
+void ReprojectionEngine::setPattern(const vector<Point3f> & pattern)
+{
+	nbViews = 0;
+	patternX.resize(pattern.size());
+	patternY.resize(pattern.size());
+	patternZ.resize(pattern.size());
+	for (size_t i = 0; i < pattern.size(); i++)
+	{
+		patternX[i] = pattern[i].x;
+		patternY[i] = pattern[i].y;
+		patternZ[i] = pattern[i].z;
+	}
+}
+
+/*
+ * Set the views to evaluate
+ */
+void ReprojectionEngine::setViews(const vector<vector<Point2f> > & imagePoints)
+{
+	size_t n = patternX.size();
+	nbViews = imagePoints.size();
+
+	// buffers only grow : setting fewer views reuses them
+	if (imageX.size() < nbViews * n)
+	{
+		imageX.resize(nbViews * n);
+		imageY.resize(nbViews * n);
+		residualX.resize(nbViews * n);
+		residualY.resize(nbViews * n);
+	}
+	if (squaredErrors.size() < nbViews)
+	{
+		squaredErrors.resize(nbViews);
+	}
+
+	for (size_t v = 0; v < nbViews; v++)
+	{
+		CV_Assert(imagePoints[v].size() == n);
+		for (size_t i = 0; i < n; i++)
+		{
+			imageX[v * n + i] = imagePoints[v][i].x;
+			imageY[v * n + i] = imagePoints[v][i].y;
+		}
+	}
+}
+
+/*
+ * Number of views
+ */
+size_t ReprojectionEngine::views() const
+{
+	return nbViews;
+}
+
+/*
+ * Number of points per view
+ */
+size_t ReprojectionEngine::pointsPerView() const
+{
+	return patternX.size();
+}
+
+/*
+ * Reproject the pattern on all views and compute residuals and errors
+ */
+double ReprojectionEngine::compute(const vector<Mat> & rvecs,
+								   const vector<Mat> & tvecs,
+								   const Mat & cameraMatrix,
+								   const Mat & distCoeffs,
+								   vector<float> & perViewErrors,
+								   bool parallel)
+{
+	CV_Assert(rvecs.size() >= nbViews && tvecs.size() >= nbViews);
+	CV_Assert(distCoeffs.total() <= 8);
+
+	Matx33d K;
+	cameraMatrix.convertTo(Mat(3, 3, CV_64F, K.val), CV_64F);
+	double k[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	Mat kHeader((int) distCoeffs.total(), 1, CV_64F, k);
+	distCoeffs.reshape(1, (int) distCoeffs.total()).convertTo(kHeader, CV_64F);
+
+	CameraModel32f camera;
+	camera.fx = (float) K(0, 0);
+	camera.fy = (float) K(1, 1);
+	camera.cx = (float) K(0, 2);
+	camera.cy = (float) K(1, 2);
+	camera.k1 = (float) k[0];
+	camera.k2 = (float) k[1];
+	camera.p1 = (float) k[2];
+	camera.p2 = (float) k[3];
+	camera.k3 = (float) k[4];
+	camera.k4 = (float) k[5];
+	camera.k5 = (float) k[6];
+	camera.k6 = (float) k[7];
+
+	size_t n = patternX.size();
+	ProjectViews body(n,
+					  &patternX[0],
+					  &patternY[0],
+					  &patternZ[0],
+					  imageX.empty() ? NULL : &imageX[0],
+					  imageY.empty() ? NULL : &imageY[0],
+					  residualX.empty() ? NULL : &residualX[0],
+					  residualY.empty() ? NULL : &residualY[0],
+					  squaredErrors.empty() ? NULL : &squaredErrors[0],
+					  rvecs,
+					  tvecs,
+					  camera);
+
+	if (parallel)
+	{
+		parallel_for_(Range(0, (int) nbViews), body);
+	}
+	else
+	{
+		body(Range(0, (int) nbViews));
+	}
+
+	perViewErrors.resize(nbViews);
+	double totalErr = 0;
+	for (size_t v = 0; v < nbViews; v++)
+	{
+		perViewErrors[v] = (float) std::sqrt(squaredErrors[v] / n);
+		totalErr += squaredErrors[v];
+	}
+
+	return nbViews > 0 ? std::sqrt(totalErr / (nbViews * n)) : 0.0;
+}
+
+/*
+ * Residual of a point computed by the last evaluation
+ */
+Point2f ReprojectionEngine::residual(size_t view, size_t point) const
+{
+	size_t index = view * patternX.size() + point;
+	return Point2f(residualX[index], residualY[index]);
+}
+
+/*
+ * Residuals x coordinates computed by the last evaluation
+ */
+const float * ReprojectionEngine::residualsX() const
+{
+	return residualX.empty() ? NULL : &residualX[0];
+}
+
+/*
+ * Residuals y coordinates computed by the last evaluation
+ */
+const float * ReprojectionEngine::residualsY() const
+{
+	return residualY.empty() ? NULL : &residualY[0];
+}
+
+/*
+ * Compare projectPoints per view with the engine
+ */
+void ReprojectionEngine::benchmark(const vector<Point3f> & pattern,
+								   const vector<vector<Point2f> > & imagePoints,
+								   const vector<Mat> & rvecs,
+								   const vector<Mat> & tvecs,
+								   const Mat & cameraMatrix,
+								   const Mat & distCoeffs,
+								   int iterations,
+								   FILE * out)
+{
+	size_t nbViews = imagePoints.size();
+	if (nbViews == 0 || iterations <= 0)
+	{
+		return;
+	}
+
+	// historical implementation : projectPoints into a new vector and
+	// temporary Mats per view
+	vector<float> referenceErrors(nbViews);
+	double referenceError = 0;
+	Clock::time_point start = Clock::now();
+	for (int it = 0; it < iterations; it++)
+	{
+		vector<Point2f> projected;
+		double totalErr = 0;
+		for (size_t v = 0; v < nbViews; v++)
+		{
+			projectPoints(Mat(pattern),
+						  rvecs[v],
+						  tvecs[v],
+						  cameraMatrix,
+						  distCoeffs,
+						  projected);
+			double err = norm(Mat(imagePoints[v]), Mat(projected), CV_L2);
+			referenceErrors[v] = (float) std::sqrt(err * err / pattern.size());
+			totalErr += err * err;
+		}
+		referenceError = std::sqrt(totalErr / (nbViews * pattern.size()));
+	}
+	double referenceTime = secondsSince(start) / iterations;
+
+	ReprojectionEngine engine(pattern);
+	engine.setViews(imagePoints);
+	vector<float> serialErrors, parallelErrors;
+	double serialError = 0, parallelError = 0;
+
+	start = Clock::now();
+	for (int it = 0; it < iterations; it++)
+	{
+		serialError = engine.compute(rvecs, tvecs, cameraMatrix, distCoeffs,
+									 serialErrors, false);
+	}
+	double serialTime = secondsSince(start) / iterations;
+
+	start = Clock::now();
+	for (int it = 0; it < iterations; it++)
+	{
+		parallelError = engine.compute(rvecs, tvecs, cameraMatrix, distCoeffs,
+									   parallelErrors, true);
+	}
+	double parallelTime = secondsSince(start) / iterations;
+
+	double maxViewDifference = 0;
+	for (size_t v = 0; v < nbViews; v++)
+	{
+		maxViewDifference = std::max(maxViewDifference,
+			(double) std::abs(parallelErrors[v] - referenceErrors[v]));
+	}
+
+	fprintf(out, "Reprojection errors of %u views x %u points "
+			"(%d iterations)\n",
+			(unsigned) nbViews, (unsigned) pattern.size(), iterations);
+	fprintf(out, "  %-22s %10s %10s %12s\n",
+			"implementation", "time (ms)", "speed-up", "error (px)");
+	fprintf(out, "  %-22s %10.3f %10.2f %12.6f\n", "projectPoints",
+			1e3 * referenceTime, 1.0, referenceError);
+	fprintf(out, "  %-22s %10.3f %10.2f %12.6f\n", "engine (1 thread)",
+			1e3 * serialTime,
+			serialTime > 0 ? referenceTime / serialTime : 0.0,
+			serialError);
+	fprintf(out, "  %-22s %10.3f %10.2f %12.6f\n", "engine (parallel)",
+			1e3 * parallelTime,
+			parallelTime > 0 ? referenceTime / parallelTime : 0.0,
+			parallelError);
+	fprintf(out, "  max per view error difference %.2e px\n",
+			maxViewDifference);
+}
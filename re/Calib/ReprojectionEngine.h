@@ -0,0 +1,173 @@
+/*
+ * ReprojectionEngine.h
+ *
+ * Reprojection errors of many views of the same calibration pattern.
+ */
+
+#ifndef REPROJECTIONENGINE_H_
+#define REPROJECTIONENGINE_H_
+
+#include <cstdio>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+/**
+ * Reprojection error engine.
+ * All views show the same pattern, so pattern points, image points and
+ * residuals are stored once in contiguous structure of arrays buffers (one
+ * array per coordinate, views one after the other) allocated when views are
+ * set and reused by every evaluation.
+ * Each view is projected in a single pass : rotation, perspective division,
+ * radial (k1..k6) and tangential (p1, p2) distortion are evaluated 4 points at
+ * a time with 128 bits SIMD registers when available, and views are
+ * processed in parallel.
+ * Projection is computed in single precision : errors match projectPoints to
+ * about 1e-4 pixel.
+ */
+class ReprojectionEngine
+{
+	public:
+		/**
+		 * Constructor
+		 * @param pattern pattern points (i.e. chessboard corners)
+		 * @see calcChessboardCorners
+		 */
+		explicit ReprojectionEngine(const std::vector<cv::Point3f> & pattern);
+
+		/**
+		 * Replace the pattern. Buffers are kept, so an engine can be reused
+		 * for other views (and other patterns) without allocation. Views
+		 * must be set again afterwards.
+		 * @param pattern pattern points (i.e. chessboard corners)
+		 */
+		void setPattern(const std::vector<cv::Point3f> & pattern);
+
+		/**
+		 * Set the views to evaluate
+		 * @param imagePoints detected pattern points on each view (all
+		 * views must have as many points as the pattern)
+		 */
+		void setViews(const std::vector<std::vector<cv::Point2f> > & imagePoints);
+
+		/**
+		 * Number of views
+		 * @return the number of views set
+		 */
+		size_t views() const;
+
+		/**
+		 * Number of points per view
+		 * @return the number of pattern points
+		 */
+		size_t pointsPerView() const;
+
+		/**
+		 * Reproject the pattern on all views and compute residuals and
+		 * errors
+		 * @param rvecs rotation vector of each view
+		 * @param tvecs translation vector of each view
+		 * @param cameraMatrix camera matrix
+		 * @param distCoeffs distortion coefficients (4, 5 or 8 coefficients)
+		 * @param perViewErrors RMS reprojection error of each view
+		 * @param parallel process views in parallel
+		 * @return the RMS reprojection error over all points
+		 */
+		double compute(const std::vector<cv::Mat> & rvecs,
+					   const std::vector<cv::Mat> & tvecs,
+					   const cv::Mat & cameraMatrix,
+					   const cv::Mat & distCoeffs,
+					   std::vector<float> & perViewErrors,
+					   bool parallel = true);
+
+		/**
+		 * Residual of a point computed by the last evaluation
+		 * @param view the view index
+		 * @param point the point index in the pattern
+		 * @return the residual (detected - reprojected) in pixels
+		 */
+		cv::Point2f residual(size_t view, size_t point) const;
+
+		/**
+		 * Residuals x coordinates computed by the last evaluation
+		 * @return views x pointsPerView residuals x coordinates
+		 */
+		const float * residualsX() const;
+
+		/**
+		 * Residuals y coordinates computed by the last evaluation
+		 * @return views x pointsPerView residuals y coordinates
+		 */
+		const float * residualsY() const;
+
+		/**
+		 * Compare evaluation time and errors of projectPoints per view
+		 * (computeReprojectionErrors historical implementation) with the
+		 * engine on one thread and on all threads
+		 * @param pattern pattern points
+		 * @param imagePoints detected pattern points on each view
+		 * @param rvecs rotation vector of each view
+		 * @param tvecs translation vector of each view
+		 * @param cameraMatrix camera matrix
+		 * @param distCoeffs distortion coefficients
+		 * @param iterations number of evaluations per implementation
+		 * @param out the stream to print results to
+		 */
+		static void benchmark(
+			const std::vector<cv::Point3f> & pattern,
+			const std::vector<std::vector<cv::Point2f> > & imagePoints,
+			const std::vector<cv::Mat> & rvecs,
+			const std::vector<cv::Mat> & tvecs,
+			const cv::Mat & cameraMatrix,
+			const cv::Mat & distCoeffs,
+			int iterations,
+			FILE * out);
+
+	private:
+		/**
+		 * Pattern points x coordinates
+		 */
+		std::vector<float> patternX;
+
+		/**
+		 * Pattern points y coordinates
+		 */
+		std::vector<float> patternY;
+
+		/**
+		 * Pattern points z coordinates
+		 */
+		std::vector<float> patternZ;
+
+		/**
+		 * Detected points x coordinates of all views
+		 */
+		std::vector<float> imageX;
+
+		/**
+		 * Detected points y coordinates of all views
+		 */
+		std::vector<float> imageY;
+
+		/**
+		 * Residuals x coordinates of all views
+		 */
+		std::vector<float> residualX;
+
+		/**
+		 * Residuals y coordinates of all views
+		 */
+		std::vector<float> residualY;
+
+		/**
+		 * Sum of squared residuals of each view
+		 */
+		std::vector<double> squaredErrors;
+
+		/**
+		 * Number of views
+		 */
+		size_t nbViews;
+};
+
+#endif /* REPROJECTIONENGINE_H_ */
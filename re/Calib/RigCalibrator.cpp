@@ -0,0 +1,487 @@
+/*
+ * RigCalibrator.cpp
+ *
+ * Extrinsic calibration of a rig of cameras with known intrinsics.
+ */
+
+#include <chrono>
+#include <ctime>
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "ChessboardDetector.h"
+#include "RigCalibrator.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Minimum number of common views to solve a pair
+ */
+static const size_t minCommonViews = 3;
+
+/**
+ * Distance between epipolar lines drawn on rectified views
+ */
+static const int epipolarLinesStep = 32;
+
+/**
+ * Read an images list (as written by imagelist_creator)
+ * @param filename the images list file name
+ * @param imageList the images file names
+ * @return true if the list was read
+ */
+static bool readImageList(const string & filename, vector<string> & imageList)
+{
+	imageList.clear();
+	FileStorage fs(filename, FileStorage::READ);
+	if (!fs.isOpened())
+	{
+		return false;
+	}
+	FileNode n = fs.getFirstTopLevelNode();
+	if (n.type() != FileNode::SEQ)
+	{
+		return false;
+	}
+	for (FileNodeIterator it = n.begin(); it != n.end(); ++it)
+	{
+		imageList.push_back((string) *it);
+	}
+	return true;
+}
+
+/*
+ * Default constructor : not solved
+ */
+RigPair::RigPair() :
+	camera(0),
+	solved(false),
+	error(0)
+{
+}
+
+/*
+ * Default constructor : nothing processed
+ */
+RigStatistics::RigStatistics() :
+	cameras(0),
+	views(0),
+	solved(0),
+	workers(0),
+	detectionTime(0),
+	solveTime(0),
+	rectifyTime(0)
+{
+}
+
+/*
+ * Print views counts and phases timings
+ */
+void RigStatistics::print(FILE * out) const
+{
+	fprintf(out, "Rig calibration: %u cameras, %u synchronized views, "
+			"%u / %u pairs solved on %u workers\n",
+			(unsigned) cameras,
+			(unsigned) views,
+			(unsigned) solved,
+			(unsigned) (cameras > 0 ? cameras - 1 : 0),
+			(unsigned) workers);
+	fprintf(out, "  %-22s %10s\n", "phase", "time (s)");
+	fprintf(out, "  %-22s %10.3f\n", "detection", detectionTime);
+	fprintf(out, "  %-22s %10.3f\n", "extrinsics solve", solveTime);
+	fprintf(out, "  %-22s %10.3f\n", "rectification maps", rectifyTime);
+}
+
+/*
+ * Constructor
+ */
+RigCalibrator::RigCalibrator(ThreadPool & pool,
+							 Size boardSize,
+							 float squareSize,
+							 int findFlags,
+							 int mapType,
+							 int interpolation) :
+	pool(pool),
+	boardSize(boardSize),
+	squareSize(squareSize),
+	findFlags(findFlags),
+	mapType(mapType),
+	interpolation(interpolation)
+{
+}
+
+/*
+ * Read the rig description, cameras images lists and intrinsics
+ */
+bool RigCalibrator::read(const string & filename)
+{
+	cameras.clear();
+	pairs.clear();
+
+	FileStorage fs(filename, FileStorage::READ);
+	if (!fs.isOpened())
+	{
+		return false;
+	}
+	FileNode n = fs["cameras"];
+	if (n.type() != FileNode::SEQ)
+	{
+		fprintf(stderr, "Rig %s has no cameras sequence\n", filename.c_str());
+		return false;
+	}
+
+	for (FileNodeIterator it = n.begin(); it != n.end(); ++it)
+	{
+		RigCamera camera;
+		camera.imagesFilename = (string) (*it)["images"];
+		camera.calibrationFilename = (string) (*it)["calibration"];
+		if (!readImageList(camera.imagesFilename, camera.imageList))
+		{
+			fprintf(stderr, "Could not read images list %s\n",
+					camera.imagesFilename.c_str());
+			return false;
+		}
+		if (!camera.intrinsics.read(camera.calibrationFilename))
+		{
+			fprintf(stderr, "Could not read intrinsics %s\n",
+					camera.calibrationFilename.c_str());
+			return false;
+		}
+		cameras.push_back(camera);
+	}
+
+	if (cameras.size() < 2)
+	{
+		fprintf(stderr, "Rig %s needs at least two cameras\n",
+				filename.c_str());
+		return false;
+	}
+
+	imageSize = cameras[0].intrinsics.imageSize;
+	for (size_t c = 1; c < cameras.size(); c++)
+	{
+		if (cameras[c].imageList.size() != cameras[0].imageList.size())
+		{
+			fprintf(stderr, "Images lists %s and %s are not synchronized\n",
+					cameras[0].imagesFilename.c_str(),
+					cameras[c].imagesFilename.c_str());
+			return false;
+		}
+		if (cameras[c].intrinsics.imageSize != imageSize)
+		{
+			fprintf(stderr, "Intrinsics %s and %s have different image sizes\n",
+					cameras[0].calibrationFilename.c_str(),
+					cameras[c].calibrationFilename.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Detect boards, solve the extrinsics and rectify each pair
+ */
+bool RigCalibrator::run()
+{
+	statistics = RigStatistics();
+	statistics.cameras = cameras.size();
+	statistics.views = cameras.empty() ? 0 : cameras[0].imageList.size();
+	statistics.workers = pool.size();
+
+	// detect all images of all cameras at once
+	Clock::time_point t = Clock::now();
+	vector<string> imageList;
+	for (size_t c = 0; c < cameras.size(); c++)
+	{
+		imageList.insert(imageList.end(),
+						 cameras[c].imageList.begin(),
+						 cameras[c].imageList.end());
+	}
+	ChessboardDetector detector(boardSize, findFlags);
+	BatchDetector batch(detector, pool);
+	vector<BatchView> views;
+	batch.run(imageList, views);
+
+	vector<BatchView>::const_iterator first = views.begin();
+	for (size_t c = 0; c < cameras.size(); c++)
+	{
+		vector<BatchView>::const_iterator last =
+			first + cameras[c].imageList.size();
+		cameras[c].views.assign(first, last);
+		first = last;
+	}
+	statistics.detectionTime = secondsSince(t);
+
+	// pair each camera with the reference camera on the views both found
+	// the board in
+	pairs.assign(cameras.size() - 1, RigPair());
+	for (size_t p = 0; p < pairs.size(); p++)
+	{
+		pairs[p].camera = p + 1;
+		for (size_t v = 0; v < statistics.views; v++)
+		{
+			const BatchView & reference = cameras[0].views[v];
+			const BatchView & view = cameras[p + 1].views[v];
+			if (reference.found && reference.imageSize == imageSize &&
+				view.found && view.imageSize == imageSize)
+			{
+				pairs[p].commonViews.push_back(v);
+			}
+		}
+	}
+
+	t = Clock::now();
+	for (size_t p = 0; p < pairs.size(); p++)
+	{
+		RigPair * pair = &pairs[p];
+		pool.submit([=] { solve(*pair); });
+	}
+	pool.wait();
+	statistics.solveTime = secondsSince(t);
+
+	t = Clock::now();
+	for (size_t p = 0; p < pairs.size(); p++)
+	{
+		RigPair * pair = &pairs[p];
+		if (pair->solved)
+		{
+			statistics.solved++;
+			pool.submit([=] { rectify(*pair); });
+		}
+	}
+	pool.wait();
+	statistics.rectifyTime = secondsSince(t);
+
+	return statistics.solved == pairs.size();
+}
+
+/*
+ * Save intrinsics, extrinsics and rectification of the rig
+ */
+bool RigCalibrator::save(const string & filename) const
+{
+	FileStorage fs(filename, FileStorage::WRITE);
+	if (!fs.isOpened())
+	{
+		return false;
+	}
+
+	time_t tt;
+	time(&tt);
+	struct tm * t2 = localtime(&tt);
+	char buf[1024];
+	strftime(buf, sizeof(buf) - 1, "%c", t2);
+
+	fs << "calibration_time" << buf;
+	fs << "nb_cameras" << (int) cameras.size();
+	fs << "image_width" << imageSize.width;
+	fs << "image_height" << imageSize.height;
+	fs << "board_width" << boardSize.width;
+	fs << "board_height" << boardSize.height;
+	fs << "square_size" << squareSize;
+
+	for (size_t c = 0; c < cameras.size(); c++)
+	{
+		char name[32];
+		sprintf(name, "camera_%u", (unsigned) c);
+		fs << name << "{";
+		fs << "images" << cameras[c].imagesFilename;
+		fs << "intrinsics" << cameras[c].calibrationFilename;
+		fs << "camera_matrix" << cameras[c].intrinsics.cameraMatrix;
+		fs << "distortion_coefficients" << cameras[c].intrinsics.distCoeffs;
+		if (c > 0)
+		{
+			const RigPair & pair = pairs[c - 1];
+			cvWriteComment(*fs,
+						   "pose relative to camera_0 : x = R * x0 + T",
+						   0);
+			fs << "common_views" << (int) pair.commonViews.size();
+			fs << "solved" << (int) pair.solved;
+			if (pair.solved)
+			{
+				fs << "avg_reprojection_error" << pair.error;
+				fs << "R" << pair.R;
+				fs << "T" << pair.T;
+				fs << "E" << pair.E;
+				fs << "F" << pair.F;
+				cvWriteComment(*fs,
+							   "rectification of the (camera_0, camera) pair",
+							   0);
+				fs << "R1" << pair.R1;
+				fs << "R2" << pair.R2;
+				fs << "P1" << pair.P1;
+				fs << "P2" << pair.P2;
+				fs << "Q" << pair.Q;
+			}
+		}
+		fs << "}";
+	}
+	return true;
+}
+
+/*
+ * Write the first common view of each solved pair rectified side by side
+ */
+void RigCalibrator::writeRectified(const string & prefix) const
+{
+	for (size_t p = 0; p < pairs.size(); p++)
+	{
+		const RigPair & pair = pairs[p];
+		if (!pair.solved)
+		{
+			continue;
+		}
+
+		size_t v = pair.commonViews[0];
+		Mat reference = imread(cameras[0].imageList[v], 1);
+		Mat view = imread(cameras[pair.camera].imageList[v], 1);
+		if (reference.empty() || view.empty())
+		{
+			continue;
+		}
+
+		Mat rectified(imageSize.height, 2 * imageSize.width, reference.type());
+		Mat left = rectified.colRange(0, imageSize.width);
+		Mat right = rectified.colRange(imageSize.width, 2 * imageSize.width);
+		Mat dst;
+		pair.referenceMaps.apply(reference, dst);
+		dst.copyTo(left);
+		pair.maps.apply(view, dst);
+		dst.copyTo(right);
+		for (int y = epipolarLinesStep; y < rectified.rows;
+			 y += epipolarLinesStep)
+		{
+			line(rectified,
+				 Point(0, y),
+				 Point(rectified.cols - 1, y),
+				 Scalar(0, 255, 0));
+		}
+
+		char suffix[64];
+		sprintf(suffix, "_rectified_0_%u.png", (unsigned) pair.camera);
+		imwrite(prefix + suffix, rectified);
+	}
+}
+
+/*
+ * Rig cameras
+ */
+const vector<RigCamera> & RigCalibrator::getCameras() const
+{
+	return cameras;
+}
+
+/*
+ * Reference camera pairs
+ */
+const vector<RigPair> & RigCalibrator::getPairs() const
+{
+	return pairs;
+}
+
+/*
+ * Report of the last run
+ */
+const RigStatistics & RigCalibrator::getStatistics() const
+{
+	return statistics;
+}
+
+/*
+ * Solve the relative pose of a pair
+ */
+void RigCalibrator::solve(RigPair & pair) const
+{
+	if (pair.commonViews.size() < minCommonViews)
+	{
+		fprintf(stderr, "Camera %u : only %u views in common with camera 0\n",
+				(unsigned) pair.camera,
+				(unsigned) pair.commonViews.size());
+		return;
+	}
+
+	const RigCamera & reference = cameras[0];
+	const RigCamera & camera = cameras[pair.camera];
+
+	vector<vector<Point3f> > objectPoints(1);
+	calcChessboardCorners(boardSize, squareSize, objectPoints[0]);
+	objectPoints.resize(pair.commonViews.size(), objectPoints[0]);
+
+	vector<vector<Point2f> > referencePoints, points;
+	for (size_t i = 0; i < pair.commonViews.size(); i++)
+	{
+		size_t v = pair.commonViews[i];
+		referencePoints.push_back(reference.views[v].corners);
+		points.push_back(camera.views[v].corners);
+	}
+
+	Mat K1 = reference.intrinsics.cameraMatrix.clone();
+	Mat D1 = reference.intrinsics.distCoeffs.clone();
+	Mat K2 = camera.intrinsics.cameraMatrix.clone();
+	Mat D2 = camera.intrinsics.distCoeffs.clone();
+	pair.error = stereoCalibrate(objectPoints,
+								 referencePoints,
+								 points,
+								 K1,
+								 D1,
+								 K2,
+								 D2,
+								 imageSize,
+								 pair.R,
+								 pair.T,
+								 pair.E,
+								 pair.F,
+								 CV_CALIB_FIX_INTRINSIC);
+	pair.solved = checkRange(pair.R) && checkRange(pair.T);
+}
+
+/*
+ * Rectify a solved pair and build its remap tables
+ */
+void RigCalibrator::rectify(RigPair & pair) const
+{
+	const RigCamera & reference = cameras[0];
+	const RigCamera & camera = cameras[pair.camera];
+
+	stereoRectify(reference.intrinsics.cameraMatrix,
+				  reference.intrinsics.distCoeffs,
+				  camera.intrinsics.cameraMatrix,
+				  camera.intrinsics.distCoeffs,
+				  imageSize,
+				  pair.R,
+				  pair.T,
+				  pair.R1,
+				  pair.R2,
+				  pair.P1,
+				  pair.P2,
+				  pair.Q);
+
+	pair.referenceMaps.setFormat(mapType, interpolation);
+	pair.referenceMaps.update(reference.intrinsics.cameraMatrix,
+							  reference.intrinsics.distCoeffs,
+							  imageSize,
+							  pair.P1,
+							  pair.R1);
+	pair.maps.setFormat(mapType, interpolation);
+	pair.maps.update(camera.intrinsics.cameraMatrix,
+					 camera.intrinsics.distCoeffs,
+					 imageSize,
+					 pair.P2,
+					 pair.R2);
+}
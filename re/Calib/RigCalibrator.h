@@ -0,0 +1,339 @@
+/*
+ * RigCalibrator.h
+ *
+ * Extrinsic calibration of a rig of cameras with known intrinsics.
+ */
+
+#ifndef RIGCALIBRATOR_H_
+#define RIGCALIBRATOR_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+#include "BatchDetector.h"
+#include "CalibrationSolver.h"
+#include "ThreadPool.h"
+#include "UndistortMaps.h"
+
+/**
+ * Camera of a rig
+ */
+struct RigCamera
+{
+	/**
+	 * Images list file name
+	 */
+	std::string imagesFilename;
+
+	/**
+	 * Images file names, synchronized with the other cameras lists
+	 */
+	std::vector<std::string> imageList;
+
+	/**
+	 * Intrinsic calibration file name (as written by calibration)
+	 */
+	std::string calibrationFilename;
+
+	/**
+	 * Intrinsic calibration
+	 */
+	CalibrationSeed intrinsics;
+
+	/**
+	 * Detection results of each image
+	 */
+	std::vector<BatchView> views;
+};
+
+/**
+ * Relative pose and rectification of a camera with respect to the
+ * reference camera (the first one)
+ */
+struct RigPair
+{
+	/**
+	 * Default constructor : not solved
+	 */
+	RigPair();
+
+	/**
+	 * Index of the camera in the rig
+	 */
+	size_t camera;
+
+	/**
+	 * Synchronized views the board was found in by both cameras
+	 */
+	std::vector<size_t> commonViews;
+
+	/**
+	 * Extrinsic calibration succeeded
+	 */
+	bool solved;
+
+	/**
+	 * RMS reprojection error of the extrinsic calibration
+	 */
+	double error;
+
+	/**
+	 * Rotation from the reference camera to this camera
+	 */
+	cv::Mat R;
+
+	/**
+	 * Translation from the reference camera to this camera
+	 */
+	cv::Mat T;
+
+	/**
+	 * Essential matrix
+	 */
+	cv::Mat E;
+
+	/**
+	 * Fundamental matrix
+	 */
+	cv::Mat F;
+
+	/**
+	 * Rectification rotation of the reference camera
+	 */
+	cv::Mat R1;
+
+	/**
+	 * Rectification rotation of this camera
+	 */
+	cv::Mat R2;
+
+	/**
+	 * Projection matrix of the rectified reference camera
+	 */
+	cv::Mat P1;
+
+	/**
+	 * Projection matrix of the rectified camera
+	 */
+	cv::Mat P2;
+
+	/**
+	 * Disparity to depth matrix
+	 */
+	cv::Mat Q;
+
+	/**
+	 * Rectification maps of the reference camera
+	 */
+	UndistortMaps referenceMaps;
+
+	/**
+	 * Rectification maps of this camera
+	 */
+	UndistortMaps maps;
+};
+
+/**
+ * Rig calibration report
+ */
+struct RigStatistics
+{
+	/**
+	 * Default constructor : nothing processed
+	 */
+	RigStatistics();
+
+	/**
+	 * Print views counts and phases timings
+	 * @param out the stream to print to
+	 */
+	void print(FILE * out) const;
+
+	/**
+	 * Number of cameras
+	 */
+	size_t cameras;
+
+	/**
+	 * Number of synchronized views
+	 */
+	size_t views;
+
+	/**
+	 * Number of solved pairs
+	 */
+	size_t solved;
+
+	/**
+	 * Number of workers used
+	 */
+	size_t workers;
+
+	/**
+	 * Detection phase elapsed time in seconds
+	 */
+	double detectionTime;
+
+	/**
+	 * Extrinsic calibration phase elapsed time in seconds
+	 */
+	double solveTime;
+
+	/**
+	 * Rectification and remap tables phase elapsed time in seconds
+	 */
+	double rectifyTime;
+};
+
+/**
+ * Extrinsic calibration of a rig of synchronized cameras.
+ * The rig is described by a FileStorage file with a cameras sequence, each
+ * camera having an images list (as written by imagelist_creator, the n-th
+ * image of every list being taken at the same time) and an intrinsic
+ * calibration file (as written by calibration) :
+ * @code
+ * %YAML:1.0
+ * cameras:
+ *    - { images: "left.xml", calibration: "left.yml" }
+ *    - { images: "right.xml", calibration: "right.yml" }
+ * @endcode
+ * Images of all cameras are detected at once on the pool, then the pose of
+ * each camera relative to the first one is solved with stereoCalibrate
+ * (intrinsics fixed) from the views the board was found in by both cameras,
+ * pairs being solved concurrently. Each pair is finally rectified and its
+ * remap tables built.
+ */
+class RigCalibrator
+{
+	public:
+		/**
+		 * Constructor
+		 * @param pool the workers pool running detection and solves
+		 * @param boardSize board size
+		 * @param squareSize square size on the chessboard
+		 * @param findFlags chessboard search flags
+		 * @param mapType rectification maps type
+		 * @param interpolation rectification remap interpolation
+		 */
+		RigCalibrator(ThreadPool & pool,
+					  cv::Size boardSize,
+					  float squareSize,
+					  int findFlags,
+					  int mapType = CV_16SC2,
+					  int interpolation = cv::INTER_LINEAR);
+
+		/**
+		 * Read the rig description, cameras images lists and intrinsics
+		 * @param filename the rig description file name
+		 * @return true if the rig is valid (at least two cameras with
+		 * images lists of the same length and intrinsics with the same image
+		 * size)
+		 */
+		bool read(const std::string & filename);
+
+		/**
+		 * Detect boards, solve the extrinsics and rectify each pair
+		 * @return true if all pairs were solved
+		 */
+		bool run();
+
+		/**
+		 * Save intrinsics, extrinsics and rectification of the rig
+		 * @param filename the output file name
+		 * @return true if the file was written
+		 */
+		bool save(const std::string & filename) const;
+
+		/**
+		 * Write the first common view of each solved pair rectified side by
+		 * side with horizontal epipolar lines
+		 * @param prefix output images prefix (<prefix>_rectified_0_<n>.png)
+		 */
+		void writeRectified(const std::string & prefix) const;
+
+		/**
+		 * Rig cameras
+		 * @return the rig cameras
+		 */
+		const std::vector<RigCamera> & getCameras() const;
+
+		/**
+		 * Reference camera pairs
+		 * @return the pair of each camera but the first one
+		 */
+		const std::vector<RigPair> & getPairs() const;
+
+		/**
+		 * Report of the last run
+		 * @return the report of the last run
+		 */
+		const RigStatistics & getStatistics() const;
+
+	private:
+		/**
+		 * Solve the relative pose of a pair
+		 * @param pair the pair
+		 */
+		void solve(RigPair & pair) const;
+
+		/**
+		 * Rectify a solved pair and build its remap tables
+		 * @param pair the pair
+		 */
+		void rectify(RigPair & pair) const;
+
+		/**
+		 * Workers pool
+		 */
+		ThreadPool & pool;
+
+		/**
+		 * Board size
+		 */
+		cv::Size boardSize;
+
+		/**
+		 * Square size on the chessboard
+		 */
+		float squareSize;
+
+		/**
+		 * Chessboard search flags
+		 */
+		int findFlags;
+
+		/**
+		 * Rectification maps type
+		 */
+		int mapType;
+
+		/**
+		 * Rectification remap interpolation
+		 */
+		int interpolation;
+
+		/**
+		 * Images size (common to all cameras)
+		 */
+		cv::Size imageSize;
+
+		/**
+		 * Rig cameras
+		 */
+		std::vector<RigCamera> cameras;
+
+		/**
+		 * Reference camera pairs
+		 */
+		std::vector<RigPair> pairs;
+
+		/**
+		 * Report of the last run
+		 */
+		RigStatistics statistics;
+};
+
+#endif /* RIGCALIBRATOR_H_ */
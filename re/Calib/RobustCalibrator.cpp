@@ -0,0 +1,280 @@
+/*
+ * RobustCalibrator.cpp
+ *
+ * Calibration with iterative rejection of outlier views.
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+#include "CalibrationSolver.h"
+#include "RobustCalibrator.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Minimum number of views kept by the robust calibration
+ */
+static const size_t minKeptViews = 4;
+
+/**
+ * Result of the calibration without one candidate view
+ */
+struct RejectionTrial
+{
+	bool ok;
+	double error;
+	double time;
+	Mat cameraMatrix;
+	Mat distCoeffs;
+	vector<Mat> rvecs;
+	vector<Mat> tvecs;
+	vector<float> errors;
+};
+
+/*
+ * Default constructor : nothing rejected
+ */
+RobustStatistics::RobustStatistics() :
+	solves(0),
+	workers(0),
+	wallTime(0),
+	solveTime(0)
+{
+}
+
+/*
+ * Print rejections, error trajectory and timings
+ */
+void RobustStatistics::print(FILE * out) const
+{
+	fprintf(out, "Robust calibration: %u views rejected, %u solves on %u "
+			"workers in %.3f s (parallel efficiency %.0f%%)\n",
+			(unsigned) rejected.size(),
+			(unsigned) solves,
+			(unsigned) workers,
+			wallTime,
+			wallTime > 0 && workers > 0 ?
+				100.0 * solveTime / (wallTime * workers) : 0.0);
+	fprintf(out, "  %-10s %12s %12s\n", "rejected", "view error", "rms after");
+	if (!trajectory.empty())
+	{
+		fprintf(out, "  %-10s %12s %12.4f\n", "-", "-", trajectory[0]);
+	}
+	for (size_t i = 0; i < rejected.size(); i++)
+	{
+		fprintf(out, "  %-10d %12.4f %12.4f\n",
+				rejected[i], rejectedErrors[i], trajectory[i + 1]);
+	}
+}
+
+/*
+ * Constructor
+ */
+RobustCalibrator::RobustCalibrator(ThreadPool & pool,
+								   double threshold,
+								   double percentile,
+								   double maxRejectedRatio,
+								   double minImprovement) :
+	pool(pool),
+	threshold(threshold),
+	percentile(percentile),
+	maxRejectedRatio(maxRejectedRatio),
+	minImprovement(minImprovement)
+{
+}
+
+/*
+ * Run the robust calibration
+ */
+bool RobustCalibrator::run(const vector<vector<Point2f> > & imagePoints,
+						   Size imageSize,
+						   Size boardSize,
+						   float squareSize,
+						   float aspectRatio,
+						   int flags,
+						   Mat & cameraMatrix,
+						   Mat & distCoeffs,
+						   vector<vector<Point2f> > & keptPoints,
+						   vector<Mat> & rvecs,
+						   vector<Mat> & tvecs,
+						   vector<float> & reprojErrs,
+						   double & totalAvgErr)
+{
+	Clock::time_point start = Clock::now();
+	statistics = RobustStatistics();
+	statistics.workers = pool.size();
+
+	// indices of the kept views in imagePoints
+	vector<int> kept;
+	for (size_t i = 0; i < imagePoints.size(); i++)
+	{
+		kept.push_back((int) i);
+	}
+	keptPoints = imagePoints;
+
+	Clock::time_point t = Clock::now();
+	bool ok = runCalibration(keptPoints,
+							 imageSize,
+							 boardSize,
+							 squareSize,
+							 aspectRatio,
+							 flags,
+							 cameraMatrix,
+							 distCoeffs,
+							 rvecs,
+							 tvecs,
+							 reprojErrs,
+							 totalAvgErr);
+	statistics.solveTime += secondsSince(t);
+	statistics.solves++;
+	if (!ok)
+	{
+		statistics.wallTime = secondsSince(start);
+		return false;
+	}
+	statistics.trajectory.push_back(totalAvgErr);
+
+	size_t minViews = std::max(minKeptViews,
+		(size_t) ceil((1.0 - maxRejectedRatio) * imagePoints.size()));
+
+	while (keptPoints.size() > minViews)
+	{
+		vector<size_t> candidates;
+		findCandidates(reprojErrs, candidates);
+		if (candidates.size() > pool.size())
+		{
+			candidates.resize(pool.size());
+		}
+		if (candidates.empty())
+		{
+			break;
+		}
+
+		// solve without each candidate concurrently
+		vector<RejectionTrial> trials(candidates.size());
+		for (size_t c = 0; c < candidates.size(); c++)
+		{
+			size_t removed = candidates[c];
+			RejectionTrial * trial = &trials[c];
+			const vector<vector<Point2f> > * points = &keptPoints;
+			pool.submit([=]
+			{
+				Clock::time_point t = Clock::now();
+				vector<vector<Point2f> > subset(*points);
+				subset.erase(subset.begin() + removed);
+				trial->ok = runCalibration(subset,
+										   imageSize,
+										   boardSize,
+										   squareSize,
+										   aspectRatio,
+										   flags,
+										   trial->cameraMatrix,
+										   trial->distCoeffs,
+										   trial->rvecs,
+										   trial->tvecs,
+										   trial->errors,
+										   trial->error,
+										   false);
+				trial->time = secondsSince(t);
+			});
+		}
+		pool.wait();
+
+		size_t best = trials.size();
+		for (size_t c = 0; c < trials.size(); c++)
+		{
+			statistics.solves++;
+			statistics.solveTime += trials[c].time;
+			if (trials[c].ok &&
+				(best == trials.size() || trials[c].error < trials[best].error))
+			{
+				best = c;
+			}
+		}
+
+		if (best == trials.size() ||
+			trials[best].error > (1.0 - minImprovement) * totalAvgErr)
+		{
+			break;
+		}
+
+		size_t removed = candidates[best];
+		statistics.rejected.push_back(kept[removed]);
+		statistics.rejectedErrors.push_back(reprojErrs[removed]);
+		kept.erase(kept.begin() + removed);
+		keptPoints.erase(keptPoints.begin() + removed);
+
+		cameraMatrix = trials[best].cameraMatrix;
+		distCoeffs = trials[best].distCoeffs;
+		rvecs = trials[best].rvecs;
+		tvecs = trials[best].tvecs;
+		reprojErrs = trials[best].errors;
+		totalAvgErr = trials[best].error;
+		statistics.trajectory.push_back(totalAvgErr);
+	}
+
+	statistics.wallTime = secondsSince(start);
+	return ok;
+}
+
+/*
+ * Report of the last run
+ */
+const RobustStatistics & RobustCalibrator::getStatistics() const
+{
+	return statistics;
+}
+
+/*
+ * Views which are rejection candidates, worst first
+ */
+void RobustCalibrator::findCandidates(const vector<float> & errors,
+									  vector<size_t> & candidates) const
+{
+	candidates.clear();
+	if (errors.empty())
+	{
+		return;
+	}
+
+	double percentileError = DBL_MAX;
+	if (percentile > 0)
+	{
+		vector<float> sorted(errors);
+		sort(sorted.begin(), sorted.end());
+		size_t rank = (size_t) floor(percentile / 100.0 * (sorted.size() - 1));
+		percentileError = sorted[std::min(rank, sorted.size() - 1)];
+	}
+
+	vector<pair<float, size_t> > ranked;
+	for (size_t i = 0; i < errors.size(); i++)
+	{
+		if ((threshold > 0 && errors[i] > threshold) ||
+			errors[i] > percentileError)
+		{
+			ranked.push_back(make_pair(errors[i], i));
+		}
+	}
+
+	sort(ranked.rbegin(), ranked.rend());
+	for (size_t i = 0; i < ranked.size(); i++)
+	{
+		candidates.push_back(ranked[i].second);
+	}
+}
@@ -0,0 +1,177 @@
+/*
+ * RobustCalibrator.h
+ *
+ * Calibration with iterative rejection of outlier views.
+ */
+
+#ifndef ROBUSTCALIBRATOR_H_
+#define ROBUSTCALIBRATOR_H_
+
+#include <cstdio>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+#include "ThreadPool.h"
+
+/**
+ * Robust calibration report
+ */
+struct RobustStatistics
+{
+	/**
+	 * Default constructor : nothing rejected
+	 */
+	RobustStatistics();
+
+	/**
+	 * Print rejections, error trajectory and timings
+	 * @param out the stream to print to
+	 */
+	void print(FILE * out) const;
+
+	/**
+	 * Indices of the rejected views (in the calibrated views order), in
+	 * rejection order
+	 */
+	std::vector<int> rejected;
+
+	/**
+	 * Per view error of each rejected view when it was rejected
+	 */
+	std::vector<float> rejectedErrors;
+
+	/**
+	 * RMS reprojection error of the initial solve then after each rejection
+	 */
+	std::vector<double> trajectory;
+
+	/**
+	 * Number of calibrations run
+	 */
+	size_t solves;
+
+	/**
+	 * Number of workers used to evaluate candidate rejections
+	 */
+	size_t workers;
+
+	/**
+	 * Elapsed (wall clock) time in seconds
+	 */
+	double wallTime;
+
+	/**
+	 * Time spent in calibrations summed over all workers in seconds
+	 */
+	double solveTime;
+};
+
+/**
+ * Calibration with iterative rejection of outlier views.
+ * After an initial solve, views whose error exceeds an absolute threshold or
+ * a percentile of the per view errors are rejection candidates. The worst
+ * candidates (as many as workers) are each removed from a copy of the views
+ * which is re-solved on the pool : the removal leading to the lowest error
+ * is kept, and the loop goes on until there is no candidate left, the error
+ * improvement becomes negligible or too many views have been rejected.
+ */
+class RobustCalibrator
+{
+	public:
+		/**
+		 * Constructor
+		 * @param pool the workers pool solving candidate rejections
+		 * @param threshold views with a larger error (in pixels) are
+		 * candidates (0 to disable)
+		 * @param percentile views above this percentile of the per view
+		 * errors are candidates (0 to disable)
+		 * @param maxRejectedRatio maximum fraction of the views that can be
+		 * rejected
+		 * @param minImprovement minimum relative error improvement to keep
+		 * rejecting views
+		 */
+		RobustCalibrator(ThreadPool & pool,
+						 double threshold,
+						 double percentile,
+						 double maxRejectedRatio = 0.2,
+						 double minImprovement = 0.01);
+
+		/**
+		 * Run the robust calibration
+		 * @param imagePoints chessboard image points on all views
+		 * @param imageSize image size
+		 * @param boardSize board size
+		 * @param squareSize square size on the chessboard
+		 * @param aspectRatio image aspect ratio
+		 * @param flags OpenCV calibration flags (see runCalibration)
+		 * @param cameraMatrix camera matrix
+		 * @param distCoeffs distortion coefficients
+		 * @param keptPoints image points of the kept views
+		 * @param rvecs rotation vectors of the kept views
+		 * @param tvecs translation vectors of the kept views
+		 * @param reprojErrs reprojection errors of the kept views
+		 * @param totalAvgErr total average error of the kept views
+		 * @return true if calibration went right
+		 */
+		bool run(const std::vector<std::vector<cv::Point2f> > & imagePoints,
+				 cv::Size imageSize,
+				 cv::Size boardSize,
+				 float squareSize,
+				 float aspectRatio,
+				 int flags,
+				 cv::Mat & cameraMatrix,
+				 cv::Mat & distCoeffs,
+				 std::vector<std::vector<cv::Point2f> > & keptPoints,
+				 std::vector<cv::Mat> & rvecs,
+				 std::vector<cv::Mat> & tvecs,
+				 std::vector<float> & reprojErrs,
+				 double & totalAvgErr);
+
+		/**
+		 * Report of the last run
+		 * @return the report of the last run
+		 */
+		const RobustStatistics & getStatistics() const;
+
+	private:
+		/**
+		 * Views which are rejection candidates, worst first
+		 * @param errors per view errors of the kept views
+		 * @param candidates indices (in errors) of the candidates
+		 */
+		void findCandidates(const std::vector<float> & errors,
+							std::vector<size_t> & candidates) const;
+
+		/**
+		 * Workers pool
+		 */
+		ThreadPool & pool;
+
+		/**
+		 * Absolute error threshold in pixels (0 if disabled)
+		 */
+		double threshold;
+
+		/**
+		 * Errors percentile threshold (0 if disabled)
+		 */
+		double percentile;
+
+		/**
+		 * Maximum fraction of rejected views
+		 */
+		double maxRejectedRatio;
+
+		/**
+		 * Minimum relative error improvement
+		 */
+		double minImprovement;
+
+		/**
+		 * Report of the last run
+		 */
+		RobustStatistics statistics;
+};
+
+#endif /* ROBUSTCALIBRATOR_H_ */
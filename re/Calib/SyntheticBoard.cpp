@@ -0,0 +1,299 @@
+/*
+ * SyntheticBoard.cpp
+ *
+ * Synthetic chessboard images rendered from a known camera.
+ */
+
+#include <cmath>
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "SyntheticBoard.h"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Gray level of the dark squares
+ */
+static const uchar darkLevel = 30;
+
+/**
+ * Gray level of the light squares and of the board margin
+ */
+static const uchar lightLevel = 225;
+
+/**
+ * Gray level of the background around the board
+ */
+static const uchar backgroundLevel = 110;
+
+/**
+ * Renders a range of rows of a board image by intersecting pixels rays with
+ * the board plane
+ */
+class RenderRows : public ParallelLoopBody
+{
+	public:
+		/**
+		 * Constructor
+		 * @param rays normalized coordinates of each pixel center
+		 * @param R board to camera rotation (3x3 CV_64FC1)
+		 * @param t board to camera translation
+		 * @param boardSize board size (in inner corners numbers)
+		 * @param squareSize board squares size
+		 * @param image the image to render (already allocated)
+		 */
+		RenderRows(const Mat & rays,
+				   const Mat & R,
+				   const Mat & t,
+				   Size boardSize,
+				   float squareSize,
+				   Mat & image) :
+			rays(rays),
+			boardSize(boardSize),
+			squareSize(squareSize),
+			image(image)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				r1[i] = R.at<double>(i, 0);
+				r2[i] = R.at<double>(i, 1);
+				n[i] = R.at<double>(i, 2);
+				this->t[i] = t.at<double>(i);
+			}
+			nt = n[0] * this->t[0] + n[1] * this->t[1] + n[2] * this->t[2];
+		}
+
+		/**
+		 * Render rows in range
+		 * @param range the rows range
+		 */
+		void operator()(const Range & range) const
+		{
+			// board squares span [-1, size] squares, margin one more square
+			double minX = -2.0 * squareSize;
+			double minY = -2.0 * squareSize;
+			double maxX = (boardSize.width + 1) * (double) squareSize;
+			double maxY = (boardSize.height + 1) * (double) squareSize;
+
+			for (int y = range.start; y < range.end; y++)
+			{
+				const Point2f * ray = rays.ptr<Point2f>(y);
+				uchar * pixel = image.ptr<uchar>(y);
+				for (int x = 0; x < rays.cols; x++)
+				{
+					double d[3] = { ray[x].x, ray[x].y, 1.0 };
+					double nd = n[0] * d[0] + n[1] * d[1] + n[2] * d[2];
+					double s = std::abs(nd) > 1e-12 ? nt / nd : -1;
+					if (s <= 0)
+					{
+						pixel[x] = backgroundLevel;
+						continue;
+					}
+
+					// intersection in board coordinates
+					double p[3] = { s * d[0] - t[0], s * d[1] - t[1],
+									s * d[2] - t[2] };
+					double bx = r1[0] * p[0] + r1[1] * p[1] + r1[2] * p[2];
+					double by = r2[0] * p[0] + r2[1] * p[1] + r2[2] * p[2];
+
+					if (bx < minX || bx >= maxX || by < minY || by >= maxY)
+					{
+						pixel[x] = backgroundLevel;
+					}
+					else if (bx < -squareSize || by < -squareSize ||
+							 bx >= boardSize.width * (double) squareSize ||
+							 by >= boardSize.height * (double) squareSize)
+					{
+						pixel[x] = lightLevel;
+					}
+					else
+					{
+						int qx = (int) floor(bx / squareSize) + 1;
+						int qy = (int) floor(by / squareSize) + 1;
+						pixel[x] = (qx + qy) % 2 == 0 ? darkLevel : lightLevel;
+					}
+				}
+			}
+		}
+
+	private:
+		const Mat & rays;
+		Size boardSize;
+		float squareSize;
+		Mat & image;
+		double r1[3];
+		double r2[3];
+		double n[3];
+		double t[3];
+		double nt;
+};
+
+/*
+ * Constructor
+ */
+SyntheticBoard::SyntheticBoard(Size imageSize,
+							   Size boardSize,
+							   float squareSize,
+							   const Mat & cameraMatrix,
+							   const Mat & distCoeffs) :
+	imageSize(imageSize),
+	boardSize(boardSize),
+	squareSize(squareSize),
+	blurSigma(0),
+	noiseSigma(0)
+{
+	cameraMatrix.convertTo(this->cameraMatrix, CV_64F);
+	distCoeffs.convertTo(this->distCoeffs, CV_64F);
+
+	// pixel centers back projected once, one row at a time
+	rays.create(imageSize, CV_32FC2);
+	vector<Point2f> pixels(imageSize.width);
+	vector<Point2f> normalized;
+	for (int y = 0; y < imageSize.height; y++)
+	{
+		for (int x = 0; x < imageSize.width; x++)
+		{
+			pixels[x] = Point2f((float) x, (float) y);
+		}
+		undistortPoints(pixels, normalized, this->cameraMatrix, this->distCoeffs);
+		Point2f * row = rays.ptr<Point2f>(y);
+		for (int x = 0; x < imageSize.width; x++)
+		{
+			row[x] = normalized[x];
+		}
+	}
+}
+
+/*
+ * Set images degradation
+ */
+void SyntheticBoard::setDegradation(double blurSigma, double noiseSigma)
+{
+	this->blurSigma = blurSigma;
+	this->noiseSigma = noiseSigma;
+}
+
+/*
+ * Draw a random visible board pose
+ */
+bool SyntheticBoard::randomPose(RNG & rng,
+								Mat & rvec,
+								Mat & tvec,
+								double maxTilt) const
+{
+	double fx = cameraMatrix.at<double>(0, 0);
+	double fy = cameraMatrix.at<double>(1, 1);
+	double boardWidth = (boardSize.width + 3) * (double) squareSize;
+	Point3d center((boardSize.width - 1) * squareSize / 2.0,
+				   (boardSize.height - 1) * squareSize / 2.0,
+				   0);
+
+	// outer corners of the margin must be in the image
+	vector<Point3f> outline;
+	float x0 = -2 * squareSize, y0 = -2 * squareSize;
+	float x1 = (boardSize.width + 1) * squareSize;
+	float y1 = (boardSize.height + 1) * squareSize;
+	outline.push_back(Point3f(x0, y0, 0));
+	outline.push_back(Point3f(x1, y0, 0));
+	outline.push_back(Point3f(x1, y1, 0));
+	outline.push_back(Point3f(x0, y1, 0));
+
+	const double degrees = CV_PI / 180.0;
+	for (int attempt = 0; attempt < 100; attempt++)
+	{
+		double ax = rng.uniform(-maxTilt, maxTilt) * degrees;
+		double ay = rng.uniform(-maxTilt, maxTilt) * degrees;
+		double az = rng.uniform(-30.0, 30.0) * degrees;
+		Mat Rx, Ry, Rz;
+		Rodrigues(Mat(Vec3d(ax, 0, 0)), Rx);
+		Rodrigues(Mat(Vec3d(0, ay, 0)), Ry);
+		Rodrigues(Mat(Vec3d(0, 0, az)), Rz);
+		Mat R = Rz * Ry * Rx;
+
+		double span = rng.uniform(0.3, 0.6);
+		double z = fx * boardWidth / (span * imageSize.width);
+		Point3d position(rng.uniform(-0.25, 0.25) * z * imageSize.width / fx,
+						 rng.uniform(-0.25, 0.25) * z * imageSize.height / fy,
+						 z);
+
+		// board center placed at position
+		Mat c = R * Mat(center);
+		tvec = (Mat_<double>(3, 1) << position.x - c.at<double>(0),
+										position.y - c.at<double>(1),
+										position.z - c.at<double>(2));
+		Rodrigues(R, rvec);
+
+		vector<Point2f> projected;
+		projectPoints(outline, rvec, tvec, cameraMatrix, distCoeffs, projected);
+		bool visible = true;
+		for (size_t i = 0; i < projected.size(); i++)
+		{
+			visible = visible &&
+				projected[i].x >= 5 && projected[i].x < imageSize.width - 5 &&
+				projected[i].y >= 5 && projected[i].y < imageSize.height - 5;
+		}
+		if (visible)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Render the board in a pose
+ */
+void SyntheticBoard::render(const Mat & rvec,
+							const Mat & tvec,
+							RNG & rng,
+							Mat & image,
+							vector<Point2f> & corners) const
+{
+	Mat R, t;
+	Rodrigues(rvec, R);
+	tvec.convertTo(t, CV_64F);
+
+	image.create(imageSize, CV_8UC1);
+	parallel_for_(Range(0, imageSize.height),
+				  RenderRows(rays, R, t, boardSize, squareSize, image));
+
+	if (blurSigma > 0)
+	{
+		GaussianBlur(image, image, Size(0, 0), blurSigma);
+	}
+	if (noiseSigma > 0)
+	{
+		Mat noisy, noise(imageSize, CV_32F);
+		rng.fill(noise, RNG::NORMAL, 0, noiseSigma);
+		image.convertTo(noisy, CV_32F);
+		noisy += noise;
+		noisy.convertTo(image, CV_8U);
+	}
+
+	vector<Point3f> pattern;
+	for (int i = 0; i < boardSize.height; i++)
+	{
+		for (int j = 0; j < boardSize.width; j++)
+		{
+			pattern.push_back(Point3f(j * squareSize, i * squareSize, 0));
+		}
+	}
+	projectPoints(pattern, rvec, tvec, cameraMatrix, distCoeffs, corners);
+}
+
+/*
+ * Ground truth camera used by default
+ */
+void SyntheticBoard::defaultCamera(Size imageSize,
+								   Mat & cameraMatrix,
+								   Mat & distCoeffs)
+{
+	double f = 0.9 * imageSize.width;
+	cameraMatrix = (Mat_<double>(3, 3) << f, 0, (imageSize.width - 1) / 2.0,
+										  0, f, (imageSize.height - 1) / 2.0,
+										  0, 0, 1);
+	distCoeffs = (Mat_<double>(5, 1) << -0.2, 0.08, 0.001, -0.0005, 0);
+}
@@ -0,0 +1,136 @@
+/*
+ * SyntheticBoard.h
+ *
+ * Synthetic chessboard images rendered from a known camera.
+ */
+
+#ifndef SYNTHETICBOARD_H_
+#define SYNTHETICBOARD_H_
+
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+/**
+ * Chessboard images rendered through a ground truth camera (camera matrix
+ * and distortion coefficients), for benchmarks whose detections and
+ * calibrations can be checked against the truth.
+ * The board has (boardSize.width + 1) x (boardSize.height + 1) squares and a
+ * white margin of one square, over a uniform background. Each pixel center
+ * is back projected once (distortion removed) when the renderer is built,
+ * so rendering a pose only intersects these rays with the board plane.
+ * Images are then blurred and corrupted by gaussian noise.
+ * A renderer holds no state besides its settings so a single instance can
+ * be shared by several threads.
+ */
+class SyntheticBoard
+{
+	public:
+		/**
+		 * Constructor
+		 * @param imageSize rendered images size
+		 * @param boardSize board size (in inner corners numbers)
+		 * @param squareSize board squares size
+		 * @param cameraMatrix ground truth camera matrix
+		 * @param distCoeffs ground truth distortion coefficients
+		 */
+		SyntheticBoard(cv::Size imageSize,
+					   cv::Size boardSize,
+					   float squareSize,
+					   const cv::Mat & cameraMatrix,
+					   const cv::Mat & distCoeffs);
+
+		/**
+		 * Set images degradation
+		 * @param blurSigma gaussian blur standard deviation in pixels (0 for
+		 * no blur)
+		 * @param noiseSigma gaussian noise standard deviation in gray levels
+		 * (0 for no noise)
+		 */
+		void setDegradation(double blurSigma, double noiseSigma);
+
+		/**
+		 * Draw a random board pose with the whole board (margin included)
+		 * visible : board spanning 30 to 60% of the image width, tilted up
+		 * to maxTilt degrees around both board axes and rolled up to 30
+		 * degrees
+		 * @param rng the random numbers generator
+		 * @param rvec the board rotation vector
+		 * @param tvec the board translation vector
+		 * @param maxTilt maximum tilt in degrees
+		 * @return true if a visible pose was found
+		 */
+		bool randomPose(cv::RNG & rng,
+						cv::Mat & rvec,
+						cv::Mat & tvec,
+						double maxTilt = 40) const;
+
+		/**
+		 * Render the board in a pose
+		 * @param rvec the board rotation vector
+		 * @param tvec the board translation vector
+		 * @param rng the random numbers generator of the noise
+		 * @param image the rendered gray level image
+		 * @param corners the ground truth inner corners in the image
+		 */
+		void render(const cv::Mat & rvec,
+					const cv::Mat & tvec,
+					cv::RNG & rng,
+					cv::Mat & image,
+					std::vector<cv::Point2f> & corners) const;
+
+		/**
+		 * Ground truth camera used by default : 90% of the image width focal
+		 * length, centered principal point and moderate barrel distortion
+		 * @param imageSize images size
+		 * @param cameraMatrix the camera matrix
+		 * @param distCoeffs the distortion coefficients (k1, k2, p1, p2, k3)
+		 */
+		static void defaultCamera(cv::Size imageSize,
+								  cv::Mat & cameraMatrix,
+								  cv::Mat & distCoeffs);
+
+	private:
+		/**
+		 * Rendered images size
+		 */
+		cv::Size imageSize;
+
+		/**
+		 * Board size (in inner corners numbers)
+		 */
+		cv::Size boardSize;
+
+		/**
+		 * Board squares size
+		 */
+		float squareSize;
+
+		/**
+		 * Ground truth camera matrix
+		 */
+		cv::Mat cameraMatrix;
+
+		/**
+		 * Ground truth distortion coefficients
+		 */
+		cv::Mat distCoeffs;
+
+		/**
+		 * Gaussian blur standard deviation
+		 */
+		double blurSigma;
+
+		/**
+		 * Gaussian noise standard deviation
+		 */
+		double noiseSigma;
+
+		/**
+		 * Normalized (distortion free) coordinates of each pixel center
+		 * (CV_32FC2)
+		 */
+		cv::Mat rays;
+};
+
+#endif /* SYNTHETICBOARD_H_ */
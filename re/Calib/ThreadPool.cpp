@@ -0,0 +1,129 @@
+/*
+ * ThreadPool.cpp
+ *
+ * Fixed size pool of worker threads fed through a bounded task queue.
+ */
+
+#include <cstdio>
+#include <exception>
+
+#include "ThreadPool.h"
+
+/*
+ * Constructor.
+ * Starts the worker threads.
+ */
+ThreadPool::ThreadPool(size_t nbThreads, size_t queueCapacity) :
+	tasks(queueCapacity > 0 ? queueCapacity :
+		  2 * (nbThreads > 0 ? nbThreads : defaultThreadCount())),
+	nbPending(0)
+{
+	if (nbThreads == 0)
+	{
+		nbThreads = defaultThreadCount();
+	}
+
+	for (size_t i = 0; i < nbThreads; i++)
+	{
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+/*
+ * Destructor.
+ * Waits for all pending tasks to complete then joins the workers
+ */
+ThreadPool::~ThreadPool()
+{
+	wait();
+	tasks.close();
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+/*
+ * Submit a new task to the pool
+ */
+void ThreadPool::submit(const Task & task)
+{
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		nbPending++;
+	}
+
+	if (!tasks.push(task))
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		nbPending--;
+		if (nbPending == 0)
+		{
+			allDone.notify_all();
+		}
+	}
+}
+
+/*
+ * Wait until all submitted tasks have been completed
+ */
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(pendingMutex);
+	allDone.wait(lock, [this] { return nbPending == 0; });
+}
+
+/*
+ * Number of worker threads
+ */
+size_t ThreadPool::size() const
+{
+	return workers.size();
+}
+
+/*
+ * Number of tasks submitted but not yet completed
+ */
+size_t ThreadPool::pending() const
+{
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	return nbPending;
+}
+
+/*
+ * Default number of workers
+ */
+size_t ThreadPool::defaultThreadCount()
+{
+	unsigned int n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+/*
+ * Worker threads main loop
+ */
+void ThreadPool::workerLoop()
+{
+	Task task;
+	while (tasks.pop(task))
+	{
+		try
+		{
+			task();
+		}
+		catch (const std::exception & e)
+		{
+			fprintf(stderr, "ThreadPool: task failed: %s\n", e.what());
+		}
+
+		// release task resources before signaling completion
+		task = Task();
+
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		nbPending--;
+		if (nbPending == 0)
+		{
+			allDone.notify_all();
+		}
+	}
+}
@@ -0,0 +1,117 @@
+/*
+ * ThreadPool.h
+ *
+ * Fixed size pool of worker threads fed through a bounded task queue.
+ */
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+#include "BoundedQueue.h"
+
+/**
+ * Fixed size pool of worker threads.
+ * Tasks are queued in a bounded queue so that producers submitting faster
+ * than the workers can process are blocked instead of piling up work (and
+ * memory) in the queue.
+ */
+class ThreadPool
+{
+	public:
+		/**
+		 * Task type run by the workers
+		 */
+		typedef std::function<void()> Task;
+
+		/**
+		 * Constructor.
+		 * Starts the worker threads.
+		 * @param nbThreads number of worker threads. If 0 the number of
+		 * hardware threads is used
+		 * @param queueCapacity maximum number of pending tasks. If 0 twice the
+		 * number of workers is used
+		 */
+		explicit ThreadPool(size_t nbThreads = 0, size_t queueCapacity = 0);
+
+		/**
+		 * Destructor.
+		 * Waits for all pending tasks to complete then joins the workers
+		 */
+		~ThreadPool();
+
+		/**
+		 * Submit a new task to the pool, waiting for room in the task queue
+		 * if it is full
+		 * @param task the task to run
+		 */
+		void submit(const Task & task);
+
+		/**
+		 * Wait until all submitted tasks have been completed
+		 */
+		void wait();
+
+		/**
+		 * Number of worker threads
+		 * @return the number of worker threads
+		 */
+		size_t size() const;
+
+		/**
+		 * Number of tasks submitted but not yet completed
+		 * @return the number of pending tasks
+		 */
+		size_t pending() const;
+
+		/**
+		 * Default number of workers : the number of hardware threads (or 1
+		 * if it can not be determined)
+		 * @return the default number of workers
+		 */
+		static size_t defaultThreadCount();
+
+	private:
+		/**
+		 * Worker threads main loop : pops and run tasks until the queue is
+		 * closed
+		 */
+		void workerLoop();
+
+		/**
+		 * Pending tasks queue
+		 */
+		BoundedQueue<Task> tasks;
+
+		/**
+		 * Worker threads
+		 */
+		std::vector<std::thread> workers;
+
+		/**
+		 * Number of submitted tasks not yet completed
+		 */
+		size_t nbPending;
+
+		/**
+		 * Lock protecting nbPending
+		 */
+		mutable std::mutex pendingMutex;
+
+		/**
+		 * Signaled when nbPending drops to 0
+		 */
+		std::condition_variable allDone;
+
+		// Non copyable
+		ThreadPool(const ThreadPool &);
+		ThreadPool & operator =(const ThreadPool &);
+};
+
+#endif /* THREADPOOL_H_ */
@@ -0,0 +1,393 @@
+/*
+ * UncertaintyEstimator.cpp
+ *
+ * Calibration uncertainty estimation by resampling the views.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "CalibrationSolver.h"
+#include "UncertaintyEstimator.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Seed of the resamples random generators
+ */
+static const uint64 resamplingSeed = 0x5eed;
+
+/**
+ * Result of one resample calibration
+ */
+struct ResampleTrial
+{
+	bool ok;
+	double time;
+	Mat parameters;
+	double squaredError;
+	size_t points;
+};
+
+/**
+ * Mean and standard deviation of each parameter over successful trials
+ * @param trials the trials
+ * @param mean the mean of each parameter
+ * @param stdDev the standard deviation of each parameter
+ * @return the number of successful trials
+ */
+static int parametersSpread(const vector<ResampleTrial> & trials,
+							Mat & mean,
+							Mat & stdDev)
+{
+	const int n = UncertaintyStatistics::NB_PARAMETERS;
+	mean = Mat::zeros(1, n, CV_64F);
+	stdDev = Mat::zeros(1, n, CV_64F);
+
+	int count = 0;
+	for (size_t i = 0; i < trials.size(); i++)
+	{
+		if (trials[i].ok)
+		{
+			mean += trials[i].parameters;
+			count++;
+		}
+	}
+	if (count == 0)
+	{
+		return 0;
+	}
+	mean /= count;
+
+	for (size_t i = 0; i < trials.size(); i++)
+	{
+		if (trials[i].ok)
+		{
+			Mat d = trials[i].parameters - mean;
+			stdDev += d.mul(d);
+		}
+	}
+	stdDev /= std::max(count - 1, 1);
+	sqrt(stdDev, stdDev);
+	return count;
+}
+
+const char * const
+UncertaintyStatistics::parameterNames[UncertaintyStatistics::NB_PARAMETERS] =
+{
+	"fx", "fy", "cx", "cy", "k1", "k2", "p1", "p2", "k3"
+};
+
+/*
+ * Default constructor : nothing estimated
+ */
+UncertaintyStatistics::UncertaintyStatistics() :
+	bootstrapSamples(0),
+	folds(0),
+	heldOutError(0),
+	workers(0),
+	wallTime(0),
+	solveTime(0)
+{
+}
+
+/*
+ * Print parameters deviations, held out error and timings
+ */
+void UncertaintyStatistics::print(FILE * out) const
+{
+	fprintf(out, "Uncertainty: %d bootstrap samples, %d folds on %u workers "
+			"in %.3f s (parallel efficiency %.0f%%)\n",
+			bootstrapSamples,
+			folds,
+			(unsigned) workers,
+			wallTime,
+			wallTime > 0 && workers > 0 ?
+				100.0 * solveTime / (wallTime * workers) : 0.0);
+
+	if (bootstrapSamples > 0 || folds > 0)
+	{
+		fprintf(out, "  %-4s %14s %14s %14s\n",
+				"", "bootstrap mean", "bootstrap std", "folds std");
+		for (int i = 0; i < NB_PARAMETERS; i++)
+		{
+			fprintf(out, "  %-4s %14.6g %14.6g %14.6g\n",
+					parameterNames[i],
+					bootstrapSamples > 0 ? bootstrapMean.at<double>(i) : 0.0,
+					bootstrapSamples > 0 ? bootstrapStdDev.at<double>(i) : 0.0,
+					folds > 0 ? foldStdDev.at<double>(i) : 0.0);
+		}
+	}
+
+	if (folds > 0)
+	{
+		fprintf(out, "  held out error %.4f (folds:", heldOutError);
+		for (size_t i = 0; i < foldErrors.size(); i++)
+		{
+			fprintf(out, " %.4f", foldErrors[i]);
+		}
+		fprintf(out, ")\n");
+	}
+
+	if (!scaling.empty())
+	{
+		fprintf(out, "  %-8s %10s %8s\n", "workers", "time (s)", "speedup");
+		for (size_t i = 0; i < scaling.size(); i++)
+		{
+			fprintf(out, "  %-8u %10.3f %8.2f\n",
+					(unsigned) scaling[i].first,
+					scaling[i].second,
+					scaling[i].second > 0 ?
+						scaling[0].second / scaling[i].second : 0.0);
+		}
+	}
+}
+
+/*
+ * Constructor
+ */
+UncertaintyEstimator::UncertaintyEstimator(
+	const vector<vector<Point2f> > & imagePoints,
+	Size imageSize,
+	Size boardSize,
+	float squareSize,
+	float aspectRatio,
+	int flags) :
+	imagePoints(imagePoints),
+	imageSize(imageSize),
+	boardSize(boardSize),
+	squareSize(squareSize),
+	aspectRatio(aspectRatio),
+	flags(flags)
+{
+}
+
+/*
+ * Run bootstrap and / or cross validation
+ */
+void UncertaintyEstimator::run(ThreadPool & pool, int samples, int folds)
+{
+	Clock::time_point start = Clock::now();
+	vector<pair<size_t, double> > scaling(statistics.scaling);
+	statistics = UncertaintyStatistics();
+	statistics.scaling = scaling;
+	statistics.workers = pool.size();
+
+	const size_t nbViews = imagePoints.size();
+	folds = std::min(folds, (int) nbViews);
+	if (folds < 2)
+	{
+		folds = 0;
+	}
+
+	// bootstrap resamples
+	vector<ResampleTrial> bootstrapTrials(std::max(samples, 0));
+	for (size_t s = 0; s < bootstrapTrials.size(); s++)
+	{
+		ResampleTrial * trial = &bootstrapTrials[s];
+		pool.submit([=]
+		{
+			Clock::time_point t = Clock::now();
+			RNG rng(resamplingSeed + s);
+			vector<size_t> views(nbViews);
+			for (size_t i = 0; i < nbViews; i++)
+			{
+				views[i] = (size_t) rng.uniform(0, (int) nbViews);
+			}
+			Mat cameraMatrix, distCoeffs;
+			trial->ok = calibrate(views,
+								  trial->parameters,
+								  cameraMatrix,
+								  distCoeffs);
+			trial->time = secondsSince(t);
+		});
+	}
+
+	// cross validation folds : views are shuffled once, then fold f holds
+	// every folds-th shuffled view starting at f
+	vector<size_t> order(nbViews);
+	for (size_t i = 0; i < nbViews; i++)
+	{
+		order[i] = i;
+	}
+	RNG rng(resamplingSeed);
+	for (size_t i = nbViews; i > 1; i--)
+	{
+		std::swap(order[i - 1], order[(size_t) rng.uniform(0, (int) i)]);
+	}
+
+	vector<ResampleTrial> foldTrials(folds);
+	for (size_t f = 0; f < foldTrials.size(); f++)
+	{
+		ResampleTrial * trial = &foldTrials[f];
+		const vector<size_t> * shuffled = &order;
+		pool.submit([=]
+		{
+			Clock::time_point t = Clock::now();
+			vector<size_t> training;
+			vector<vector<Point2f> > heldOut;
+			for (size_t i = 0; i < nbViews; i++)
+			{
+				size_t view = (*shuffled)[i];
+				if (i % (size_t) folds == f)
+				{
+					heldOut.push_back(imagePoints[view]);
+				}
+				else
+				{
+					training.push_back(view);
+				}
+			}
+
+			Mat cameraMatrix, distCoeffs;
+			trial->ok = calibrate(training,
+								  trial->parameters,
+								  cameraMatrix,
+								  distCoeffs);
+			if (trial->ok)
+			{
+				vector<float> errors;
+				double error = evaluateCalibration(heldOut,
+												   boardSize,
+												   squareSize,
+												   cameraMatrix,
+												   distCoeffs,
+												   errors);
+				trial->points = heldOut.size() *
+					(size_t) (boardSize.width * boardSize.height);
+				trial->squaredError = error * error * trial->points;
+			}
+			trial->time = secondsSince(t);
+		});
+	}
+
+	pool.wait();
+
+	for (size_t s = 0; s < bootstrapTrials.size(); s++)
+	{
+		statistics.solveTime += bootstrapTrials[s].time;
+	}
+	statistics.bootstrapSamples = parametersSpread(bootstrapTrials,
+												   statistics.bootstrapMean,
+												   statistics.bootstrapStdDev);
+
+	double squaredError = 0;
+	size_t points = 0;
+	for (size_t f = 0; f < foldTrials.size(); f++)
+	{
+		const ResampleTrial & trial = foldTrials[f];
+		statistics.solveTime += trial.time;
+		if (trial.ok)
+		{
+			statistics.foldErrors.push_back(
+				sqrt(trial.squaredError / trial.points));
+			squaredError += trial.squaredError;
+			points += trial.points;
+		}
+	}
+	Mat foldMean;
+	if (parametersSpread(foldTrials, foldMean, statistics.foldStdDev) > 0)
+	{
+		statistics.folds = folds;
+		statistics.heldOutError = sqrt(squaredError / points);
+	}
+
+	statistics.wallTime = secondsSince(start);
+}
+
+/*
+ * Run the same resampling with 1, 2, 4 ... maxThreads workers and record
+ * elapsed times
+ */
+void UncertaintyEstimator::measureScaling(size_t maxThreads,
+										  int samples,
+										  int folds)
+{
+	vector<pair<size_t, double> > scaling;
+	for (size_t n = 1; ; n = std::min(2 * n, maxThreads))
+	{
+		ThreadPool pool(n);
+		run(pool, samples, folds);
+		scaling.push_back(make_pair(n, statistics.wallTime));
+		if (n >= maxThreads)
+		{
+			break;
+		}
+	}
+	statistics.scaling = scaling;
+}
+
+/*
+ * Report of the last run
+ */
+const UncertaintyStatistics & UncertaintyEstimator::getStatistics() const
+{
+	return statistics;
+}
+
+/*
+ * Calibrate a subset of the views
+ */
+bool UncertaintyEstimator::calibrate(const vector<size_t> & views,
+									 Mat & parameters,
+									 Mat & cameraMatrix,
+									 Mat & distCoeffs) const
+{
+	vector<vector<Point2f> > subset;
+	subset.reserve(views.size());
+	for (size_t i = 0; i < views.size(); i++)
+	{
+		subset.push_back(imagePoints[views[i]]);
+	}
+
+	vector<Mat> rvecs, tvecs;
+	vector<float> reprojErrs;
+	double totalAvgErr = 0;
+	bool ok = runCalibration(subset,
+							 imageSize,
+							 boardSize,
+							 squareSize,
+							 aspectRatio,
+							 flags,
+							 cameraMatrix,
+							 distCoeffs,
+							 rvecs,
+							 tvecs,
+							 reprojErrs,
+							 totalAvgErr,
+							 false);
+	if (!ok)
+	{
+		return false;
+	}
+
+	Mat K, D;
+	cameraMatrix.convertTo(K, CV_64F);
+	distCoeffs.convertTo(D, CV_64F);
+	D = D.reshape(1, 1);
+	parameters.create(1, UncertaintyStatistics::NB_PARAMETERS, CV_64F);
+	parameters.at<double>(0) = K.at<double>(0, 0);
+	parameters.at<double>(1) = K.at<double>(1, 1);
+	parameters.at<double>(2) = K.at<double>(0, 2);
+	parameters.at<double>(3) = K.at<double>(1, 2);
+	for (int i = 0; i < 5; i++)
+	{
+		parameters.at<double>(4 + i) =
+			i < (int) D.total() ? D.at<double>(i) : 0.0;
+	}
+	return true;
+}
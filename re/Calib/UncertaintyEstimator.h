@@ -0,0 +1,212 @@
+/*
+ * UncertaintyEstimator.h
+ *
+ * Calibration uncertainty estimation by resampling the views.
+ */
+
+#ifndef UNCERTAINTYESTIMATOR_H_
+#define UNCERTAINTYESTIMATOR_H_
+
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+#include "ThreadPool.h"
+
+/**
+ * Uncertainty estimation report.
+ * Parameters are ordered as fx, fy, cx, cy, k1, k2, p1, p2, k3.
+ */
+struct UncertaintyStatistics
+{
+	/**
+	 * Number of estimated parameters
+	 */
+	static const int NB_PARAMETERS = 9;
+
+	/**
+	 * Parameters names
+	 */
+	static const char * const parameterNames[NB_PARAMETERS];
+
+	/**
+	 * Default constructor : nothing estimated
+	 */
+	UncertaintyStatistics();
+
+	/**
+	 * Print parameters deviations, held out error and timings
+	 * @param out the stream to print to
+	 */
+	void print(FILE * out) const;
+
+	/**
+	 * Number of successful bootstrap calibrations (0 if bootstrap was not
+	 * run)
+	 */
+	int bootstrapSamples;
+
+	/**
+	 * Mean of the parameters over bootstrap calibrations (1 x NB_PARAMETERS)
+	 */
+	cv::Mat bootstrapMean;
+
+	/**
+	 * Standard deviation of the parameters over bootstrap calibrations
+	 * (1 x NB_PARAMETERS)
+	 */
+	cv::Mat bootstrapStdDev;
+
+	/**
+	 * Number of cross validation folds (0 if cross validation was not run)
+	 */
+	int folds;
+
+	/**
+	 * RMS reprojection error of each fold views with the intrinsics
+	 * calibrated on the other folds
+	 */
+	std::vector<double> foldErrors;
+
+	/**
+	 * RMS reprojection error of all held out views
+	 */
+	double heldOutError;
+
+	/**
+	 * Standard deviation of the parameters over folds calibrations
+	 * (1 x NB_PARAMETERS)
+	 */
+	cv::Mat foldStdDev;
+
+	/**
+	 * Number of workers used
+	 */
+	size_t workers;
+
+	/**
+	 * Elapsed (wall clock) time in seconds
+	 */
+	double wallTime;
+
+	/**
+	 * Time spent in calibrations summed over all workers in seconds
+	 */
+	double solveTime;
+
+	/**
+	 * Elapsed time of the same resampling for an increasing number of
+	 * workers (empty if scaling was not measured)
+	 */
+	std::vector<std::pair<size_t, double> > scaling;
+};
+
+/**
+ * Calibration uncertainty estimation by resampling the already detected
+ * views :
+ * 	- bootstrap : views are drawn with replacement to build each resample,
+ * 	the spread of the parameters over the resamples calibrations estimates
+ * 	their standard deviations
+ * 	- k-fold cross validation : views are split in k folds, each fold is
+ * 	evaluated with the intrinsics calibrated on the other folds
+ * All calibrations are independent and run concurrently on the pool.
+ * Resamples are drawn from a fixed seed so results do not depend on the
+ * number of workers.
+ */
+class UncertaintyEstimator
+{
+	public:
+		/**
+		 * Constructor
+		 * @param imagePoints chessboard image points on all views
+		 * @param imageSize image size
+		 * @param boardSize board size
+		 * @param squareSize square size on the chessboard
+		 * @param aspectRatio image aspect ratio
+		 * @param flags OpenCV calibration flags (see runCalibration)
+		 */
+		UncertaintyEstimator(
+			const std::vector<std::vector<cv::Point2f> > & imagePoints,
+			cv::Size imageSize,
+			cv::Size boardSize,
+			float squareSize,
+			float aspectRatio,
+			int flags);
+
+		/**
+		 * Run bootstrap and / or cross validation
+		 * @param pool the workers pool running the calibrations
+		 * @param samples number of bootstrap resamples (0 to skip bootstrap)
+		 * @param folds number of cross validation folds (0 to skip cross
+		 * validation)
+		 */
+		void run(ThreadPool & pool, int samples, int folds);
+
+		/**
+		 * Run the same resampling with 1, 2, 4 ... maxThreads workers and
+		 * record elapsed times
+		 * @param maxThreads the largest number of workers
+		 * @param samples number of bootstrap resamples
+		 * @param folds number of cross validation folds
+		 */
+		void measureScaling(size_t maxThreads, int samples, int folds);
+
+		/**
+		 * Report of the last run
+		 * @return the report of the last run
+		 */
+		const UncertaintyStatistics & getStatistics() const;
+
+	private:
+		/**
+		 * Calibrate a subset of the views
+		 * @param views indices of the views (may be repeated)
+		 * @param parameters the calibrated parameters (1 x NB_PARAMETERS)
+		 * @param cameraMatrix the calibrated camera matrix
+		 * @param distCoeffs the calibrated distortion coefficients
+		 * @return true if calibration went right
+		 */
+		bool calibrate(const std::vector<size_t> & views,
+					   cv::Mat & parameters,
+					   cv::Mat & cameraMatrix,
+					   cv::Mat & distCoeffs) const;
+
+		/**
+		 * Chessboard image points on all views
+		 */
+		const std::vector<std::vector<cv::Point2f> > & imagePoints;
+
+		/**
+		 * Image size
+		 */
+		cv::Size imageSize;
+
+		/**
+		 * Board size
+		 */
+		cv::Size boardSize;
+
+		/**
+		 * Square size on the chessboard
+		 */
+		float squareSize;
+
+		/**
+		 * Image aspect ratio
+		 */
+		float aspectRatio;
+
+		/**
+		 * Calibration flags
+		 */
+		int flags;
+
+		/**
+		 * Report of the last run
+		 */
+		UncertaintyStatistics statistics;
+};
+
+#endif /* UNCERTAINTYESTIMATOR_H_ */
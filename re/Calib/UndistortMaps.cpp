@@ -0,0 +1,358 @@
+/*
+ * UndistortMaps.cpp
+ *
+ * Precomputed undistortion remap tables.
+ */
+
+#include <cstring>
+#include <chrono>
+
+#include "UndistortMaps.h"
+
+using namespace cv;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Check if two matrices have the same size, type and content
+ * @param a first matrix
+ * @param b second matrix
+ * @return true if both matrices are identical
+ */
+static bool sameMat(const Mat & a, const Mat & b)
+{
+	if (a.size() != b.size() || a.type() != b.type())
+	{
+		return false;
+	}
+	return a.empty() || norm(a, b, NORM_INF) == 0;
+}
+
+/**
+ * Supported map formats
+ */
+static const int mapTypes[] = { CV_16SC2, CV_32FC1, CV_32FC2 };
+
+/**
+ * Supported interpolation methods
+ */
+static const int interpolations[] =
+	{ INTER_NEAREST, INTER_LINEAR, INTER_CUBIC, INTER_LANCZOS4 };
+
+/*
+ * Constructor
+ */
+UndistortMaps::UndistortMaps(int mapType, int interpolation) :
+	mapType(mapType),
+	interpolation(interpolation)
+{
+}
+
+/*
+ * Change maps format and interpolation method.
+ */
+void UndistortMaps::setFormat(int mapType, int interpolation)
+{
+	if (mapType != this->mapType)
+	{
+		invalidate();
+	}
+	this->mapType = mapType;
+	this->interpolation = interpolation;
+}
+
+/*
+ * Rebuild maps if calibration parameters or image size changed
+ */
+bool UndistortMaps::update(const Mat & cameraMatrix,
+						   const Mat & distCoeffs,
+						   Size imageSize,
+						   const Mat & newCameraMatrix,
+						   const Mat & rectification)
+{
+	const Mat & targetMatrix =
+		newCameraMatrix.empty() ? cameraMatrix : newCameraMatrix;
+
+	if (!empty() &&
+		imageSize == size &&
+		sameMat(cameraMatrix, builtCameraMatrix) &&
+		sameMat(distCoeffs, builtDistCoeffs) &&
+		sameMat(targetMatrix, builtNewCameraMatrix) &&
+		sameMat(rectification, builtRectification))
+	{
+		return false;
+	}
+
+	initUndistortRectifyMap(cameraMatrix,
+							distCoeffs,
+							rectification,
+							targetMatrix,
+							imageSize,
+							mapType,
+							map1,
+							map2);
+
+	size = imageSize;
+	builtCameraMatrix = cameraMatrix.clone();
+	builtDistCoeffs = distCoeffs.clone();
+	builtNewCameraMatrix = targetMatrix.clone();
+	builtRectification = rectification.clone();
+	return true;
+}
+
+/*
+ * Force maps rebuild on next update
+ */
+void UndistortMaps::invalidate()
+{
+	map1.release();
+	map2.release();
+	size = Size();
+}
+
+/*
+ * Maps have been built
+ */
+bool UndistortMaps::empty() const
+{
+	return map1.empty();
+}
+
+/*
+ * Undistort an image with the maps
+ */
+void UndistortMaps::apply(const Mat & src, Mat & dst) const
+{
+	remap(src, dst, map1, map2, interpolation);
+}
+
+/**
+ * Remaps a range of horizontal bands of the destination image
+ */
+class RemapBands : public ParallelLoopBody
+{
+	public:
+		/**
+		 * Constructor
+		 * @param src source image
+		 * @param dst destination image (already allocated)
+		 * @param map1 first map
+		 * @param map2 second map (may be empty)
+		 * @param interpolation interpolation method
+		 * @param bands total number of bands
+		 */
+		RemapBands(const Mat & src,
+				   Mat & dst,
+				   const Mat & map1,
+				   const Mat & map2,
+				   int interpolation,
+				   int bands) :
+			src(src),
+			dst(dst),
+			map1(map1),
+			map2(map2),
+			interpolation(interpolation),
+			bands(bands)
+		{
+		}
+
+		/**
+		 * Remap bands in range
+		 * @param range the bands range
+		 */
+		void operator()(const Range & range) const
+		{
+			int rows = dst.rows;
+			int first = range.start * rows / bands;
+			int last = range.end * rows / bands;
+			Mat dstBand = dst.rowRange(first, last);
+			remap(src,
+				  dstBand,
+				  map1.rowRange(first, last),
+				  map2.empty() ? Mat() : map2.rowRange(first, last),
+				  interpolation);
+		}
+
+	private:
+		const Mat & src;
+		Mat & dst;
+		const Mat & map1;
+		const Mat & map2;
+		int interpolation;
+		int bands;
+};
+
+/*
+ * Undistort an image with the maps, splitting the destination image in
+ * horizontal bands remapped concurrently
+ */
+void UndistortMaps::apply(const Mat & src, Mat & dst, int bands) const
+{
+	if (bands <= 1)
+	{
+		apply(src, dst);
+		return;
+	}
+
+	dst.create(map1.size(), src.type());
+	parallel_for_(Range(0, bands),
+				  RemapBands(src, dst, map1, map2, interpolation, bands));
+}
+
+/*
+ * Maps size
+ */
+Size UndistortMaps::getSize() const
+{
+	return size;
+}
+
+/*
+ * Map format name
+ */
+const char * UndistortMaps::mapTypeName(int mapType)
+{
+	switch (mapType)
+	{
+		case CV_16SC2:
+			return "16SC2";
+		case CV_32FC1:
+			return "32FC1";
+		case CV_32FC2:
+			return "32FC2";
+		default:
+			return "unknown";
+	}
+}
+
+/*
+ * Interpolation method name
+ */
+const char * UndistortMaps::interpolationName(int interpolation)
+{
+	switch (interpolation)
+	{
+		case INTER_NEAREST:
+			return "nearest";
+		case INTER_LINEAR:
+			return "linear";
+		case INTER_CUBIC:
+			return "cubic";
+		case INTER_LANCZOS4:
+			return "lanczos";
+		default:
+			return "unknown";
+	}
+}
+
+/*
+ * Parse a map format name
+ */
+bool UndistortMaps::parseMapType(const char * name, int & mapType)
+{
+	for (size_t i = 0; i < sizeof(mapTypes) / sizeof(mapTypes[0]); i++)
+	{
+		if (strcmp(name, mapTypeName(mapTypes[i])) == 0)
+		{
+			mapType = mapTypes[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Parse an interpolation method name
+ */
+bool UndistortMaps::parseInterpolation(const char * name, int & interpolation)
+{
+	for (size_t i = 0; i < sizeof(interpolations) / sizeof(interpolations[0]);
+		 i++)
+	{
+		if (strcmp(name, interpolationName(interpolations[i])) == 0)
+		{
+			interpolation = interpolations[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Compare maps build time, per frame remap time and difference with
+ * undistort for all map formats and interpolation methods
+ */
+void UndistortMaps::benchmark(const Mat & view,
+							  const Mat & cameraMatrix,
+							  const Mat & distCoeffs,
+							  int iterations,
+							  FILE * out)
+{
+	Mat reference, undistorted;
+
+	if (iterations < 1)
+	{
+		iterations = 1;
+	}
+
+	// undistort rebuilds its maps on every call : this is the baseline
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		undistort(view, reference, cameraMatrix, distCoeffs);
+	}
+	double baseline = secondsSince(start) / iterations;
+
+	fprintf(out, "Undistortion benchmark on %dx%d images, %d iterations\n",
+			view.cols, view.rows, iterations);
+	fprintf(out, "  %-6s %-8s %10s %12s %9s %14s\n",
+			"maps", "interp", "build (ms)", "remap (ms)", "speed-up",
+			"diff (mean/max)");
+	fprintf(out, "  %-6s %-8s %10s %12.3f %9s %14s\n",
+			"-", "undist.", "-", 1e3 * baseline, "1.0", "-");
+
+	for (size_t m = 0; m < sizeof(mapTypes) / sizeof(mapTypes[0]); m++)
+	{
+		for (size_t n = 0;
+			 n < sizeof(interpolations) / sizeof(interpolations[0]);
+			 n++)
+		{
+			UndistortMaps maps(mapTypes[m], interpolations[n]);
+
+			start = Clock::now();
+			maps.update(cameraMatrix, distCoeffs, view.size());
+			double build = secondsSince(start);
+
+			start = Clock::now();
+			for (int i = 0; i < iterations; i++)
+			{
+				maps.apply(view, undistorted);
+			}
+			double perFrame = secondsSince(start) / iterations;
+
+			double maxDiff = norm(reference, undistorted, NORM_INF);
+			double meanDiff = norm(reference, undistorted, NORM_L1) /
+				(double) reference.total() / reference.channels();
+
+			fprintf(out, "  %-6s %-8s %10.2f %12.3f %9.1f %7.2f/%-6.0f\n",
+					mapTypeName(mapTypes[m]),
+					interpolationName(interpolations[n]),
+					1e3 * build,
+					1e3 * perFrame,
+					perFrame > 0 ? baseline / perFrame : 0.0,
+					meanDiff,
+					maxDiff);
+		}
+	}
+}
@@ -0,0 +1,191 @@
+/*
+ * UndistortMaps.h
+ *
+ * Precomputed undistortion remap tables.
+ */
+
+#ifndef UNDISTORTMAPS_H_
+#define UNDISTORTMAPS_H_
+
+#include <cstdio>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+/**
+ * Undistortion remap tables built once per calibration result and image
+ * size, then reused for every frame.
+ * Maps can be built in any format supported by initUndistortRectifyMap :
+ * 	- CV_16SC2 : fixed point maps (integer coordinates + interpolation table
+ * 	index), the fastest to remap with
+ * 	- CV_32FC1 : separate floating point x and y maps
+ * 	- CV_32FC2 : interleaved floating point (x, y) map
+ */
+class UndistortMaps
+{
+	public:
+		/**
+		 * Constructor
+		 * @param mapType maps format (CV_16SC2, CV_32FC1 or CV_32FC2)
+		 * @param interpolation remap interpolation method (INTER_NEAREST,
+		 * INTER_LINEAR, INTER_CUBIC or INTER_LANCZOS4)
+		 */
+		UndistortMaps(int mapType = CV_16SC2,
+					  int interpolation = cv::INTER_LINEAR);
+
+		/**
+		 * Change maps format and interpolation method.
+		 * Maps will be rebuilt on next update if format changed.
+		 * @param mapType maps format (CV_16SC2, CV_32FC1 or CV_32FC2)
+		 * @param interpolation remap interpolation method
+		 */
+		void setFormat(int mapType, int interpolation);
+
+		/**
+		 * Rebuild maps if calibration parameters or image size changed since
+		 * last update
+		 * @param cameraMatrix camera matrix
+		 * @param distCoeffs distortion coefficients
+		 * @param imageSize undistorted images size
+		 * @param newCameraMatrix camera matrix (or 3x4 projection matrix) of
+		 * undistorted images (if empty cameraMatrix is used)
+		 * @param rectification rectification rotation (i.e. from
+		 * stereoRectify, identity if empty)
+		 * @return true if maps have been rebuilt, false if previous maps
+		 * are still valid
+		 */
+		bool update(const cv::Mat & cameraMatrix,
+					const cv::Mat & distCoeffs,
+					cv::Size imageSize,
+					const cv::Mat & newCameraMatrix = cv::Mat(),
+					const cv::Mat & rectification = cv::Mat());
+
+		/**
+		 * Force maps rebuild on next update
+		 */
+		void invalidate();
+
+		/**
+		 * Maps have been built
+		 * @return true if maps have been built
+		 */
+		bool empty() const;
+
+		/**
+		 * Undistort an image with the maps
+		 * @param src distorted image (of the maps size)
+		 * @param dst undistorted image (must not be src)
+		 */
+		void apply(const cv::Mat & src, cv::Mat & dst) const;
+
+		/**
+		 * Undistort an image with the maps, splitting the destination image
+		 * in horizontal bands remapped concurrently
+		 * @param src distorted image (of the maps size)
+		 * @param dst undistorted image (must not be src)
+		 * @param bands number of row bands
+		 */
+		void apply(const cv::Mat & src, cv::Mat & dst, int bands) const;
+
+		/**
+		 * Maps size
+		 * @return the size of images produced by the maps
+		 */
+		cv::Size getSize() const;
+
+		/**
+		 * Map format name
+		 * @param mapType the map format
+		 * @return the map format name (i.e. "16SC2")
+		 */
+		static const char * mapTypeName(int mapType);
+
+		/**
+		 * Interpolation method name
+		 * @param interpolation the interpolation method
+		 * @return the interpolation method name (i.e. "linear")
+		 */
+		static const char * interpolationName(int interpolation);
+
+		/**
+		 * Parse a map format name
+		 * @param name the map format name ("16SC2", "32FC1" or "32FC2")
+		 * @param mapType the parsed map format
+		 * @return true if name is a valid map format name
+		 */
+		static bool parseMapType(const char * name, int & mapType);
+
+		/**
+		 * Parse an interpolation method name
+		 * @param name the interpolation method name ("nearest", "linear",
+		 * "cubic" or "lanczos")
+		 * @param interpolation the parsed interpolation method
+		 * @return true if name is a valid interpolation method name
+		 */
+		static bool parseInterpolation(const char * name, int & interpolation);
+
+		/**
+		 * Compare maps build time, per frame remap time and difference
+		 * with undistort for all map formats and interpolation methods
+		 * @param view the image to undistort
+		 * @param cameraMatrix camera matrix
+		 * @param distCoeffs distortion coefficients
+		 * @param iterations number of undistortions per configuration
+		 * @param out the stream to print results to
+		 */
+		static void benchmark(const cv::Mat & view,
+							  const cv::Mat & cameraMatrix,
+							  const cv::Mat & distCoeffs,
+							  int iterations,
+							  FILE * out);
+
+	private:
+		/**
+		 * Maps format
+		 */
+		int mapType;
+
+		/**
+		 * Remap interpolation method
+		 */
+		int interpolation;
+
+		/**
+		 * First map : (x, y) coordinates in 16SC2 and 32FC2 formats, x
+		 * coordinates in 32FC1 format
+		 */
+		cv::Mat map1;
+
+		/**
+		 * Second map : interpolation table indices in 16SC2 format, empty in
+		 * 32FC2 format, y coordinates in 32FC1 format
+		 */
+		cv::Mat map2;
+
+		/**
+		 * Maps size
+		 */
+		cv::Size size;
+
+		/**
+		 * Camera matrix used to build the maps
+		 */
+		cv::Mat builtCameraMatrix;
+
+		/**
+		 * Distortion coefficients used to build the maps
+		 */
+		cv::Mat builtDistCoeffs;
+
+		/**
+		 * New camera matrix used to build the maps
+		 */
+		cv::Mat builtNewCameraMatrix;
+
+		/**
+		 * Rectification rotation used to build the maps
+		 */
+		cv::Mat builtRectification;
+};
+
+#endif /* UNDISTORTMAPS_H_ */
@@ -0,0 +1,281 @@
+/*
+ * ViewSelector.cpp
+ *
+ * Selection of a bounded subset of diverse chessboard views.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "ViewSelector.h"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Weight of the newly covered image fraction against the pose distance in
+ * the selection score
+ */
+static const double coverageWeight = 2.0;
+
+/**
+ * Weight of the tilt terms in the pose descriptor : foreshortening is what
+ * constrains the focal length, so tilted views should stand out
+ */
+static const double tiltWeight = 2.0;
+
+/*
+ * Default constructor : everything set to 0
+ */
+SelectionStatistics::SelectionStatistics() :
+	views(0),
+	selected(0),
+	selectionTime(0),
+	coverageAll(0),
+	coverageSelected(0),
+	subsetTime(0),
+	subsetError(0),
+	compared(false),
+	subsetErrorAll(0),
+	fullTime(0),
+	fullError(0)
+{
+}
+
+/*
+ * Print selection report
+ */
+void SelectionStatistics::print(FILE * out) const
+{
+	fprintf(out, "View selection: %u of %u views in %.2f ms, coverage "
+			"%.1f%% (all views %.1f%%)\n",
+			(unsigned) selected,
+			(unsigned) views,
+			1e3 * selectionTime,
+			100.0 * coverageSelected,
+			100.0 * coverageAll);
+	fprintf(out, "  %-22s %10s %12s %12s\n",
+			"calibration", "time (s)", "error (px)", "all views");
+	fprintf(out, "  %-22s %10.3f %12.4f %12s\n", "selected views",
+			subsetTime, subsetError,
+			compared ? format("%.4f", subsetErrorAll).c_str() : "");
+	if (compared)
+	{
+		fprintf(out, "  %-22s %10.3f %12.4f %12.4f\n", "all views",
+				fullTime, fullError, fullError);
+		fprintf(out, "  solve time saving %.1f%%, error difference on all "
+				"views %+.4f px\n",
+				fullTime > 0 ? 100.0 * (fullTime - subsetTime) / fullTime : 0.0,
+				subsetErrorAll - fullError);
+	}
+}
+
+/*
+ * Constructor
+ */
+ViewSelector::ViewSelector(Size imageSize, Size boardSize, Size gridSize) :
+	imageSize(imageSize),
+	boardSize(boardSize),
+	gridSize(gridSize)
+{
+}
+
+/*
+ * Select at most maxViews views
+ */
+double ViewSelector::select(const vector<vector<Point2f> > & imagePoints,
+							size_t maxViews,
+							vector<size_t> & selected) const
+{
+	size_t n = imagePoints.size();
+	selected.clear();
+
+	if (maxViews >= n)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			selected.push_back(i);
+		}
+		return coverage(imagePoints);
+	}
+
+	vector<vector<int> > cells(n);
+	vector<Mat> descriptors(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		coveredCells(imagePoints[i], cells[i]);
+		descriptors[i] = descriptor(imagePoints[i]);
+	}
+
+	int nbCells = gridSize.area();
+	vector<bool> covered(nbCells, false);
+	vector<bool> used(n, false);
+	// pose distance of each view to the closest selected view
+	vector<double> minDistance(n, 0.0);
+	int coveredCount = 0;
+
+	while (selected.size() < maxViews)
+	{
+		size_t best = n;
+		double bestScore = -1;
+		for (size_t i = 0; i < n; i++)
+		{
+			if (used[i])
+			{
+				continue;
+			}
+			int gain = 0;
+			for (size_t c = 0; c < cells[i].size(); c++)
+			{
+				gain += covered[cells[i][c]] ? 0 : 1;
+			}
+			double score = coverageWeight * gain / nbCells + minDistance[i];
+			if (score > bestScore)
+			{
+				bestScore = score;
+				best = i;
+			}
+		}
+
+		used[best] = true;
+		selected.push_back(best);
+		for (size_t c = 0; c < cells[best].size(); c++)
+		{
+			if (!covered[cells[best][c]])
+			{
+				covered[cells[best][c]] = true;
+				coveredCount++;
+			}
+		}
+
+		for (size_t i = 0; i < n; i++)
+		{
+			if (!used[i])
+			{
+				double d = norm(descriptors[i], descriptors[best], NORM_L2);
+				minDistance[i] =
+					selected.size() == 1 ? d : std::min(minDistance[i], d);
+			}
+		}
+	}
+
+	sort(selected.begin(), selected.end());
+
+	return nbCells > 0 ? coveredCount / (double) nbCells : 0.0;
+}
+
+/*
+ * Fraction of the image area covered by a set of views
+ */
+double ViewSelector::coverage(const vector<vector<Point2f> > & imagePoints) const
+{
+	int nbCells = gridSize.area();
+	vector<bool> covered(nbCells, false);
+	int coveredCount = 0;
+	vector<int> cells;
+
+	for (size_t i = 0; i < imagePoints.size(); i++)
+	{
+		coveredCells(imagePoints[i], cells);
+		for (size_t c = 0; c < cells.size(); c++)
+		{
+			if (!covered[cells[c]])
+			{
+				covered[cells[c]] = true;
+				coveredCount++;
+			}
+		}
+	}
+
+	return nbCells > 0 ? coveredCount / (double) nbCells : 0.0;
+}
+
+/*
+ * Coverage grid cells covered by a view
+ */
+void ViewSelector::coveredCells(const vector<Point2f> & corners,
+								vector<int> & cells) const
+{
+	cells.clear();
+
+	int w = boardSize.width, h = boardSize.height;
+	if ((int) corners.size() != w * h || corners.empty())
+	{
+		return;
+	}
+
+	vector<Point2f> quad;
+	quad.push_back(corners[0]);
+	quad.push_back(corners[w - 1]);
+	quad.push_back(corners[w * h - 1]);
+	quad.push_back(corners[w * (h - 1)]);
+
+	float cellWidth = imageSize.width / (float) gridSize.width;
+	float cellHeight = imageSize.height / (float) gridSize.height;
+
+	for (int y = 0; y < gridSize.height; y++)
+	{
+		for (int x = 0; x < gridSize.width; x++)
+		{
+			Point2f center((x + 0.5f) * cellWidth, (y + 0.5f) * cellHeight);
+			if (pointPolygonTest(quad, center, false) >= 0)
+			{
+				cells.push_back(y * gridSize.width + x);
+			}
+		}
+	}
+}
+
+/*
+ * Coverage grid size
+ */
+Size ViewSelector::getGridSize() const
+{
+	return gridSize;
+}
+
+/*
+ * Pose descriptor of a view
+ */
+Mat ViewSelector::descriptor(const vector<Point2f> & corners) const
+{
+	Mat d = Mat::zeros(1, 7, CV_64F);
+
+	int w = boardSize.width, h = boardSize.height;
+	if ((int) corners.size() != w * h || corners.empty())
+	{
+		return d;
+	}
+
+	Point2f c00 = corners[0];
+	Point2f c01 = corners[w - 1];
+	Point2f c11 = corners[w * h - 1];
+	Point2f c10 = corners[w * (h - 1)];
+
+	vector<Point2f> quad;
+	quad.push_back(c00);
+	quad.push_back(c01);
+	quad.push_back(c11);
+	quad.push_back(c10);
+
+	Point2f center = (c00 + c01 + c11 + c10) * 0.25f;
+	double area = contourArea(quad);
+	Point2f top = c01 - c00, bottom = c11 - c10;
+	Point2f left = c10 - c00, right = c11 - c01;
+	double angle = atan2(top.y + bottom.y, top.x + bottom.x);
+
+	d.at<double>(0) = center.x / imageSize.width;
+	d.at<double>(1) = center.y / imageSize.height;
+	d.at<double>(2) = std::sqrt(area / imageSize.area());
+	d.at<double>(3) = 0.5 * cos(angle);
+	d.at<double>(4) = 0.5 * sin(angle);
+	// opposite edges length ratios : foreshortening around both board axes
+	d.at<double>(5) = tiltWeight *
+		log(std::max(norm(left), 1e-3) / std::max(norm(right), 1e-3));
+	d.at<double>(6) = tiltWeight *
+		log(std::max(norm(top), 1e-3) / std::max(norm(bottom), 1e-3));
+
+	return d;
+}
@@ -0,0 +1,177 @@
+/*
+ * ViewSelector.h
+ *
+ * Selection of a bounded subset of diverse chessboard views.
+ */
+
+#ifndef VIEWSELECTOR_H_
+#define VIEWSELECTOR_H_
+
+#include <cstdio>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+/**
+ * View selection statistics
+ */
+struct SelectionStatistics
+{
+	/**
+	 * Default constructor : everything set to 0
+	 */
+	SelectionStatistics();
+
+	/**
+	 * Print selection report (and comparison with all views if it has been
+	 * run)
+	 * @param out the stream to print to
+	 */
+	void print(FILE * out) const;
+
+	/**
+	 * Number of candidate views
+	 */
+	size_t views;
+
+	/**
+	 * Number of selected views
+	 */
+	size_t selected;
+
+	/**
+	 * Time spent selecting views in seconds
+	 */
+	double selectionTime;
+
+	/**
+	 * Fraction of the image area covered by all views
+	 */
+	double coverageAll;
+
+	/**
+	 * Fraction of the image area covered by the selected views
+	 */
+	double coverageSelected;
+
+	/**
+	 * Time spent calibrating with the selected views in seconds
+	 */
+	double subsetTime;
+
+	/**
+	 * RMS reprojection error of the selected views
+	 */
+	double subsetError;
+
+	/**
+	 * Calibration with all views has been run for comparison
+	 */
+	bool compared;
+
+	/**
+	 * RMS reprojection error of all views with the intrinsics calibrated on
+	 * the selected views
+	 */
+	double subsetErrorAll;
+
+	/**
+	 * Time spent calibrating with all views in seconds
+	 */
+	double fullTime;
+
+	/**
+	 * RMS reprojection error of all views calibrated with all views
+	 */
+	double fullError;
+};
+
+/**
+ * Greedy selection of a bounded number of views before calibration.
+ * Views are described from their detected corners only (no calibration
+ * needed) :
+ * 	- board coverage : image grid cells inside the board outer quadrilateral
+ * 	- pose : board center, apparent size, in-plane rotation and
+ * 	foreshortening of opposite board edges (tilt)
+ * The first view is the one covering the most cells, then each step picks the
+ * view maximizing the newly covered cells plus its pose distance to the
+ * closest selected view, so near duplicates are only selected once
+ * everything else has been selected.
+ */
+class ViewSelector
+{
+	public:
+		/**
+		 * Constructor
+		 * @param imageSize images size
+		 * @param boardSize board size (inner corners)
+		 * @param gridSize coverage grid size (cells)
+		 */
+		ViewSelector(cv::Size imageSize,
+					 cv::Size boardSize,
+					 cv::Size gridSize = cv::Size(16, 12));
+
+		/**
+		 * Select at most maxViews views
+		 * @param imagePoints detected corners of all views
+		 * @param maxViews maximum number of selected views
+		 * @param selected indices of the selected views (in imagePoints
+		 * order)
+		 * @return the fraction of the image area covered by the selected
+		 * views
+		 */
+		double select(const std::vector<std::vector<cv::Point2f> > & imagePoints,
+					  size_t maxViews,
+					  std::vector<size_t> & selected) const;
+
+		/**
+		 * Fraction of the image area covered by a set of views
+		 * @param imagePoints detected corners of all views
+		 * @return the fraction of coverage grid cells covered by at least
+		 * one view
+		 */
+		double coverage(
+			const std::vector<std::vector<cv::Point2f> > & imagePoints) const;
+
+		/**
+		 * Coverage grid cells covered by a view : cells whose center lies
+		 * inside the board outer quadrilateral
+		 * @param corners the view corners
+		 * @param cells indices of the covered cells (none if corners do not
+		 * match the board size)
+		 */
+		void coveredCells(const std::vector<cv::Point2f> & corners,
+						  std::vector<int> & cells) const;
+
+		/**
+		 * Coverage grid size
+		 * @return the coverage grid size (cells)
+		 */
+		cv::Size getGridSize() const;
+
+	private:
+
+		/**
+		 * Pose descriptor of a view
+		 * @param corners the view corners
+		 * @return the view descriptor
+		 */
+		cv::Mat descriptor(const std::vector<cv::Point2f> & corners) const;
+
+		/**
+		 * Images size
+		 */
+		cv::Size imageSize;
+
+		/**
+		 * Board size (inner corners)
+		 */
+		cv::Size boardSize;
+
+		/**
+		 * Coverage grid size (cells)
+		 */
+		cv::Size gridSize;
+};
+
+#endif /* VIEWSELECTOR_H_ */
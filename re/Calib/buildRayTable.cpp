@@ -0,0 +1,129 @@
+/*
+ * buildRayTable.cpp
+ *
+ * Precomputes the unit ray of each pixel of a calibrated camera into a
+ * compact ray table file, and compares tables accuracy and lookup
+ * throughput.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+#include "CameraModel.h"
+#include "RayTable.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Default number of random pixels looked up per table by the benchmark
+ */
+static const int defaultBenchmarkLookups = 1000000;
+
+/**
+ * Grid steps compared by the benchmark
+ */
+static const int benchmarkSteps[] = { 1, 2, 4, 8, 16, 32 };
+
+/**
+ * Print usage
+ * @param os the stream to print to
+ * @param name the program name
+ * @return the stream
+ */
+ostream & usage(ostream & os, char * name)
+{
+	os << "usage : " << name << " <calib_camera_data_file.yaml|.calb> "
+	   << "<output.rays> [--step <n>] [--bench [<lookups>]]" << endl
+	   << "  --step   distance in pixels between table nodes, rays of other "
+	   << "pixels being" << endl
+	   << "           bilinearly interpolated (1 by default : dense table)"
+	   << endl
+	   << "  --bench  compare accuracy and lookup throughput of tables of "
+	   << "steps 1 to 32" << endl
+	   << "           with back projection (" << defaultBenchmarkLookups
+	   << " lookups by default)" << endl;
+	return os;
+}
+
+int main(int argc, char ** argv)
+{
+	// ------------------------------------------------------------------------
+	// parse arguments
+	// ------------------------------------------------------------------------
+	if (argc < 3)
+	{
+		usage(cerr, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	string calibrationFilename = argv[1];
+	string outputFilename = argv[2];
+	int step = 1;
+	int lookups = 0;
+	for (int i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--step") == 0 && i + 1 < argc &&
+			sscanf(argv[i + 1], "%d", &step) == 1 && step > 0)
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--bench") == 0)
+		{
+			lookups = defaultBenchmarkLookups;
+			if (i + 1 < argc && sscanf(argv[i + 1], "%d", &lookups) == 1)
+			{
+				i++;
+			}
+		}
+		else
+		{
+			usage(cerr, argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// ------------------------------------------------------------------------
+	// build and save the table
+	// ------------------------------------------------------------------------
+	CameraModel camera;
+	if (!camera.load(calibrationFilename))
+	{
+		cerr << "Failed to read calibration (camera matrix, distortion and "
+			 << "image size) : " << calibrationFilename << endl;
+		return EXIT_FAILURE;
+	}
+
+	RayTable table;
+	if (!table.build(camera, step) || !table.write(outputFilename))
+	{
+		cerr << "Failed to write ray table : " << outputFilename << endl;
+		return EXIT_FAILURE;
+	}
+
+	printf("%s : %dx%d rays table, step %d, %.1f KB\n",
+		   outputFilename.c_str(),
+		   table.getImageSize().width,
+		   table.getImageSize().height,
+		   table.getStep(),
+		   table.byteSize() / 1024.0);
+
+	// ------------------------------------------------------------------------
+	// compare tables
+	// ------------------------------------------------------------------------
+	if (lookups > 0)
+	{
+		vector<int> steps(benchmarkSteps,
+						  benchmarkSteps +
+							  sizeof(benchmarkSteps) / sizeof(benchmarkSteps[0]));
+		RayTable::benchmark(camera, steps, lookups, stdout);
+	}
+
+	return EXIT_SUCCESS;
+}
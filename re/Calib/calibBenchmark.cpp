@@ -0,0 +1,611 @@
+/*
+ * calibBenchmark.cpp
+ *
+ * Reproducible calibration benchmark : renders synthetic chessboard views
+ * from a ground truth camera then times detection, refinement, calibration
+ * and serialization over growing datasets, and measures how well the ground
+ * truth is recovered.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/core/core.hpp"
+
+#include "CalibrationFile.h"
+#include "CalibrationSolver.h"
+#include "ChessboardDetector.h"
+#include "SyntheticBoard.h"
+
+using namespace std;
+using namespace cv;
+
+typedef chrono::steady_clock Clock;
+
+#ifndef BUILD_PROFILE
+/**
+ * Build profile this benchmark was compiled with (set by the Makefile)
+ */
+#define BUILD_PROFILE "unknown"
+#endif
+
+/**
+ * Default dataset sizes (in views)
+ */
+static const int defaultViews[] = { 10, 50, 100, 500, 1000, 5000 };
+
+/**
+ * Seconds elapsed since a time point
+ * @param start the time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Size of a file
+ * @param filename the file name
+ * @return the file size in bytes (0 if it can not be read)
+ */
+static size_t fileSize(const string & filename)
+{
+	struct stat status;
+	return stat(filename.c_str(), &status) == 0 ? (size_t) status.st_size : 0;
+}
+
+/**
+ * RMS distance between detected and ground truth corners. The detector may
+ * return the corners of a symmetric board in reverse order, so the smallest
+ * of the direct and reversed distances is used.
+ * @param detected the detected corners
+ * @param truth the ground truth corners
+ * @return the RMS distance in pixels
+ */
+static double cornersError(const vector<Point2f> & detected,
+						   const vector<Point2f> & truth)
+{
+	double direct = 0;
+	double reversed = 0;
+	size_t n = truth.size();
+	for (size_t i = 0; i < n; i++)
+	{
+		Point2f d = detected[i] - truth[i];
+		Point2f r = detected[n - 1 - i] - truth[i];
+		direct += d.x * d.x + d.y * d.y;
+		reversed += r.x * r.x + r.y * r.y;
+	}
+	return sqrt(std::min(direct, reversed) / n);
+}
+
+/**
+ * Timings of a previous benchmark run (i.e. of the debug build) this run
+ * is compared to
+ */
+struct BaselineTimings
+{
+	/**
+	 * Build profile of the previous run
+	 */
+	string profile;
+
+	/**
+	 * Images size of the previous run
+	 */
+	Size imageSize;
+
+	/**
+	 * Board size of the previous run
+	 */
+	Size boardSize;
+
+	/**
+	 * Random numbers seed of the previous run
+	 */
+	unsigned seed;
+
+	/**
+	 * findChessboardCorners time per rendered view
+	 */
+	double findTime;
+
+	/**
+	 * cornerSubPix time per detected view
+	 */
+	double refineTime;
+
+	/**
+	 * Calibration time of each dataset size
+	 */
+	map<int, double> solveTimes;
+
+	/**
+	 * Read the results file of a previous run
+	 * @param filename the results file name
+	 * @return true if the timings have been read
+	 */
+	bool read(const string & filename)
+	{
+		FileStorage fs(filename, FileStorage::READ);
+		if (!fs.isOpened())
+		{
+			return false;
+		}
+
+		FileNode settings = fs["settings"];
+		FileNode detection = fs["detection"];
+		if (settings.empty() || detection.empty() ||
+			(int) detection["renderedViews"] <= 0 ||
+			(int) detection["detectedViews"] <= 0)
+		{
+			return false;
+		}
+
+		profile = settings["buildProfile"].isString() ?
+			(string) settings["buildProfile"] : filename;
+		imageSize = Size((int) settings["imageWidth"],
+						 (int) settings["imageHeight"]);
+		boardSize = Size((int) settings["boardWidth"],
+						 (int) settings["boardHeight"]);
+		seed = (unsigned) (int) settings["seed"];
+		findTime = (double) detection["findCornersTime"] /
+			(int) detection["renderedViews"];
+		refineTime = (double) detection["refineCornersTime"] /
+			(int) detection["detectedViews"];
+
+		solveTimes.clear();
+		FileNode datasets = fs["datasets"];
+		for (FileNodeIterator it = datasets.begin(); it != datasets.end(); ++it)
+		{
+			solveTimes[(int) (*it)["views"]] = (double) (*it)["calibrationTime"];
+		}
+		return true;
+	}
+};
+
+/**
+ * Parse a comma separated list of dataset sizes
+ * @param list the list (i.e. "10,100,1000")
+ * @param views the parsed sizes
+ * @return true if all sizes are positive integers
+ */
+static bool parseViews(const char * list, vector<int> & views)
+{
+	views.clear();
+	const char * p = list;
+	while (*p != '\0')
+	{
+		int n, consumed;
+		if (sscanf(p, "%d%n", &n, &consumed) != 1 || n <= 0)
+		{
+			return false;
+		}
+		views.push_back(n);
+		p += consumed;
+		if (*p == ',')
+		{
+			p++;
+		}
+		else if (*p != '\0')
+		{
+			return false;
+		}
+	}
+	return !views.empty();
+}
+
+/**
+ * Print usage
+ * @param os the stream to print to
+ * @param name the program name
+ * @return the stream
+ */
+ostream & usage(ostream & os, char * name)
+{
+	os << "usage : " << name << " [--size <width>x<height>] [-w <board_width>] "
+	   << "[-h <board_height>]" << endl
+	   << "         [-s <square_size>] [--blur <sigma>] [--noise <sigma>] "
+	   << "[--tilt <degrees>]" << endl
+	   << "         [--views <n1,n2,...>] [--seed <n>] [-o <results.yml>]"
+	   << endl
+	   << "         [--baseline <results.yml>]" << endl
+	   << "  --size   rendered images size (1280x960 by default)" << endl
+	   << "  -w -h    number of inner corners per board row and column "
+	   << "(9x6 by default)" << endl
+	   << "  -s       square size (0.025 by default)" << endl
+	   << "  --blur   gaussian blur sigma in pixels (0.8 by default)" << endl
+	   << "  --noise  gaussian noise sigma in gray levels (2 by default)"
+	   << endl
+	   << "  --tilt   maximum board tilt in degrees (40 by default)" << endl
+	   << "  --views  calibrated dataset sizes (10,50,100,500,1000,5000 by "
+	   << "default)" << endl
+	   << "  --seed   random numbers seed, identical seeds render identical "
+	   << "views" << endl
+	   << "  -o       machine readable results file (benchmark.yml by default)"
+	   << endl
+	   << "  --baseline  results file of a previous run (i.e. of the debug "
+	   << "build) with the" << endl
+	   << "           same settings : detection and calibration speed-ups "
+	   << "over it are reported" << endl;
+	return os;
+}
+
+int main(int argc, char ** argv)
+{
+	// ------------------------------------------------------------------------
+	// parse arguments
+	// ------------------------------------------------------------------------
+	Size imageSize(1280, 960);
+	Size boardSize(9, 6);
+	float squareSize = 0.025f;
+	double blurSigma = 0.8;
+	double noiseSigma = 2.0;
+	double maxTilt = 40;
+	unsigned seed = 0x5eed;
+	string outputFilename = "benchmark.yml";
+	string baselineFilename;
+	vector<int> views(defaultViews,
+					  defaultViews + sizeof(defaultViews) / sizeof(defaultViews[0]));
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char * s = argv[i];
+		const char * value = i + 1 < argc ? argv[i + 1] : NULL;
+		bool ok = value != NULL;
+		if (ok && strcmp(s, "--size") == 0)
+		{
+			ok = sscanf(value, "%dx%d", &imageSize.width, &imageSize.height) == 2 &&
+				imageSize.width > 0 && imageSize.height > 0;
+		}
+		else if (ok && strcmp(s, "-w") == 0)
+		{
+			ok = sscanf(value, "%d", &boardSize.width) == 1 && boardSize.width > 1;
+		}
+		else if (ok && strcmp(s, "-h") == 0)
+		{
+			ok = sscanf(value, "%d", &boardSize.height) == 1 &&
+				boardSize.height > 1;
+		}
+		else if (ok && strcmp(s, "-s") == 0)
+		{
+			ok = sscanf(value, "%f", &squareSize) == 1 && squareSize > 0;
+		}
+		else if (ok && strcmp(s, "--blur") == 0)
+		{
+			ok = sscanf(value, "%lf", &blurSigma) == 1 && blurSigma >= 0;
+		}
+		else if (ok && strcmp(s, "--noise") == 0)
+		{
+			ok = sscanf(value, "%lf", &noiseSigma) == 1 && noiseSigma >= 0;
+		}
+		else if (ok && strcmp(s, "--tilt") == 0)
+		{
+			ok = sscanf(value, "%lf", &maxTilt) == 1 && maxTilt >= 0;
+		}
+		else if (ok && strcmp(s, "--views") == 0)
+		{
+			ok = parseViews(value, views);
+		}
+		else if (ok && strcmp(s, "--seed") == 0)
+		{
+			ok = sscanf(value, "%u", &seed) == 1;
+		}
+		else if (ok && strcmp(s, "-o") == 0)
+		{
+			outputFilename = value;
+		}
+		else if (ok && strcmp(s, "--baseline") == 0)
+		{
+			baselineFilename = value;
+		}
+		else
+		{
+			ok = false;
+		}
+
+		if (!ok)
+		{
+			usage(cerr, argv[0]);
+			return EXIT_FAILURE;
+		}
+		i++;
+	}
+
+	sort(views.begin(), views.end());
+	views.erase(unique(views.begin(), views.end()), views.end());
+	int maxViews = views.back();
+
+	// speed-ups are only meaningful on the same views
+	BaselineTimings baseline;
+	bool compare = !baselineFilename.empty();
+	if (compare && !baseline.read(baselineFilename))
+	{
+		cerr << "Failed to read baseline results : " << baselineFilename << endl;
+		return EXIT_FAILURE;
+	}
+	if (compare && (baseline.imageSize != imageSize ||
+					baseline.boardSize != boardSize || baseline.seed != seed))
+	{
+		cerr << "Baseline " << baselineFilename << " was run on other views "
+			 << "(images size, board size or seed differ)" << endl;
+		return EXIT_FAILURE;
+	}
+
+	Mat trueCameraMatrix, trueDistCoeffs;
+	SyntheticBoard::defaultCamera(imageSize, trueCameraMatrix, trueDistCoeffs);
+	SyntheticBoard board(imageSize, boardSize, squareSize,
+						 trueCameraMatrix, trueDistCoeffs);
+	board.setDegradation(blurSigma, noiseSigma);
+
+	printf("Benchmark (%s build) : %dx%d images, %dx%d board, blur %.2f, "
+		   "noise %.2f, tilt %.0f, seed %u\n",
+		   BUILD_PROFILE,
+		   imageSize.width, imageSize.height,
+		   boardSize.width, boardSize.height,
+		   blurSigma, noiseSigma, maxTilt, seed);
+
+	// ------------------------------------------------------------------------
+	// render and detect the largest dataset, keeping only the corners
+	// ------------------------------------------------------------------------
+	ChessboardDetector detector(boardSize,
+								CV_CALIB_CB_ADAPTIVE_THRESH |
+									CV_CALIB_CB_NORMALIZE_IMAGE |
+									CV_CALIB_CB_FAST_CHECK);
+	RNG rng(seed);
+	vector<vector<Point2f> > imagePoints;
+	imagePoints.reserve(maxViews);
+	int rendered = 0;
+	double renderTime = 0;
+	double findTime = 0;
+	double refineTime = 0;
+	double cornersSquaredError = 0;
+	double cornersMaxError = 0;
+
+	while ((int) imagePoints.size() < maxViews && rendered < 4 * maxViews)
+	{
+		Mat rvec, tvec;
+		if (!board.randomPose(rng, rvec, tvec, maxTilt))
+		{
+			cerr << "No pose shows the whole board in the image" << endl;
+			return EXIT_FAILURE;
+		}
+
+		Mat image;
+		vector<Point2f> truth;
+		Clock::time_point start = Clock::now();
+		board.render(rvec, tvec, rng, image, truth);
+		renderTime += secondsSince(start);
+		rendered++;
+
+		vector<Point2f> corners;
+		start = Clock::now();
+		bool found = detector.findCorners(image, corners);
+		findTime += secondsSince(start);
+		if (!found)
+		{
+			continue;
+		}
+
+		start = Clock::now();
+		detector.refineCorners(image, corners);
+		refineTime += secondsSince(start);
+
+		double error = cornersError(corners, truth);
+		cornersSquaredError += error * error;
+		cornersMaxError = std::max(cornersMaxError, error);
+		imagePoints.push_back(corners);
+	}
+
+	int detected = (int) imagePoints.size();
+	if (detected == 0)
+	{
+		cerr << "No board detected in " << rendered << " rendered views" << endl;
+		return EXIT_FAILURE;
+	}
+	double cornersRms = sqrt(cornersSquaredError / detected);
+
+	printf("Detection : %d / %d views\n", detected, rendered);
+	printf("  %-22s %10.3f ms/view\n", "render", 1e3 * renderTime / rendered);
+	printf("  %-22s %10.3f ms/view\n", "findChessboardCorners",
+		   1e3 * findTime / rendered);
+	printf("  %-22s %10.3f ms/view\n", "cornerSubPix", 1e3 * refineTime / detected);
+	printf("  %-22s %10.3f px (max %.3f px)\n", "corners RMS error",
+		   cornersRms, cornersMaxError);
+
+	double findSpeedup = 0;
+	double refineSpeedup = 0;
+	if (compare)
+	{
+		findSpeedup = baseline.findTime / (findTime / rendered);
+		refineSpeedup = baseline.refineTime / (refineTime / detected);
+		printf("Speed-up over the %s build\n", baseline.profile.c_str());
+		printf("  %-22s %10.2f x\n", "findChessboardCorners", findSpeedup);
+		printf("  %-22s %10.2f x\n", "cornerSubPix", refineSpeedup);
+	}
+
+	FileStorage fs(outputFilename, FileStorage::WRITE);
+	if (!fs.isOpened())
+	{
+		cerr << "Failed to write benchmark results : " << outputFilename << endl;
+		return EXIT_FAILURE;
+	}
+
+	fs << "settings" << "{"
+	   << "buildProfile" << BUILD_PROFILE
+	   << "imageWidth" << imageSize.width
+	   << "imageHeight" << imageSize.height
+	   << "boardWidth" << boardSize.width
+	   << "boardHeight" << boardSize.height
+	   << "squareSize" << squareSize
+	   << "blurSigma" << blurSigma
+	   << "noiseSigma" << noiseSigma
+	   << "maxTilt" << maxTilt
+	   << "seed" << (int) seed
+	   << "threads" << getNumThreads()
+	   << "}";
+	fs << "groundTruth" << "{"
+	   << "cameraMatrix" << trueCameraMatrix
+	   << "distortionCoefficients" << trueDistCoeffs
+	   << "}";
+	fs << "detection" << "{"
+	   << "renderedViews" << rendered
+	   << "detectedViews" << detected
+	   << "renderTime" << renderTime
+	   << "findCornersTime" << findTime
+	   << "refineCornersTime" << refineTime
+	   << "findCornersPerSecond" << rendered / findTime
+	   << "cornersRmsError" << cornersRms
+	   << "cornersMaxError" << cornersMaxError
+	   << "}";
+	if (compare)
+	{
+		fs << "baseline" << "{"
+		   << "file" << baselineFilename
+		   << "buildProfile" << baseline.profile
+		   << "findCornersSpeedup" << findSpeedup
+		   << "refineCornersSpeedup" << refineSpeedup
+		   << "}";
+	}
+
+	// ------------------------------------------------------------------------
+	// calibrate and save each dataset
+	// ------------------------------------------------------------------------
+	printf("%8s %10s %10s %10s %10s %10s %10s %10s %10s %10s%s\n",
+		   "views", "solve (s)", "views/s", "RMS (px)", "dfx", "dfy",
+		   "dcx", "dcy", "text (s)", "calb (s)",
+		   compare ? "   speed-up" : "");
+
+	string textFilename = outputFilename + ".tmp.yml";
+	string binaryFilename = outputFilename + ".tmp.calb";
+	fs << "datasets" << "[";
+	for (size_t d = 0; d < views.size(); d++)
+	{
+		if (views[d] > detected)
+		{
+			fprintf(stderr, "Skipping %d views dataset : only %d views detected\n",
+					views[d], detected);
+			continue;
+		}
+
+		vector<vector<Point2f> > points(imagePoints.begin(),
+										imagePoints.begin() + views[d]);
+		Mat cameraMatrix, distCoeffs;
+		vector<Mat> rvecs, tvecs;
+		vector<float> reprojErrs;
+		double totalAvgErr = 0;
+
+		Clock::time_point start = Clock::now();
+		bool ok = runCalibration(points, imageSize, boardSize, squareSize, 1.f,
+								 0, cameraMatrix, distCoeffs, rvecs, tvecs,
+								 reprojErrs, totalAvgErr, false);
+		double solveTime = secondsSince(start);
+
+		// no speed-up (0) when the baseline did not calibrate this size
+		double solveSpeedup = 0;
+		map<int, double>::const_iterator previous =
+			baseline.solveTimes.find(views[d]);
+		if (previous != baseline.solveTimes.end())
+		{
+			solveSpeedup = previous->second / solveTime;
+		}
+
+		// parameters recovery
+		Mat intrinsicsError = cameraMatrix - trueCameraMatrix;
+		Mat distError = Mat::zeros(trueDistCoeffs.rows, 1, CV_64F);
+		for (int i = 0; i < trueDistCoeffs.rows && i < distCoeffs.rows; i++)
+		{
+			distError.at<double>(i) =
+				distCoeffs.at<double>(i) - trueDistCoeffs.at<double>(i);
+		}
+
+		// serialization of the whole calibration, in both formats
+		CalibrationData data;
+		data.calibrationTime = "benchmark";
+		data.nframes = views[d];
+		data.imageSize = imageSize;
+		data.boardSize = boardSize;
+		data.squareSize = squareSize;
+		data.aspectRatio = 1.f;
+		data.flags = 0;
+		data.cameraMatrix = cameraMatrix;
+		data.distCoeffs = distCoeffs;
+		data.avgReprojectionError = totalAvgErr;
+		data.perViewErrors = Mat(reprojErrs).clone();
+		data.extrinsics.create(views[d], 6, CV_32F);
+		data.imagePoints.create(views[d], (int) points[0].size(), CV_32FC2);
+		for (int i = 0; i < views[d]; i++)
+		{
+			Mat r = data.extrinsics(Range(i, i + 1), Range(0, 3));
+			Mat t = data.extrinsics(Range(i, i + 1), Range(3, 6));
+			rvecs[i].reshape(1, 1).convertTo(r, CV_32F);
+			tvecs[i].reshape(1, 1).convertTo(t, CV_32F);
+			Mat(points[i]).reshape(2, 1).copyTo(data.imagePoints.row(i));
+		}
+
+		start = Clock::now();
+		bool saved = data.write(textFilename);
+		double textTime = secondsSince(start);
+		start = Clock::now();
+		saved = data.write(binaryFilename) && saved;
+		double binaryTime = secondsSince(start);
+		size_t textBytes = fileSize(textFilename);
+		size_t binaryBytes = fileSize(binaryFilename);
+		unlink(textFilename.c_str());
+		unlink(binaryFilename.c_str());
+
+		printf("%8d %10.3f %10.1f %10.4f %10.3f %10.3f %10.3f %10.3f %10.4f "
+			   "%10.4f",
+			   views[d], solveTime, views[d] / solveTime, totalAvgErr,
+			   intrinsicsError.at<double>(0, 0),
+			   intrinsicsError.at<double>(1, 1),
+			   intrinsicsError.at<double>(0, 2),
+			   intrinsicsError.at<double>(1, 2),
+			   textTime, binaryTime);
+		if (solveSpeedup > 0)
+		{
+			printf(" %9.2f x", solveSpeedup);
+		}
+		printf("%s\n", ok && saved ? "" : " (failed)");
+
+		fs << "{"
+		   << "views" << views[d]
+		   << "calibrated" << (int) ok
+		   << "calibrationTime" << solveTime
+		   << "viewsPerSecond" << views[d] / solveTime
+		   << "avgReprojectionError" << totalAvgErr
+		   << "cameraMatrix" << cameraMatrix
+		   << "distortionCoefficients" << distCoeffs
+		   << "fxError" << intrinsicsError.at<double>(0, 0)
+		   << "fyError" << intrinsicsError.at<double>(1, 1)
+		   << "cxError" << intrinsicsError.at<double>(0, 2)
+		   << "cyError" << intrinsicsError.at<double>(1, 2)
+		   << "distortionError" << distError
+		   << "textWriteTime" << textTime
+		   << "textBytes" << (int) textBytes
+		   << "binaryWriteTime" << binaryTime
+		   << "binaryBytes" << (int) binaryBytes;
+		if (solveSpeedup > 0)
+		{
+			fs << "solveSpeedup" << solveSpeedup;
+		}
+		fs << "}";
+	}
+	fs << "]";
+	fs.release();
+
+	printf("Results written to %s\n", outputFilename.c_str());
+
+	return EXIT_SUCCESS;
+}
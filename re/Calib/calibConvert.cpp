@@ -0,0 +1,128 @@
+/*
+ * calibConvert.cpp
+ *
+ * Converts calibration results between the YAML / XML format and the
+ * binary (.calb) format, and compares their load times.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "opencv2/core/core.hpp"
+
+#include "CalibrationFile.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Default number of loads per method of the load benchmark
+ */
+static const int defaultBenchmarkIterations = 1000;
+
+/**
+ * Print usage
+ * @param os the stream to print to
+ * @param name the program name
+ * @return the stream
+ */
+ostream & usage(ostream & os, char * name)
+{
+	os << "usage : " << name << " <input> <output> [--bench [<loads>]]" << endl
+	   << "  <input>  calibration file (YAML / XML or binary)" << endl
+	   << "  <output> converted calibration file : binary if it ends with "
+	   << ".calb, YAML / XML otherwise" << endl
+	   << "  --bench  compare text and binary load times of the calibration"
+	   << endl
+	   << "           (" << defaultBenchmarkIterations
+	   << " loads by default)" << endl;
+	return os;
+}
+
+int main(int argc, char ** argv)
+{
+	// ------------------------------------------------------------------------
+	// parse arguments
+	// ------------------------------------------------------------------------
+	if (argc < 3)
+	{
+		usage(cerr, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	string inputFilename = argv[1];
+	string outputFilename = argv[2];
+	int iterations = 0;
+	for (int i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench") == 0)
+		{
+			iterations = defaultBenchmarkIterations;
+			if (i + 1 < argc && sscanf(argv[i + 1], "%d", &iterations) == 1)
+			{
+				i++;
+			}
+		}
+		else
+		{
+			usage(cerr, argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// ------------------------------------------------------------------------
+	// convert
+	// ------------------------------------------------------------------------
+	CalibrationData calibration;
+	if (!calibration.read(inputFilename))
+	{
+		cerr << "Failed to read calibration : " << inputFilename << endl;
+		return EXIT_FAILURE;
+	}
+
+	if (CalibrationData::hasBinaryExtension(outputFilename) &&
+		!calibration.extraKeys.empty())
+	{
+		cerr << "Warning : binary files only hold the calibration, dropped :";
+		for (size_t k = 0; k < calibration.extraKeys.size(); k++)
+		{
+			cerr << " " << calibration.extraKeys[k];
+		}
+		cerr << endl;
+	}
+
+	if (!calibration.write(outputFilename))
+	{
+		cerr << "Failed to write calibration : " << outputFilename << endl;
+		return EXIT_FAILURE;
+	}
+
+	cout << inputFilename << " ("
+		 << (CalibrationData::isBinary(inputFilename) ? "binary" : "text")
+		 << ") converted to " << outputFilename << " ("
+		 << (CalibrationData::isBinary(outputFilename) ? "binary" : "text")
+		 << ")" << endl;
+
+	// ------------------------------------------------------------------------
+	// compare load times
+	// ------------------------------------------------------------------------
+	if (iterations > 0)
+	{
+		bool binaryInput = CalibrationData::isBinary(inputFilename);
+		bool binaryOutput = CalibrationData::isBinary(outputFilename);
+		if (binaryInput == binaryOutput)
+		{
+			cerr << "Benchmark needs a text and a binary file" << endl;
+			return EXIT_FAILURE;
+		}
+		CalibrationData::benchmark(binaryInput ? outputFilename : inputFilename,
+								   binaryInput ? inputFilename : outputFilename,
+								   iterations,
+								   stdout);
+	}
+
+	return EXIT_SUCCESS;
+}
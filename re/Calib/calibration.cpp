@@ -1,13 +1,36 @@
 #include <stdio.h>
 #include <time.h>
+#include <signal.h>
+#include <sys/stat.h>
 
 #include <string>
+#include <chrono>
 
 #include "opencv2/calib3d/calib3d.hpp"
 #include "opencv2/core/core.hpp"
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
 
+#include "ChessboardDetector.h"
+#include "BatchDetector.h"
+#include "ThreadPool.h"
+#include "LivePipeline.h"
+#include "ChessboardTracker.h"
+#include "FrameQualityFilter.h"
+#include "NoveltyGate.h"
+#include "ProgressiveSolver.h"
+#include "UndistortMaps.h"
+#include "CalibrationSolver.h"
+#include "CornerCache.h"
+#include "ViewSelector.h"
+#include "ReprojectionEngine.h"
+#include "RobustCalibrator.h"
+#include "UncertaintyEstimator.h"
+#include "CalibrationServer.h"
+#include "RigCalibrator.h"
+#include "CalibrationFile.h"
+#include "Profiler.h"
+
 using namespace cv;
 using namespace std;
 
@@ -21,6 +44,39 @@ const char * usage =
 	" example command line for calibration from a list of stored images:\n"
 	"   imagelist_creator image_list.xml *.png\n"
 	"   calibration -w 4 -h 5 -s 0.025 -o camera.yml -op -oe image_list.xml\n"
+	" \n"
+	" example command line for headless batch calibration of stored images\n"
+	" on 8 worker threads:\n"
+	"   calibration -w 4 -h 5 -s 0.025 -o camera.yml -b -j 8 image_list.xml\n"
+	" \n"
+	" example command line for calibration from a video file without any\n"
+	" display (i.e. in a container with no X server):\n"
+	"   calibration -w 4 -h 5 -s 0.025 -o camera.yml --headless -V board.avi\n"
+	" \n"
+	" example command line for adding new views to a previous calibration:\n"
+	"   calibration -w 4 -h 5 -s 0.025 -o camera2.yml --incremental camera.yml\n"
+	"      new_list.xml\n"
+	" \n"
+	" example command line for the extrinsic calibration of a camera rig:\n"
+	"   calibration -w 4 -h 5 -s 0.025 -o rig.yml --rig rig_description.yml\n"
+	" where rig_description.yml lists each camera synchronized images list and\n"
+	" intrinsic calibration (the first camera is the reference):\n"
+	"   %YAML:1.0\n"
+	"   cameras:\n"
+	"      - { images: \"left.xml\", calibration: \"left.yml\" }\n"
+	"      - { images: \"right.xml\", calibration: \"right.yml\" }\n"
+	" \n"
+	" example command line for a calibration server taking job files from a\n"
+	" spool directory, 2 jobs at a time, detections on 8 worker threads:\n"
+	"   calibration --serve /var/spool/calib --serve-jobs 2 -j 8\n"
+	" where a job file (e.g. cam01.job) is an OpenCV XML/YAML file:\n"
+	"   %YAML:1.0\n"
+	"   images: \"cam01/image_list.xml\"\n"
+	"   board_width: 4\n"
+	"   board_height: 5\n"
+	"   square_size: 0.025\n"
+	"   output: \"cam01/camera.yml\"\n"
+	" \n"
 	" where image_list.xml is the standard OpenCV XML/YAML\n"
 	" use imagelist_creator to create the xml or yaml list\n"
 	" file consisting of the list of strings, e.g.:\n"
@@ -67,9 +123,11 @@ void help()
 		"                              # (if not specified, it will be set to the number\n"
 		"                              #  of board views actually available)\n"
 		"     [-d <delay>]             # a minimum delay in ms between subsequent attempts to capture a next view\n"
-		"                              # (used only for video capturing)\n"
+		"                              # (used only for video capturing, measured on a monotonic clock)\n"
 		"     [-s <squareSize>]        # square size in some user-defined units (1 by default)\n"
 		"     [-o <out_camera_params>] # the output filename for intrinsic [and extrinsic] parameters\n"
+		"                              # (compact binary format if it ends with .calb,\n"
+		"                              # see calibConvert)\n"
 		"     [-op]                    # write detected feature points\n"
 		"     [-oe]                    # write extrinsic parameters\n"
 		"     [-zt]                    # assume zero tangential distortion\n"
@@ -87,6 +145,69 @@ void help()
 		"     [--device [0|1]]         # internal or external camera device\n"
 		"     [--reduce <reduce factor>] # image reduce factor\n"
 		"     [-m] || [--manual]       # trigger captures manualy with 'c' key\n"
+		"     [-b] || [--batch]        # headless batch detection of a list of stored images\n"
+		"                              # on a pool of workers, then calibration\n"
+		"     [-j <threads>]           # number of batch workers (all cores by default)\n"
+		"     [--headless]             # no window nor drawing : live or video input is\n"
+		"                              # captured from start, progress printed to stdout\n"
+		"     [--serve <spool_dir>]    # headless calibration server : process *.job files\n"
+		"                              # dropped in spool_dir until a stop file appears\n"
+		"     [--serve-jobs <n>]       # number of jobs processed concurrently (2 by default)\n"
+		"     [--rig <rig.yml>]        # extrinsic calibration of a rig of cameras with\n"
+		"                              # known intrinsics, rectification of each camera\n"
+		"                              # with the first one (see example above)\n"
+		"     [--rig-preview]          # with --rig, write the first common view of each\n"
+		"                              # pair rectified to <output>_rectified_0_<n>.png\n"
+		"     [--cache]                # cache detected corners of stored images in\n"
+		"                              # <input_data>.corners, reruns only detect new or\n"
+		"                              # modified images\n"
+		"     [--pyramid <level|auto>] # search the board on a decimated pyramid level\n"
+		"                              # then refine corners at full resolution\n"
+		"     [--track]                # live input : search the board around its previous\n"
+		"                              # position, full frame search only when lost\n"
+		"     [--track-flow]           # same as --track with previous corners propagated\n"
+		"                              # by optical flow\n"
+		"     [--no-novelty]           # live input : capture a view every <delay> ms instead of\n"
+		"                              # only views bringing a new board pose or new image\n"
+		"                              # coverage (pose estimated by solvePnP)\n"
+		"     [--progressive [<every>]] # live input : calibrate in the background every\n"
+		"                              # <every> captured views (5 by default), show the\n"
+		"                              # current intrinsics and stop capture once they converge\n"
+		"     [--prefilter [<sharpness>]] # live input : skip blurred (Laplacian variance\n"
+		"                              # under sharpness, 20 by default) or badly exposed\n"
+		"                              # frames before searching the board\n"
+		"     [--remap-format <16SC2|32FC1|32FC2>] # undistortion maps format (16SC2 by default)\n"
+		"     [--remap-interp <nearest|linear|cubic|lanczos>] # undistortion interpolation\n"
+		"                              # (linear by default)\n"
+		"     [--remap-bench]          # after calibration, compare undistortion maps formats\n"
+		"                              # and interpolations\n"
+		"     [--incremental <calib.yml>] # add the new views to a previous calibration\n"
+		"                              # written with -op : warm started refinement\n"
+		"                              # from its intrinsics, implies -op\n"
+		"     [--select <N>]           # calibrate with at most N views selected for board\n"
+		"                              # coverage and pose diversity\n"
+		"     [--select-compare]       # with --select, also calibrate with all views and\n"
+		"                              # compare solve time and reprojection error\n"
+		"     [--robust <px>]          # reject views whose error exceeds <px> one at a\n"
+		"                              # time, candidates re-solved in parallel\n"
+		"     [--robust-percentile <p>] # also reject views above the p-th percentile\n"
+		"                              # of the per view errors\n"
+		"     [--bootstrap <B>]        # after calibration, estimate parameters standard\n"
+		"                              # deviations from B resamples of the views\n"
+		"     [--kfold <k>]            # after calibration, k-fold cross validation of\n"
+		"                              # the views : held out reprojection error\n"
+		"     [--uncertainty-scaling]  # run the resampling on 1, 2, 4 ... threads and\n"
+		"                              # report elapsed times\n"
+		"     [--reproj-bench]         # after calibration, compare reprojection errors\n"
+		"                              # computation with projectPoints and the engine\n"
+		"     [--compare-cold]         # with --incremental, also run the full solve from\n"
+		"                              # scratch and compare timings\n"
+		"     [--pipeline]             # run capture and detection of live or video input\n"
+		"                              # in separate threads, newest frame only\n"
+		"     [--profile]              # time each stage of every frame and of the\n"
+		"                              # calibration, print p50/p95/p99 on exit\n"
+		"     [--trace <trace.json>]   # same as --profile, also write the stages timeline\n"
+		"                              # in Chrome trace format (chrome://tracing)\n"
 		"\n");
 	printf("\n%s", usage);
 	printf("\n%s", liveCaptureHelp);
@@ -95,192 +216,125 @@ void help()
 typedef enum { DETECTION = 0, CAPTURING = 1, CALIBRATED } CalibState;
 
 /**
- * Compute reprojection errors from calibrated camera by comparing reprojected
- * object points to image extracted points
- * @param objectPoints 3D object points
- * @param imagePoints 2D image points
- * @param rvecs rotation vectors
- * @param tvecs translation vectors
- * @param cameraMatrix calibrated camera matrix
- * @param distCoeffs distorsion coefficients
- * @param perViewErrors Per View errors ?
- * @return
+ * Number of evaluations per implementation of the reprojection errors
+ * benchmark
  */
-static double computeReprojectionErrors(
-	const vector<vector<Point3f> > & objectPoints,
-	const vector<vector<Point2f> > & imagePoints,
-	const vector<Mat> & rvecs,
-	const vector<Mat> & tvecs,
-	const Mat & cameraMatrix,
-	const Mat & distCoeffs,
-	vector<float> & perViewErrors)
-{
-	vector<Point2f> imagePoints2;
-	int i, totalPoints = 0;
-	double totalErr = 0, err;
-	perViewErrors.resize(objectPoints.size());
-
-	for (i = 0; i < (int) objectPoints.size(); i++)
-	{
-		projectPoints(Mat(objectPoints[i]),
-					  rvecs[i],
-					  tvecs[i],
-					  cameraMatrix,
-					  distCoeffs,
-					  imagePoints2);
-		err = norm(Mat(imagePoints[i]), Mat(imagePoints2), CV_L2);
-		int n = (int) objectPoints[i].size();
-		perViewErrors[i] = (float) std::sqrt(err * err / n);
-		totalErr += err * err;
-		totalPoints += n;
-	}
-
-	return std::sqrt(totalErr / totalPoints);
-}
+static const int reprojectionBenchmarkIterations = 50;
 
 /**
- * Compute chessboard corners from bordSize and squareSize
- * @param boardSize board size (i.e. [6,8])
- * @param squareSize square size on the board (i.e. 30 mm)
- * @param corners inner corner points on the chessboard
+ * Calibration options besides the camera model flags
  */
-static void calcChessboardCorners(Size boardSize,
-								  float squareSize,
-								  vector<Point3f> & corners)
+struct CalibrationOptions
+{
+	/**
+	 * Default constructor : plain calibration of all views
+	 */
+	CalibrationOptions();
+
+	/**
+	 * Previous calibration to refine with the new views (NULL for a full
+	 * calibration of the new views only)
+	 */
+	const CalibrationSeed * seed;
+
+	/**
+	 * When refining a seed, also run the full cold solve to compare timings
+	 */
+	bool compareCold;
+
+	/**
+	 * Maximum number of new views used by the calibration, a diverse subset
+	 * is selected when there are more views (0 to use all views)
+	 */
+	size_t maxViews;
+
+	/**
+	 * When a subset is selected, also calibrate with all views to compare
+	 * solve time and reprojection error
+	 */
+	bool compareSelection;
+
+	/**
+	 * Compare reprojection errors implementations on the calibrated views
+	 */
+	bool reprojectionBenchmark;
+
+	/**
+	 * Robust calibration : views with a larger error (in pixels) are
+	 * rejection candidates (0 to disable)
+	 */
+	double robustThreshold;
+
+	/**
+	 * Robust calibration : views above this percentile of the per view
+	 * errors are rejection candidates (0 to disable)
+	 */
+	double robustPercentile;
+
+	/**
+	 * Number of bootstrap resamples of the calibrated views (0 to skip
+	 * bootstrap)
+	 */
+	int bootstrapSamples;
+
+	/**
+	 * Number of cross validation folds of the calibrated views (0 to skip
+	 * cross validation)
+	 */
+	int folds;
+
+	/**
+	 * Measure resampling elapsed time for an increasing number of threads
+	 */
+	bool uncertaintyScaling;
+
+	/**
+	 * Number of worker threads (0 for all cores)
+	 */
+	int nbThreads;
+
+	/**
+	 * Stages timings recorder (NULL when not profiling)
+	 */
+	Profiler * profiler;
+};
+
+/*
+ * Default constructor : plain calibration of all views
+ */
+CalibrationOptions::CalibrationOptions() :
+	seed(NULL),
+	compareCold(false),
+	maxViews(0),
+	compareSelection(false),
+	reprojectionBenchmark(false),
+	robustThreshold(0),
+	robustPercentile(0),
+	bootstrapSamples(0),
+	folds(0),
+	uncertaintyScaling(false),
+	nbThreads(0),
+	profiler(NULL)
 {
-	corners.resize(0);
-
-	for (int i = 0; i < boardSize.height; i++)
-	{
-		for (int j = 0; j < boardSize.width; j++)
-		{
-			corners.push_back(
-				Point3f(float(j * squareSize), float(i * squareSize), 0));
-		}
-	}
 }
 
 /**
- * Run Calibration procedure
- * @param imagePoints chessboard image points on all views
- * @param imageSize image size
- * @param boardSize board size
- * @param squareSize square size on the chessboard
- * @param aspectRatio image aspect ratio
- * @param flags OpenCV calibration flags.
- * 	- CV_CALIB_USE_INTRINSIC_GUESS  1
- * 	- CV_CALIB_FIX_ASPECT_RATIO     2
- * 	- CV_CALIB_FIX_PRINCIPAL_POINT  4
- * 	- CV_CALIB_ZERO_TANGENT_DIST    8
- * 	- CV_CALIB_FIX_FOCAL_LENGTH 16
- * 	- CV_CALIB_FIX_K1  32
- * 	- CV_CALIB_FIX_K2  64
- * 	- CV_CALIB_FIX_K3  128
- * 	- CV_CALIB_FIX_K4  2048
- * 	- CV_CALIB_FIX_K5  4096
- * 	- CV_CALIB_FIX_K6  8192
- * 	- CV_CALIB_RATIONAL_MODEL 16384
- * @param cameraMatrix 3x3 camera matrix.
- * \f[
- * A = \left(
- * 	\begin{array}{ccc}
- * 		f_x & 0 & c_x \\
- * 		0 & f_y & c_y \\
- * 		0 & 0 & 1
- * 	\end{array}
- * \right)
- * \f]
- * @param distCoeffs 1x8 distorsion coefficients vector.
- * Such as if
- * \f[
- * \left(
- * 	\begin{array}{c}
- * 		x \\
- * 		y \\
- * 		y
- * 	\end{array}
- * \right) = R
- * \left(
- * 	\begin{array}{c}
- * 		X \\
- * 		Y \\
- * 		Z
- * 	\end{array}
- * \right) + t
- * \f]
- * \f$x' = \frac{x}{z}\f$
- *
- * \f$y' = \frac{y}{z}\f$
- *
- * \f$x'' = x' \frac{1+k_1r^2+k_2r^4+k_3r^6}{1+k_4r^2+k_5r^4+k_6r^6}
- * + 2p_1x'y' + p_2(r^2 + 2x'^2)\f$
- *
- * \f$ y'' = y' \frac{1+k_1r^2+k_2r^4+k_3r^6}{1+k_4r^2+k_5r^4+k_6r^6}
- * + 2p_2x'y' + p_1(r^2 + 2y'^2) \f$ where
- * \f$ r^2 = x'^2 + y'^2\f$
- *
- * \f$u = f_x \cdot x'' + c_x\f$
- *
- * \f$v = f_y \cdot y'' + c_y\f$
- * @param rvecs Rotation vectors for each view
- * @param tvecs TRanslation vector for each view
- * @param reprojErrs Points reprojection errors
- * @param totalAvgErr total average error
- * @return true if calibration went right
+ * Size of a file
+ * @param filename the file name
+ * @return the file size in bytes (0 if the file does not exist)
  */
-static bool runCalibration(vector<vector<Point2f> > imagePoints,
-						   Size imageSize,
-						   Size boardSize,
-						   float squareSize,
-						   float aspectRatio,
-						   int flags,
-						   Mat & cameraMatrix,
-						   Mat & distCoeffs,
-						   vector<Mat> & rvecs,
-						   vector<Mat> & tvecs,
-						   vector<float> & reprojErrs,
-						   double & totalAvgErr)
+static size_t fileSize(const string & filename)
 {
-	cameraMatrix = Mat::eye(3, 3, CV_64F);
-	if (flags & CV_CALIB_FIX_ASPECT_RATIO)
-	{
-		cameraMatrix.at<double>(0, 0) = aspectRatio;
-	}
-
-	distCoeffs = Mat::zeros(8, 1, CV_64F);
-
-	vector<vector<Point3f> > objectPoints(1);
-	calcChessboardCorners(boardSize, squareSize, objectPoints[0]);
-
-	objectPoints.resize(imagePoints.size(), objectPoints[0]);
-
-	double rms = calibrateCamera(objectPoints,
-								 imagePoints,
-								 imageSize,
-								 cameraMatrix,
-								 distCoeffs,
-								 rvecs,
-								 tvecs,
-								 flags | CV_CALIB_FIX_K4 | CV_CALIB_FIX_K5);
-	///*|CV_CALIB_FIX_K3*/|CV_CALIB_FIX_K4|CV_CALIB_FIX_K5);
-	printf("RMS error reported by calibrateCamera: %g\n", rms);
-
-	bool ok = checkRange(cameraMatrix) && checkRange(distCoeffs);
-
-	totalAvgErr = computeReprojectionErrors(objectPoints,
-											imagePoints,
-											rvecs,
-											tvecs,
-											cameraMatrix,
-											distCoeffs,
-											reprojErrs);
-
-	return ok;
+	struct stat status;
+	return stat(filename.c_str(), &status) == 0 ? (size_t) status.st_size : 0;
 }
 
 /**
- * Save camera calibration matrix to file
- * @param filename file name to save data
+ * Save camera calibration matrix to file. In YAML / XML, extrinsics and
+ * image points are streamed view by view rather than gathered into matrices
+ * first, bytes written and write time are reported.
+ * @param filename file name to save data (binary format if it ends with
+ * .calb)
  * @param imageSize image size
  * @param boardSize board size
  * @param squareSize board squares size
@@ -293,6 +347,9 @@ static bool runCalibration(vector<vector<Point2f> > imagePoints,
  * @param reprojErrs reprojection errors
  * @param imagePoints image points
  * @param totalAvgErr tota average error
+ * @param robust robust calibration report (NULL if robust calibration was not
+ * used)
+ * @param uncertainty resampling report (NULL if uncertainty was not estimated)
  */
 void saveCameraParams(const string & filename,
 					  Size imageSize,
@@ -306,9 +363,11 @@ void saveCameraParams(const string & filename,
 					  const vector<Mat> & tvecs,
 					  const vector<float> & reprojErrs,
 					  const vector<vector<Point2f> > & imagePoints,
-					  double totalAvgErr)
+					  double totalAvgErr,
+					  const RobustStatistics * robust,
+					  const UncertaintyStatistics * uncertainty)
 {
-	FileStorage fs(filename, FileStorage::WRITE);
+	CalibrationData data;
 
 	time_t t;
 	time(&t);
@@ -316,72 +375,143 @@ void saveCameraParams(const string & filename,
 	char buf[1024];
 	strftime(buf, sizeof(buf) - 1, "%c", t2);
 
-	fs << "calibration_time" << buf;
-
-	if (!rvecs.empty() || !reprojErrs.empty())
+	data.calibrationTime = buf;
+	data.nframes = (int) std::max(rvecs.size(), reprojErrs.size());
+	data.imageSize = imageSize;
+	data.boardSize = boardSize;
+	data.squareSize = squareSize;
+	data.aspectRatio = aspectRatio;
+	data.flags = flags;
+	data.cameraMatrix = cameraMatrix;
+	data.distCoeffs = distCoeffs;
+	data.avgReprojectionError = totalAvgErr;
+	if (!reprojErrs.empty())
 	{
-		fs << "nframes" << (int) std::max(rvecs.size(), reprojErrs.size());
+		data.perViewErrors = Mat(reprojErrs).clone();
 	}
-	fs << "image_width" << imageSize.width;
-	fs << "image_height" << imageSize.height;
-	fs << "board_width" << boardSize.width;
-	fs << "board_height" << boardSize.height;
-	fs << "square_size" << squareSize;
 
-	if (flags & CV_CALIB_FIX_ASPECT_RATIO)
-		fs << "aspectRatio" << aspectRatio;
+	bool extrinsics = !rvecs.empty() && !tvecs.empty();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
-	if (flags != 0)
+	// the binary format only holds the calibration itself, its sections are
+	// compact enough to be gathered before being written
+	if (CalibrationData::hasBinaryExtension(filename))
 	{
-		sprintf(buf,
-				"flags: %s%s%s%s",
-				flags & CV_CALIB_USE_INTRINSIC_GUESS ? "+use_intrinsic_guess" : "",
-				flags & CV_CALIB_FIX_ASPECT_RATIO ? "+fix_aspectRatio" : "",
-				flags & CV_CALIB_FIX_PRINCIPAL_POINT ? "+fix_principal_point" : "",
-				flags & CV_CALIB_ZERO_TANGENT_DIST ? "+zero_tangent_dist" : "");
-		cvWriteComment(*fs, buf, 0);
-	}
-
-	fs << "flags" << flags;
+		if (extrinsics)
+		{
+			data.extrinsics.create((int) rvecs.size(), 6, CV_32F);
+			for (int i = 0; i < (int) rvecs.size(); i++)
+			{
+				Mat r = data.extrinsics(Range(i, i + 1), Range(0, 3));
+				Mat t = data.extrinsics(Range(i, i + 1), Range(3, 6));
+				rvecs[i].reshape(1, 1).convertTo(r, CV_32F);
+				tvecs[i].reshape(1, 1).convertTo(t, CV_32F);
+			}
+		}
 
-	fs << "camera_matrix" << cameraMatrix;
-	fs << "distortion_coefficients" << distCoeffs;
+		if (!imagePoints.empty())
+		{
+			data.imagePoints.create(
+				(int) imagePoints.size(), imagePoints[0].size(), CV_32FC2);
+			for (int i = 0; i < (int) imagePoints.size(); i++)
+			{
+				Mat r = data.imagePoints.row(i).reshape(2, data.imagePoints.cols);
+				Mat imgpti(imagePoints[i]);
+				imgpti.copyTo(r);
+			}
+		}
 
-	fs << "avg_reprojection_error" << totalAvgErr;
-	if (!reprojErrs.empty())
-	{
-		fs << "per_view_reprojection_errors" << Mat(reprojErrs);
+		if (!data.writeBinary(filename))
+		{
+			fprintf(stderr, "Could not write %s\n", filename.c_str());
+			return;
+		}
 	}
-
-	if (!rvecs.empty() && !tvecs.empty())
+	else
 	{
-		Mat bigmat((int) rvecs.size(), 6, CV_32F);
-		for (int i = 0; i < (int) rvecs.size(); i++)
+		FileStorage fs(filename, FileStorage::WRITE);
+		if (!fs.isOpened())
 		{
-			Mat r = bigmat(Range(i, i + 1), Range(0, 3));
-			Mat t = bigmat(Range(i, i + 1), Range(3, 6));
-			rvecs[i].copyTo(r);
-			tvecs[i].copyTo(t);
+			fprintf(stderr, "Could not write %s\n", filename.c_str());
+			return;
 		}
-		cvWriteComment(*fs,
-					   "a set of 6-tuples (rotation vector + translation "
-					   "vector) for each view",
-					   0);
-		fs << "extrinsic_parameters" << bigmat;
-	}
+		data.writeText(fs);
 
-	if (!imagePoints.empty())
-	{
-		Mat imagePtMat(
-			(int) imagePoints.size(), imagePoints[0].size(), CV_32FC2);
-		for (int i = 0; i < (int) imagePoints.size(); i++)
+		// per view outputs go straight to the storage, one view at a time
+		if (extrinsics)
+		{
+			CalibrationData::writeExtrinsics(fs, rvecs, tvecs);
+		}
+		if (!imagePoints.empty())
 		{
-			Mat r = imagePtMat.row(i).reshape(2, imagePtMat.cols);
-			Mat imgpti(imagePoints[i]);
-			imgpti.copyTo(r);
+			CalibrationData::writeImagePoints(fs, imagePoints);
 		}
-		fs << "image_points" << imagePtMat;
+
+		if (robust != NULL)
+		{
+			if (!robust->rejected.empty())
+			{
+				cvWriteComment(*fs,
+							   "views rejected by the robust calibration (indices "
+							   "among the detected views) and their errors",
+							   0);
+				fs << "rejected_views" << Mat(robust->rejected);
+				fs << "rejected_view_errors" << Mat(robust->rejectedErrors);
+			}
+			cvWriteComment(*fs,
+						   "avg reprojection error of the initial solve then "
+						   "after each rejection",
+						   0);
+			fs << "error_trajectory" << Mat(robust->trajectory);
+		}
+
+		if (uncertainty != NULL)
+		{
+			if (uncertainty->bootstrapSamples > 0)
+			{
+				cvWriteComment(*fs,
+							   "parameters standard deviations over bootstrap "
+							   "resamples of the views (fx, fy, cx, cy, k1, k2, p1, "
+							   "p2, k3)",
+							   0);
+				fs << "bootstrap_samples" << uncertainty->bootstrapSamples;
+				fs << "parameters_std_dev" << uncertainty->bootstrapStdDev;
+			}
+			if (uncertainty->folds > 0)
+			{
+				cvWriteComment(*fs,
+							   "k-fold cross validation : reprojection error of the "
+							   "held out views of each fold and over all folds",
+							   0);
+				fs << "cross_validation_folds" << uncertainty->folds;
+				fs << "fold_errors" << Mat(uncertainty->foldErrors);
+				fs << "held_out_error" << uncertainty->heldOutError;
+				fs << "fold_parameters_std_dev" << uncertainty->foldStdDev;
+			}
+			if (!uncertainty->scaling.empty())
+			{
+				Mat scaling((int) uncertainty->scaling.size(), 2, CV_64F);
+				for (size_t i = 0; i < uncertainty->scaling.size(); i++)
+				{
+					scaling.at<double>((int) i, 0) = uncertainty->scaling[i].first;
+					scaling.at<double>((int) i, 1) = uncertainty->scaling[i].second;
+				}
+				cvWriteComment(*fs,
+							   "resampling elapsed time in seconds per number of "
+							   "threads",
+							   0);
+				fs << "uncertainty_scaling" << scaling;
+			}
+		}
+
+		fs.release();
 	}
+
+	printf("Saved %s : %lu bytes in %.3f s\n",
+		   filename.c_str(),
+		   (unsigned long) fileSize(filename),
+		   chrono::duration<double>(chrono::steady_clock::now() - start)
+			   .count());
 }
 
 /**
@@ -424,11 +554,13 @@ static bool readStringList(const string & filename, vector<string> & l)
  * @param distCoeffs distorsion coefficients
  * @param writeExtrinsics Also write extrinsic parameters to file
  * @param writePoints Also write points to file
+ * @param options incremental, selection, robust calibration, uncertainty and
+ * benchmarks options
  * @return true if calibration have been performed and results saved to file,
  * false otherwise
  */
 bool runAndSave(const string & outputFilename,
-				const vector<vector<Point2f> > & imagePoints,
+				const vector<vector<Point2f> > & newImagePoints,
 				Size imageSize,
 				Size boardSize,
 				float squareSize,
@@ -437,30 +569,219 @@ bool runAndSave(const string & outputFilename,
 				Mat & cameraMatrix,
 				Mat & distCoeffs,
 				bool writeExtrinsics,
-				bool writePoints)
+				bool writePoints,
+				const CalibrationOptions & options)
 {
+	Profiler::Scope runScope(options.profiler, "runAndSave");
+	const CalibrationSeed * seed = options.seed;
+	size_t maxViews = options.maxViews;
 	vector<Mat> rvecs, tvecs;
 	vector<float> reprojErrs;
 	double totalAvgErr = 0;
+	vector<vector<Point2f> > imagePoints;
+	vector<vector<Point2f> > selectedPoints;
+	bool ok;
+	bool robust = options.robustThreshold > 0 || options.robustPercentile > 0;
+	RobustStatistics robustStatistics;
+
+	// bound the number of views to solve with by a diverse subset
+	SelectionStatistics selection;
+	bool selecting = maxViews > 0 && newImagePoints.size() > maxViews;
+	vector<size_t> selected;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if (selecting)
+	{
+		ViewSelector selector(imageSize, boardSize);
+		selection.views = newImagePoints.size();
+		selection.coverageSelected =
+			selector.select(newImagePoints, maxViews, selected);
+		selection.selected = selected.size();
+		for (size_t v = 0; v < selected.size(); v++)
+		{
+			selectedPoints.push_back(newImagePoints[selected[v]]);
+		}
+		selection.selectionTime =
+			chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (options.profiler != NULL)
+		{
+			options.profiler->record("selectViews",
+									 start,
+									 chrono::steady_clock::now());
+		}
+		selection.coverageAll = selector.coverage(newImagePoints);
+	}
+	const vector<vector<Point2f> > & calibrationPoints =
+		selecting ? selectedPoints : newImagePoints;
+
+	start = chrono::steady_clock::now();
+	if (seed != NULL)
+	{
+		IncrementalStatistics statistics;
+		ok = runIncrementalCalibration(*seed,
+									   calibrationPoints,
+									   imageSize,
+									   boardSize,
+									   squareSize,
+									   aspectRatio,
+									   flags,
+									   options.compareCold,
+									   cameraMatrix,
+									   distCoeffs,
+									   imagePoints,
+									   rvecs,
+									   tvecs,
+									   reprojErrs,
+									   totalAvgErr,
+									   statistics);
+		statistics.print(stdout);
+	}
+	else if (robust)
+	{
+		ThreadPool pool(options.nbThreads);
+		RobustCalibrator calibrator(pool,
+									options.robustThreshold,
+									options.robustPercentile);
+		ok = calibrator.run(calibrationPoints,
+							imageSize,
+							boardSize,
+							squareSize,
+							aspectRatio,
+							flags,
+							cameraMatrix,
+							distCoeffs,
+							imagePoints,
+							rvecs,
+							tvecs,
+							reprojErrs,
+							totalAvgErr);
+		robustStatistics = calibrator.getStatistics();
+		// rejected indices are among the selected views : saved and printed
+		// among the detected views
+		if (selecting)
+		{
+			for (size_t r = 0; r < robustStatistics.rejected.size(); r++)
+			{
+				robustStatistics.rejected[r] =
+					(int) selected[robustStatistics.rejected[r]];
+			}
+		}
+		robustStatistics.print(stdout);
+	}
+	else
+	{
+		imagePoints = calibrationPoints;
+		ok = runCalibration(imagePoints,
+							imageSize,
+							boardSize,
+							squareSize,
+							aspectRatio,
+							flags,
+							cameraMatrix,
+							distCoeffs,
+							rvecs,
+							tvecs,
+							reprojErrs,
+							totalAvgErr);
+	}
+	if (options.profiler != NULL)
+	{
+		options.profiler->record("calibrateCamera",
+								 start,
+								 chrono::steady_clock::now());
+	}
+
+	if (selecting)
+	{
+		selection.subsetTime =
+			chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		selection.subsetError = totalAvgErr;
+
+		// the incremental solve already compares with a full solve
+		if (ok && options.compareSelection && seed == NULL)
+		{
+			Mat fullCameraMatrix, fullDistCoeffs;
+			vector<Mat> fullRvecs, fullTvecs;
+			vector<float> fullErrs, evaluatedErrs;
+
+			selection.subsetErrorAll = evaluateCalibration(newImagePoints,
+														   boardSize,
+														   squareSize,
+														   cameraMatrix,
+														   distCoeffs,
+														   evaluatedErrs);
+
+			start = chrono::steady_clock::now();
+			runCalibration(newImagePoints,
+						   imageSize,
+						   boardSize,
+						   squareSize,
+						   aspectRatio,
+						   flags,
+						   fullCameraMatrix,
+						   fullDistCoeffs,
+						   fullRvecs,
+						   fullTvecs,
+						   fullErrs,
+						   selection.fullError);
+			selection.fullTime =
+				chrono::duration<double>(chrono::steady_clock::now() - start)
+					.count();
+			selection.compared = true;
+		}
+
+		selection.print(stdout);
+	}
+
+	// resample the calibrated views
+	UncertaintyStatistics uncertainty;
+	bool resampling = options.bootstrapSamples > 0 || options.folds > 0;
+	if (ok && resampling)
+	{
+		Profiler::Scope scope(options.profiler, "uncertainty");
+		UncertaintyEstimator estimator(imagePoints,
+									   imageSize,
+									   boardSize,
+									   squareSize,
+									   aspectRatio,
+									   flags);
+		if (options.uncertaintyScaling)
+		{
+			estimator.measureScaling(options.nbThreads > 0 ?
+										 (size_t) options.nbThreads :
+										 ThreadPool::defaultThreadCount(),
+									 options.bootstrapSamples,
+									 options.folds);
+		}
+		else
+		{
+			ThreadPool pool(options.nbThreads);
+			estimator.run(pool, options.bootstrapSamples, options.folds);
+		}
+		uncertainty = estimator.getStatistics();
+		uncertainty.print(stdout);
+	}
+
+	if (ok && options.reprojectionBenchmark)
+	{
+		vector<Point3f> pattern;
+		calcChessboardCorners(boardSize, squareSize, pattern);
+		ReprojectionEngine::benchmark(pattern,
+									  imagePoints,
+									  rvecs,
+									  tvecs,
+									  cameraMatrix,
+									  distCoeffs,
+									  reprojectionBenchmarkIterations,
+									  stdout);
+	}
 
-	bool ok = runCalibration(imagePoints,
-							 imageSize,
-							 boardSize,
-							 squareSize,
-							 aspectRatio,
-							 flags,
-							 cameraMatrix,
-							 distCoeffs,
-							 rvecs,
-							 tvecs,
-							 reprojErrs,
-							 totalAvgErr);
 	printf("%s. avg reprojection error = %.2f\n",
 		   ok ? "Calibration succeeded" : "Calibration failed",
 		   totalAvgErr);
 
 	if (ok)
 	{
+		Profiler::Scope scope(options.profiler, "saveCameraParams");
 		saveCameraParams(outputFilename,
 						 imageSize,
 						 boardSize,
@@ -473,11 +794,47 @@ bool runAndSave(const string & outputFilename,
 						 writeExtrinsics ? tvecs : vector<Mat>(),
 						 writeExtrinsics ? reprojErrs : vector<float>(),
 						 writePoints ? imagePoints : vector<vector<Point2f> >(),
-						 totalAvgErr);
+						 totalAvgErr,
+						 robust && seed == NULL ? &robustStatistics : NULL,
+						 resampling ? &uncertainty : NULL);
 	}
 	return ok;
 }
 
+/**
+ * Print stages timings of a profiled run and write its trace
+ * @param profiler the run profiler (NULL if the run was not profiled)
+ * @param traceFilename the trace file name (NULL for no trace)
+ */
+static void reportProfile(const Profiler * profiler, const char * traceFilename)
+{
+	if (profiler == NULL)
+	{
+		return;
+	}
+	profiler->print(stdout);
+	if (traceFilename != NULL)
+	{
+		if (profiler->writeTrace(traceFilename))
+		{
+			printf("Stages trace written to %s\n", traceFilename);
+		}
+		else
+		{
+			fprintf(stderr, "Could not write %s\n", traceFilename);
+		}
+	}
+}
+
+/**
+ * Stop the calibration server on SIGINT or SIGTERM
+ * @param signal the received signal
+ */
+static void stopServer(int)
+{
+	CalibrationServer::requestStop();
+}
+
 /**
  * Calibration Main program
  * @param argc argument count
@@ -502,13 +859,45 @@ int main(int argc, char ** argv)
 	bool showUndistorted = false;
 	bool videofile = false;
 	int delay = 1000;
-	clock_t prevTimestamp = 0;
+	chrono::steady_clock::time_point prevTimestamp;
 	CalibState mode = DETECTION;
 	int cameraId = 0;
 	int reduceFactor = 1;
 	vector<vector<Point2f> > imagePoints;
 	vector<string> imageList;
 	bool manualTrigger = false;
+	bool batchMode = false;
+	bool headless = false;
+	bool profiling = false;
+	const char * traceFilename = 0;
+	Profiler * profiler = NULL;
+	int nbThreads = 0;
+	bool pipelined = false;
+	int pyramidLevel = 0;
+	bool tracking = false, trackingFlow = false;
+	int remapFormat = CV_16SC2, remapInterpolation = INTER_LINEAR;
+	bool remapBenchmark = false;
+	const int remapBenchmarkIterations = 20;
+	const char * seedFilename = 0;
+	CalibrationSeed seedCalibration;
+	CalibrationOptions options;
+	bool useCache = false;
+	int maxViews = 0;
+	const char * spoolDirectory = 0;
+	int serveJobs = 2;
+	const char * rigFilename = 0;
+	bool rigPreview = false;
+	CornerCache * cache = NULL;
+	ChessboardTracker * tracker = NULL;
+	bool prefilter = false;
+	double minSharpness = 20;
+	FrameQualityFilter * qualityFilter = NULL;
+	bool novelty = true;
+	NoveltyGate * noveltyGate = NULL;
+	int progressiveEvery = 0;
+	ProgressiveSolver * progressiveSolver = NULL;
+	ProgressiveResult progress;
+	LivePipeline * pipeline = NULL;
 	int key;
 
 	if (argc < 2)
@@ -632,12 +1021,291 @@ int main(int argc, char ** argv)
 		{
 			manualTrigger = true;
 		}
+		else if ((strcmp(s, "-b") == 0) || (strcmp(s, "--batch") == 0))
+		{
+			batchMode = true;
+		}
+		else if (strcmp(s, "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (strcmp(s, "--pyramid") == 0)
+		{
+			const char * level = argv[++i];
+			if (strcmp(level, "auto") == 0)
+			{
+				pyramidLevel = ChessboardDetector::AUTO_PYRAMID_LEVEL;
+			}
+			else if (sscanf(level, "%d", &pyramidLevel) != 1 || pyramidLevel < 0)
+			{
+				return fprintf(stderr, "Invalid pyramid level\n"), -1;
+			}
+		}
+		else if (strcmp(s, "--track") == 0)
+		{
+			tracking = true;
+		}
+		else if (strcmp(s, "--track-flow") == 0)
+		{
+			tracking = true;
+			trackingFlow = true;
+		}
+		else if (strcmp(s, "--progressive") == 0)
+		{
+			progressiveEvery = 5;
+			if (i + 1 < argc &&
+				sscanf(argv[i + 1], "%d", &progressiveEvery) == 1)
+			{
+				i++;
+				if (progressiveEvery <= 0)
+				{
+					return fprintf(stderr, "Invalid progressive period\n"), -1;
+				}
+			}
+		}
+		else if (strcmp(s, "--no-novelty") == 0)
+		{
+			novelty = false;
+		}
+		else if (strcmp(s, "--prefilter") == 0)
+		{
+			prefilter = true;
+			if (i + 1 < argc && sscanf(argv[i + 1], "%lf", &minSharpness) == 1)
+			{
+				i++;
+			}
+		}
+		else if (strcmp(s, "--remap-format") == 0)
+		{
+			if (!UndistortMaps::parseMapType(argv[++i], remapFormat))
+			{
+				return fprintf(stderr, "Invalid remap format\n"), -1;
+			}
+		}
+		else if (strcmp(s, "--remap-interp") == 0)
+		{
+			if (!UndistortMaps::parseInterpolation(argv[++i],
+												   remapInterpolation))
+			{
+				return fprintf(stderr, "Invalid remap interpolation\n"), -1;
+			}
+		}
+		else if (strcmp(s, "--remap-bench") == 0)
+		{
+			remapBenchmark = true;
+		}
+		else if (strcmp(s, "--incremental") == 0)
+		{
+			seedFilename = argv[++i];
+		}
+		else if (strcmp(s, "--select") == 0)
+		{
+			if (sscanf(argv[++i], "%d", &maxViews) != 1 || maxViews <= 3)
+			{
+				return fprintf(stderr, "Invalid number of selected views\n"), -1;
+			}
+		}
+		else if (strcmp(s, "--select-compare") == 0)
+		{
+			options.compareSelection = true;
+		}
+		else if (strcmp(s, "--reproj-bench") == 0)
+		{
+			options.reprojectionBenchmark = true;
+		}
+		else if (strcmp(s, "--robust") == 0)
+		{
+			if (sscanf(argv[++i], "%lf", &options.robustThreshold) != 1 ||
+				options.robustThreshold <= 0)
+			{
+				return fprintf(stderr, "Invalid robust error threshold\n"), -1;
+			}
+		}
+		else if (strcmp(s, "--bootstrap") == 0)
+		{
+			if (sscanf(argv[++i], "%d", &options.bootstrapSamples) != 1 ||
+				options.bootstrapSamples < 2)
+			{
+				return fprintf(stderr, "Invalid number of bootstrap samples\n"),
+					-1;
+			}
+		}
+		else if (strcmp(s, "--kfold") == 0)
+		{
+			if (sscanf(argv[++i], "%d", &options.folds) != 1 ||
+				options.folds < 2)
+			{
+				return fprintf(stderr, "Invalid number of folds\n"), -1;
+			}
+		}
+		else if (strcmp(s, "--uncertainty-scaling") == 0)
+		{
+			options.uncertaintyScaling = true;
+		}
+		else if (strcmp(s, "--robust-percentile") == 0)
+		{
+			if (sscanf(argv[++i], "%lf", &options.robustPercentile) != 1 ||
+				options.robustPercentile <= 0 || options.robustPercentile >= 100)
+			{
+				return fprintf(stderr, "Invalid robust percentile\n"), -1;
+			}
+		}
+		else if (strcmp(s, "--cache") == 0)
+		{
+			useCache = true;
+		}
+		else if (strcmp(s, "--compare-cold") == 0)
+		{
+			options.compareCold = true;
+		}
+		else if (strcmp(s, "--serve") == 0)
+		{
+			spoolDirectory = argv[++i];
+		}
+		else if (strcmp(s, "--serve-jobs") == 0)
+		{
+			if (sscanf(argv[++i], "%d", &serveJobs) != 1 || serveJobs <= 0)
+			{
+				return fprintf(stderr, "Invalid number of server jobs\n"), -1;
+			}
+		}
+		else if (strcmp(s, "--rig") == 0)
+		{
+			rigFilename = argv[++i];
+		}
+		else if (strcmp(s, "--rig-preview") == 0)
+		{
+			rigPreview = true;
+		}
+		else if (strcmp(s, "--pipeline") == 0)
+		{
+			pipelined = true;
+		}
+		else if (strcmp(s, "--profile") == 0)
+		{
+			profiling = true;
+		}
+		else if (strcmp(s, "--trace") == 0)
+		{
+			traceFilename = argv[++i];
+		}
+		else if ((strcmp(s, "-j") == 0) || (strcmp(s, "--threads") == 0))
+		{
+			if (sscanf(argv[++i], "%d", &nbThreads) != 1 || nbThreads <= 0)
+			{
+				return fprintf(stderr, "Invalid number of threads\n"), -1;
+			}
+		}
 		else
 		{
 			return fprintf(stderr, "Unknown option %s", s), -1;
 		}
 	}
 
+	options.maxViews = (size_t) maxViews;
+	options.nbThreads = nbThreads;
+	if (profiling || traceFilename)
+	{
+		profiler = new Profiler();
+		options.profiler = profiler;
+	}
+
+	const int findFlags = CV_CALIB_CB_ADAPTIVE_THRESH |
+						  CV_CALIB_CB_FAST_CHECK |
+						  CV_CALIB_CB_NORMALIZE_IMAGE;
+
+	// ------------------------------------------------------------------------
+	// Server mode : calibrate jobs from a spool directory until stopped,
+	// without any capture nor display
+	// ------------------------------------------------------------------------
+	if (spoolDirectory)
+	{
+		ThreadPool pool(nbThreads);
+		CalibrationServer server(
+			spoolDirectory,
+			pool,
+			(size_t) serveJobs,
+			findFlags,
+			pyramidLevel,
+			[&options](const CalibrationJob & job,
+					   const vector<vector<Point2f> > & jobPoints,
+					   Size jobImageSize)
+			{
+				Mat jobCameraMatrix, jobDistCoeffs;
+				return runAndSave(job.outputFilename,
+								  jobPoints,
+								  jobImageSize,
+								  job.boardSize,
+								  job.squareSize,
+								  job.aspectRatio,
+								  job.flags,
+								  jobCameraMatrix,
+								  jobDistCoeffs,
+								  job.writeExtrinsics,
+								  job.writePoints,
+								  options);
+			});
+
+		signal(SIGINT, stopServer);
+		signal(SIGTERM, stopServer);
+		printf("Serving calibration jobs from %s, %d at a time, detections on "
+			   "%d workers ...\n",
+			   spoolDirectory, serveJobs, (int) pool.size());
+		size_t failed = server.run();
+		server.getStatistics().print(stdout);
+		return failed == 0 ? 0 : -1;
+	}
+
+	// ------------------------------------------------------------------------
+	// Rig mode : detect synchronized images of all cameras, then solve each
+	// camera pose relative to the first one and rectify pairs
+	// ------------------------------------------------------------------------
+	if (rigFilename)
+	{
+		if (boardSize.area() == 0)
+		{
+			return fprintf(stderr, "Rig mode requires the board size\n"), -1;
+		}
+
+		ThreadPool pool(nbThreads);
+		RigCalibrator rig(pool,
+						  boardSize,
+						  squareSize,
+						  findFlags,
+						  remapFormat,
+						  remapInterpolation);
+		if (!rig.read(rigFilename))
+		{
+			return fprintf(stderr, "Could not read rig %s\n", rigFilename), -1;
+		}
+
+		printf("Calibrating a rig of %d cameras on %d workers ...\n",
+			   (int) rig.getCameras().size(), (int) pool.size());
+		bool ok = rig.run();
+		for (size_t p = 0; p < rig.getPairs().size(); p++)
+		{
+			const RigPair & pair = rig.getPairs()[p];
+			printf("Camera %u : %u common views, %s, avg reprojection error = "
+				   "%.2f\n",
+				   (unsigned) pair.camera,
+				   (unsigned) pair.commonViews.size(),
+				   pair.solved ? "solved" : "not solved",
+				   pair.error);
+		}
+		rig.getStatistics().print(stdout);
+
+		if (!rig.save(outputFilename))
+		{
+			return fprintf(stderr, "Could not write %s\n", outputFilename), -1;
+		}
+		if (rigPreview)
+		{
+			string prefix(outputFilename);
+			rig.writeRectified(prefix.substr(0, prefix.rfind('.')));
+		}
+		return ok ? 0 : -1;
+	}
+
 	printf("Required camera Id is %d\n", cameraId);
 
 	if (inputFilename)
@@ -666,20 +1334,242 @@ int main(int argc, char ** argv)
 		nframes = (int) imageList.size();
 	}
 
-	if (capture.isOpened())
+	if (seedFilename)
+	{
+		if (!seedCalibration.read(seedFilename))
+		{
+			return fprintf(stderr, "Could not read previous calibration %s\n",
+						   seedFilename), -1;
+		}
+		if (seedCalibration.imagePoints.empty())
+		{
+			return fprintf(stderr,
+						   "Previous calibration %s has no image points "
+						   "(write it with -op)\n", seedFilename), -1;
+		}
+		options.seed = &seedCalibration;
+		printf("Refining %s (%d views) with new views\n",
+			   seedFilename,
+			   (int) seedCalibration.imagePoints.size());
+		// the result seeds the next incremental run
+		writePoints = true;
+		if (options.robustThreshold > 0 || options.robustPercentile > 0)
+		{
+			printf("Robust calibration is not available with --incremental, "
+				   "ignored\n");
+		}
+	}
+
+	ChessboardDetector detector(boardSize, findFlags);
+	detector.setPyramidLevel(pyramidLevel);
+
+	// detection results of stored images are cached next to the images list
+	if (useCache && !imageList.empty())
+	{
+		cache = new CornerCache(string(inputFilename) + ".corners",
+								CornerCache::parametersKeyOf(detector,
+															 flipVertical));
+		if (!cache->open())
+		{
+			printf("Creating corner cache %s\n", cache->getFilename().c_str());
+		}
+	}
+
+	// ------------------------------------------------------------------------
+	// Batch mode : detect all stored images on a pool of workers then
+	// calibrate once, without any display
+	// ------------------------------------------------------------------------
+	if (batchMode)
+	{
+		if (imageList.empty())
+		{
+			return fprintf(stderr,
+						   "Batch mode requires a list of stored images\n"), -1;
+		}
+
+		ThreadPool pool(nbThreads);
+		BatchDetector batch(detector, pool, flipVertical, cache);
+		vector<BatchView> views;
+
+		printf("Detecting chessboards in %d images on %d workers ...\n",
+			   (int) imageList.size(), (int) pool.size());
+		batch.run(imageList, views);
+
+		if (cache != NULL)
+		{
+			if (!cache->save())
+			{
+				fprintf(stderr, "Could not write corner cache %s\n",
+						cache->getFilename().c_str());
+			}
+			cache->printStatistics(stdout);
+			delete cache;
+		}
+
+		// collect views in list order
+		for (i = 0; i < (int) views.size(); i++)
+		{
+			if (!views[i].loaded)
+			{
+				fprintf(stderr, "Could not read image %s\n",
+						imageList[i].c_str());
+				continue;
+			}
+			if (imageSize.area() == 0)
+			{
+				imageSize = views[i].imageSize;
+			}
+			else if (views[i].imageSize != imageSize)
+			{
+				fprintf(stderr,
+						"Skipping image %s : size %dx%d differs from %dx%d\n",
+						imageList[i].c_str(),
+						views[i].imageSize.width,
+						views[i].imageSize.height,
+						imageSize.width,
+						imageSize.height);
+				continue;
+			}
+			if (views[i].found)
+			{
+				imagePoints.push_back(views[i].corners);
+			}
+		}
+
+		if (pyramidLevel != 0)
+		{
+			printf("Chessboards searched on pyramid level %d\n",
+				   detector.pyramidLevelFor(imageSize));
+		}
+
+		bool ok = false;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		if (!imagePoints.empty())
+		{
+			ok = runAndSave(outputFilename,
+							imagePoints,
+							imageSize,
+							boardSize,
+							squareSize,
+							aspectRatio,
+							flags,
+							cameraMatrix,
+							distCoeffs,
+							writeExtrinsics,
+							writePoints,
+							options);
+		}
+		else
+		{
+			fprintf(stderr, "No chessboard found, nothing to calibrate\n");
+		}
+		double calibrationTime =
+			chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		batch.getStatistics().print(stdout);
+		printf("  %-22s %10.3f\n", "runAndSave", calibrationTime);
+
+		if (ok && remapBenchmark)
+		{
+			UndistortMaps::benchmark(imread(imageList[0], 1),
+									 cameraMatrix,
+									 distCoeffs,
+									 remapBenchmarkIterations,
+									 stdout);
+		}
+
+		if (showUndistorted)
+		{
+			printf("Batch mode is headless : -su ignored\n");
+		}
+
+		reportProfile(profiler, traceFilename);
+		delete profiler;
+		return ok ? 0 : -1;
+	}
+
+	if (headless)
+	{
+		// no key to start capturing nor to trigger captures
+		if (manualTrigger)
+		{
+			printf("Headless mode has no manual trigger : -m ignored\n");
+			manualTrigger = false;
+		}
+		mode = CAPTURING;
+		key = 0;
+	}
+	else
 	{
-		printf("%s", liveCaptureHelp);
+		if (capture.isOpened())
+		{
+			printf("%s", liveCaptureHelp);
+		}
+
+		namedWindow("Image View", CV_WINDOW_AUTOSIZE | CV_GUI_NORMAL);
 	}
 
-	namedWindow("Image View", CV_WINDOW_AUTOSIZE | CV_GUI_NORMAL);
+	// headless progress and throughput report
+	size_t framesProcessed = 0, boardsFound = 0;
+	double detectionTime = 0;
+	chrono::steady_clock::time_point loopStart = chrono::steady_clock::now();
+
+	// ------------------------------------------------------------------------
+	// Pipelined mode : capture and detection run in their own threads, this
+	// loop only displays the newest detection result
+	// ------------------------------------------------------------------------
+	// undistortion maps are built once per calibration and image size
+	UndistortMaps undistortMaps(remapFormat, remapInterpolation);
+	Mat undistorted;
+
+	if (tracking && capture.isOpened())
+	{
+		tracker = new ChessboardTracker(detector, trackingFlow);
+	}
+
+	if (prefilter && capture.isOpened())
+	{
+		qualityFilter = new FrameQualityFilter(minSharpness);
+	}
+
+	if (pipelined && capture.isOpened())
+	{
+		pipeline = new LivePipeline(capture,
+									detector,
+									reduceFactor,
+									flipVertical,
+									tracker,
+									qualityFilter);
+		pipeline->start();
+	}
 
 	for (i = 0;; i++)
 	{
+		Profiler::Scope frameScope(profiler, "frame");
 		Mat view, viewGray;
+		vector<Point2f> pointbuf;
+		bool found = false;
 		bool blink = false;
+		// corner cache state of a stored image
+		uint64_t contentHash = 0;
+		bool hashed = false;
+		bool cachedView = false;
+		Size cachedSize;
 
-		if (capture.isOpened())
+		if (pipeline != NULL)
+		{
+			Profiler::Scope scope(profiler, "nextResult");
+			LiveFrame frame;
+			if (pipeline->nextResult(frame))
+			{
+				view = frame.view;
+				pointbuf = frame.corners;
+				found = frame.found;
+			}
+		}
+		else if (capture.isOpened())
 		{
+			Profiler::Scope scope(profiler, "capture");
 			Mat view0;
 			capture >> view0;
 			if (reduceFactor != 1)
@@ -699,65 +1589,168 @@ int main(int argc, char ** argv)
 		}
 		else if (i < (int) imageList.size())
 		{
-			view = imread(imageList[i], 1);
+			// a view which is not displayed is only needed for detection :
+			// look it up in the corner cache first and decode it on a miss
+			if (cache != NULL && headless)
+			{
+				chrono::steady_clock::time_point lookupStart =
+					chrono::steady_clock::now();
+				hashed = CornerCache::hashFile(imageList[i], contentHash);
+				cachedView = hashed &&
+					cache->lookup(contentHash, cachedSize, found, pointbuf);
+				detectionTime += chrono::duration<double>(
+					chrono::steady_clock::now() - lookupStart).count();
+			}
+
+			if (!cachedView)
+			{
+				Profiler::Scope scope(profiler, "imread");
+				view = imread(imageList[i], 1);
+			}
 		}
 
-		if (!view.data)
+		if (!view.data && !cachedView)
 		{
 			if (imagePoints.size() > 0)
 			{
-				runAndSave(outputFilename,
-						   imagePoints,
-						   imageSize,
-						   boardSize,
-						   squareSize,
-						   aspectRatio,
-						   flags,
-						   cameraMatrix,
-						   distCoeffs,
-						   writeExtrinsics,
-						   writePoints);
+				if (runAndSave(outputFilename,
+							   imagePoints,
+							   imageSize,
+							   boardSize,
+							   squareSize,
+							   aspectRatio,
+							   flags,
+							   cameraMatrix,
+							   distCoeffs,
+							   writeExtrinsics,
+							   writePoints,
+							   options))
+				{
+					mode = CALIBRATED;
+				}
 			}
 			break;
 		}
 
-		imageSize = view.size();
+		imageSize = cachedView ? cachedSize : view.size();
 
-		if (flipVertical)
+		if (i == 0 && pyramidLevel != 0)
 		{
-			flip(view, view, 0);
+			printf("Searching chessboards on pyramid level %d\n",
+				   detector.pyramidLevelFor(imageSize));
 		}
 
-		vector<Point2f> pointbuf;
-		cvtColor(view, viewGray, CV_BGR2GRAY);
+		if (pipeline == NULL && !cachedView)
+		{
+			if (flipVertical)
+			{
+				flip(view, view, 0);
+			}
 
-		bool found = findChessboardCorners(view,
-										   boardSize,
-										   pointbuf,
-										   CV_CALIB_CB_ADAPTIVE_THRESH &
-										   CV_CALIB_CB_FAST_CHECK &
-										   CV_CALIB_CB_NORMALIZE_IMAGE);
+			chrono::steady_clock::time_point detectionStart =
+				chrono::steady_clock::now();
+			// displayed views are decoded anyway and looked up here
+			if (cache != NULL && !hashed)
+			{
+				hashed = CornerCache::hashFile(imageList[i], contentHash);
+				cachedView = hashed &&
+					cache->lookup(contentHash, cachedSize, found, pointbuf) &&
+					cachedSize == imageSize;
+			}
 
-		// improve the found corners' coordinate accuracy
+			if (cachedView)
+			{
+				// unchanged image : detection skipped
+			}
+			else
+			{
+				{
+					Profiler::Scope scope(profiler, "cvtColor");
+					cvtColor(view, viewGray, CV_BGR2GRAY);
+				}
+
+				FrameQualityFilter::Verdict verdict =
+					FrameQualityFilter::ACCEPTED;
+				if (qualityFilter != NULL)
+				{
+					Profiler::Scope scope(profiler, "prefilter");
+					verdict = qualityFilter->check(viewGray);
+				}
+				chrono::steady_clock::time_point searchStart =
+					chrono::steady_clock::now();
+
+				if (verdict != FrameQualityFilter::ACCEPTED)
+				{
+					// hopeless frame : chessboard search skipped
+					found = false;
+				}
+				else if (tracker != NULL)
+				{
+					Profiler::Scope scope(profiler, "track");
+					found = tracker->detect(viewGray, pointbuf);
+				}
+				else
+				{
+					// both detection stages timed separately
+					{
+						Profiler::Scope scope(profiler,
+											  "findChessboardCorners");
+						found = detector.findCorners(viewGray, pointbuf);
+					}
+					if (found)
+					{
+						Profiler::Scope scope(profiler, "cornerSubPix");
+						detector.refineCorners(viewGray, pointbuf);
+					}
+				}
+
+				if (qualityFilter != NULL &&
+					verdict == FrameQualityFilter::ACCEPTED)
+				{
+					qualityFilter->addDetectionTime(chrono::duration<double>(
+						chrono::steady_clock::now() - searchStart).count());
+				}
+
+				if (hashed)
+				{
+					cache->insert(contentHash, imageSize, found, pointbuf);
+				}
+			}
+			detectionTime += chrono::duration<double>(
+				chrono::steady_clock::now() - detectionStart).count();
+		}
+		framesProcessed++;
 		if (found)
 		{
-			cornerSubPix(viewGray,
-						 pointbuf,
-						 Size(11, 11),
-						 Size(-1, -1),
-						 TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER,
-									  30,
-									  0.1));
+			boardsFound++;
 		}
 
-		bool trigger;
+		bool trigger = false;
 		if (manualTrigger)
 		{
 			trigger = (key == 'c');
 		}
+		else if (novelty && capture.isOpened())
+		{
+			// only views bringing a new pose or new coverage, rate limited
+			// by the gate itself
+			if (mode == CAPTURING && found)
+			{
+				Profiler::Scope scope(profiler, "noveltyGate");
+				if (noveltyGate == NULL)
+				{
+					noveltyGate = new NoveltyGate(imageSize,
+												  boardSize,
+												  squareSize,
+												  delay * 1e-3);
+				}
+				trigger = noveltyGate->offer(pointbuf);
+			}
+		}
 		else
 		{
-			trigger = clock() - prevTimestamp > delay * 1e-3 * CLOCKS_PER_SEC;
+			trigger = chrono::steady_clock::now() - prevTimestamp >=
+				chrono::milliseconds(delay);
 		}
 
 		if (mode == CAPTURING &&
@@ -766,55 +1759,147 @@ int main(int argc, char ** argv)
 			 trigger))
 		{
 			imagePoints.push_back(pointbuf);
-			prevTimestamp = clock();
+			prevTimestamp = chrono::steady_clock::now();
 			blink = capture.isOpened();
-		}
+			if (headless && capture.isOpened())
+			{
+				printf("View %d/%d captured (frame %d)\n",
+					   (int) imagePoints.size(), nframes, i);
+			}
 
-		if (found)
-		{
-			drawChessboardCorners(view, boardSize, Mat(pointbuf), found);
+			// the solve runs in its own thread : submitting only copies
+			// the views
+			if (progressiveEvery > 0 && capture.isOpened())
+			{
+				if (progressiveSolver == NULL)
+				{
+					progressiveSolver = new ProgressiveSolver(imageSize,
+															  boardSize,
+															  squareSize,
+															  aspectRatio,
+															  flags);
+					progressiveSolver->start();
+				}
+				if (imagePoints.size() % progressiveEvery == 0)
+				{
+					progressiveSolver->submit(imagePoints);
+				}
+			}
 		}
 
-		string msg = mode == CAPTURING ?
-					"100/100" :
-					mode == CALIBRATED ? "Calibrated" : "Press 'g' to start";
-		int baseLine = 0;
-		Size textSize = getTextSize(msg, 1, 1, 1, &baseLine);
-		Point textOrigin(view.cols - 2 * textSize.width - 10,
-						 view.rows - 2 * baseLine - 10);
-
-		if (mode == CAPTURING)
+		if (progressiveSolver != NULL && progressiveSolver->latest(progress))
 		{
-			if (undistortImage)
+			// poses of the novelty gate are better judged with real
+			// intrinsics
+			if (noveltyGate != NULL)
 			{
-				msg = format("%d/%d Undist", (int) imagePoints.size(), nframes);
+				noveltyGate->setIntrinsics(progress.cameraMatrix,
+										   progress.distCoeffs);
 			}
-			else
+			if (headless)
 			{
-				msg = format("%d/%d", (int) imagePoints.size(), nframes);
+				printf("Progressive calibration on %u views : fx %.1f fy %.1f "
+					   "cx %.1f cy %.1f, error %.3f px%s\n",
+					   (unsigned) progress.views,
+					   progress.cameraMatrix.at<double>(0, 0),
+					   progress.cameraMatrix.at<double>(1, 1),
+					   progress.cameraMatrix.at<double>(0, 2),
+					   progress.cameraMatrix.at<double>(1, 2),
+					   progress.error,
+					   progress.converged ? ", converged" : "");
 			}
 		}
 
-		putText(view,
-				msg,
-				textOrigin,
-				1,
-				1,
-				mode != CALIBRATED ? Scalar(0, 0, 255) : Scalar(0, 255, 0));
-
-		if (blink)
+		if (headless)
 		{
-			bitwise_not(view, view);
+			if (!capture.isOpened())
+			{
+				printf("[%d/%d] %s : %s\n",
+					   i + 1,
+					   (int) imageList.size(),
+					   imageList[i].c_str(),
+					   found ? "board found" : "no board");
+			}
 		}
-
-		if (mode == CALIBRATED && undistortImage)
+		else
 		{
-			Mat temp = view.clone();
-			undistort(temp, view, cameraMatrix, distCoeffs);
-		}
+			{
+				Profiler::Scope scope(profiler, "draw");
+				if (found)
+				{
+					drawChessboardCorners(view, boardSize, Mat(pointbuf), found);
+				}
+
+				string msg = mode == CAPTURING ?
+							"100/100" :
+							mode == CALIBRATED ? "Calibrated" : "Press 'g' to start";
+				int baseLine = 0;
+				Size textSize = getTextSize(msg, 1, 1, 1, &baseLine);
+				Point textOrigin(view.cols - 2 * textSize.width - 10,
+								 view.rows - 2 * baseLine - 10);
+
+				if (mode == CAPTURING)
+				{
+					if (undistortImage)
+					{
+						msg = format("%d/%d Undist", (int) imagePoints.size(), nframes);
+					}
+					else
+					{
+						msg = format("%d/%d", (int) imagePoints.size(), nframes);
+					}
+				}
+
+				putText(view,
+						msg,
+						textOrigin,
+						1,
+						1,
+						mode != CALIBRATED ? Scalar(0, 0, 255) : Scalar(0, 255, 0));
+
+				if (mode == CAPTURING && progress.round > 0)
+				{
+					string progressMsg = format(
+						"fx %.1f fy %.1f cx %.1f cy %.1f err %.3f px (%u views)%s",
+						progress.cameraMatrix.at<double>(0, 0),
+						progress.cameraMatrix.at<double>(1, 1),
+						progress.cameraMatrix.at<double>(0, 2),
+						progress.cameraMatrix.at<double>(1, 2),
+						progress.error,
+						(unsigned) progress.views,
+						progress.converged ? " converged" : "");
+					putText(view,
+							progressMsg,
+							Point(10, 20),
+							1,
+							1,
+							progress.converged ? Scalar(0, 255, 0) :
+								Scalar(0, 255, 255));
+				}
+
+				if (blink)
+				{
+					bitwise_not(view, view);
+				}
+			}
 
-		imshow("Image View", view);
-		key = 0xff & waitKey(capture.isOpened() ? 50 : 500);
+			if (mode == CALIBRATED && undistortImage)
+			{
+				Profiler::Scope scope(profiler, "undistort");
+				// maps are only rebuilt when calibration or image size changed
+				undistortMaps.update(cameraMatrix, distCoeffs, view.size());
+				undistortMaps.apply(view, undistorted);
+				view = undistorted;
+			}
+
+			{
+				Profiler::Scope scope(profiler, "display");
+				imshow("Image View", view);
+				// in pipelined mode the display is paced by detection results
+				key = 0xff & waitKey(pipeline != NULL ? 1 :
+									 capture.isOpened() ? 50 : 500);
+			}
+		}
 
 		if ((key & 255) == 27)
 		{
@@ -830,10 +1915,37 @@ int main(int argc, char ** argv)
 		{
 			mode = CAPTURING;
 			imagePoints.clear();
+			// restarted capture : the novelty gate forgets the discarded
+			// views (recreated on the next board) and progressive results
+			// start over
+			delete noveltyGate;
+			noveltyGate = NULL;
+			delete progressiveSolver;
+			progressiveSolver = NULL;
+			progress = ProgressiveResult();
 		}
 
-		if (mode == CAPTURING && imagePoints.size() >= (unsigned) nframes)
+		// capture ends with enough views or once the progressive
+		// calibration has converged
+		bool converged = progressiveSolver != NULL &&
+			progressiveSolver->hasConverged();
+		if (mode == CAPTURING &&
+			(imagePoints.size() >= (unsigned) nframes || converged))
 		{
+			if (progressiveSolver != NULL)
+			{
+				if (converged)
+				{
+					printf("Progressive calibration converged after %u views\n",
+						   (unsigned) imagePoints.size());
+				}
+				progressiveSolver->stop();
+				progressiveSolver->printStatistics(stdout);
+				delete progressiveSolver;
+				progressiveSolver = NULL;
+				progress = ProgressiveResult();
+			}
+
 			if (runAndSave(outputFilename,
 						   imagePoints,
 						   imageSize,
@@ -844,37 +1956,122 @@ int main(int argc, char ** argv)
 						   cameraMatrix,
 						   distCoeffs,
 						   writeExtrinsics,
-						   writePoints))
+						   writePoints,
+						   options))
 			{
 				mode = CALIBRATED;
+				if (remapBenchmark && capture.isOpened())
+				{
+					UndistortMaps::benchmark(view,
+											 cameraMatrix,
+											 distCoeffs,
+											 remapBenchmarkIterations,
+											 stdout);
+				}
 			}
 			else
 			{
 				mode = DETECTION;
 			}
-			if (!capture.isOpened())
+			// without a display there is nothing left to show
+			if (!capture.isOpened() || headless)
 			{
 				break;
 			}
 		}
 	}
 
-	if (!capture.isOpened() && showUndistorted)
+	if (headless)
+	{
+		double loopTime = chrono::duration<double>(
+			chrono::steady_clock::now() - loopStart).count();
+		printf("Headless run: %u frames, %u boards found, %u views used "
+			   "in %.3f s (%.2f frames/s)\n",
+			   (unsigned) framesProcessed,
+			   (unsigned) boardsFound,
+			   (unsigned) imagePoints.size(),
+			   loopTime,
+			   loopTime > 0 ? framesProcessed / loopTime : 0.0);
+		if (pipeline == NULL && framesProcessed > 0)
+		{
+			printf("  %-22s %10.3f ms/frame\n",
+				   "detection",
+				   1e3 * detectionTime / framesProcessed);
+		}
+	}
+
+	if (pipeline != NULL)
+	{
+		pipeline->stop();
+		pipeline->printStatistics(stdout);
+		delete pipeline;
+	}
+
+	if (tracker != NULL)
+	{
+		tracker->printStatistics(stdout);
+		delete tracker;
+	}
+
+	if (qualityFilter != NULL)
+	{
+		qualityFilter->printStatistics(stdout);
+		delete qualityFilter;
+	}
+
+	if (noveltyGate != NULL)
+	{
+		noveltyGate->getStatistics().print(stdout);
+		delete noveltyGate;
+	}
+
+	if (progressiveSolver != NULL)
+	{
+		progressiveSolver->stop();
+		progressiveSolver->printStatistics(stdout);
+		delete progressiveSolver;
+	}
+
+	if (cache != NULL)
+	{
+		if (!cache->save())
+		{
+			fprintf(stderr, "Could not write corner cache %s\n",
+					cache->getFilename().c_str());
+		}
+		cache->printStatistics(stdout);
+		delete cache;
+	}
+
+	reportProfile(profiler, traceFilename);
+	options.profiler = NULL;
+	delete profiler;
+
+	if (remapBenchmark && !capture.isOpened() && mode == CALIBRATED)
 	{
-		Mat view, rview, map1, map2;
-		initUndistortRectifyMap(cameraMatrix,
-								distCoeffs,
-								Mat(),
-								getOptimalNewCameraMatrix(cameraMatrix,
-														  distCoeffs,
-														  imageSize,
-														  1,
-														  imageSize,
-														  0),
-								imageSize,
-								CV_16SC2,
-								map1,
-								map2);
+		UndistortMaps::benchmark(imread(imageList[0], 1),
+								 cameraMatrix,
+								 distCoeffs,
+								 remapBenchmarkIterations,
+								 stdout);
+	}
+
+	if (showUndistorted && headless)
+	{
+		printf("Headless mode : -su ignored\n");
+	}
+	else if (!capture.isOpened() && showUndistorted)
+	{
+		Mat view, rview;
+		undistortMaps.update(cameraMatrix,
+							 distCoeffs,
+							 imageSize,
+							 getOptimalNewCameraMatrix(cameraMatrix,
+													   distCoeffs,
+													   imageSize,
+													   1,
+													   imageSize,
+													   0));
 
 		for (i = 0; i < (int) imageList.size(); i++)
 		{
@@ -884,7 +2081,7 @@ int main(int argc, char ** argv)
 				continue;
 			}
 			// undistort( view, rview, cameraMatrix, distCoeffs, cameraMatrix );
-			remap(view, rview, map1, map2, INTER_LINEAR);
+			undistortMaps.apply(view, rview);
 			imshow("Image View", rview);
 			int c = 0xff & waitKey();
 			if ((c & 255) == 27 || c == 'q' || c == 'Q')
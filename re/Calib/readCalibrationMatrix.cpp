@@ -5,55 +5,71 @@
  *      Author: davidroussel
  */
 
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <opencv2/core/core.hpp>
 
+#include "CameraModel.h"
+
 using namespace std;
 using namespace cv;
 
 ostream & usage (ostream & os, char * name)
 {
-	os << "usage : " << name << " <calib_camera_data_file.yaml>" << endl;
+	os << "usage : " << name << " <calib_camera_data_file.yaml|.calb> "
+	   << "[--derived]" << endl
+	   << "  --derived also build undistortion maps and rays table and "
+	   << "print their build times" << endl;
 	return os;
 }
 
 int main (int argc, char ** argv)
 {
 	string filename;
-	FileStorage * fs = NULL;
+	bool derived = false;
+	CameraModel camera;
 
 	// ------------------------------------------------------------------------
 	// parse arguments
 	// ------------------------------------------------------------------------
-	if (argc < 2)
-	{
-		cerr << usage(cerr, argv[0]);
-	}
-	else
+	if (argc < 2 || (argc > 2 && strcmp(argv[2], "--derived") != 0))
 	{
-		filename = argv[1];
+		usage(cerr, argv[0]);
+		return EXIT_FAILURE;
 	}
+	filename = argv[1];
+	derived = argc > 2;
+
 	// ------------------------------------------------------------------------
-	// search for calibration matrix in file
+	// load calibration (binary files are mapped, text files parsed)
 	// ------------------------------------------------------------------------
-	fs = new FileStorage(filename, FileStorage::READ);
-	if (!fs->isOpened())
+	if (!camera.load(filename))
 	{
-		cerr << "Failed to open FileStorage : " << filename << endl;
+		cerr << "Failed to read calibration : " << filename << endl;
 		return EXIT_FAILURE;
 	}
 
-	Mat cameraMatrix;
-	(*fs)["camera_matrix"] >> cameraMatrix;
-
+	const Mat & cameraMatrix = camera.getCameraMatrix();
 	cout << "matrix size = ["<< cameraMatrix.rows << "x" << cameraMatrix.cols
 	     << "]" << endl;
 	cout << "matrix element size = " << cameraMatrix.elemSize() << endl;
 	cout << "Camera matrix = " << cameraMatrix << endl;
+	cout << "Inverse camera matrix = " << camera.getInverseCameraMatrix()
+		 << endl;
+	cout << "Distortion coefficients = " << camera.getDistCoeffs() << endl;
+	cout << "Image size = " << camera.getImageSize().width << "x"
+		 << camera.getImageSize().height << endl;
 
 	// ------------------------------------------------------------------------
-	// Explain calibration matrix parameters
+	// build derived data
 	// ------------------------------------------------------------------------
-	delete fs;
+	if (derived)
+	{
+		camera.getUndistortMaps();
+		camera.getRays();
+	}
+	camera.getStatistics().print(stdout);
+
 	return EXIT_SUCCESS;
 }
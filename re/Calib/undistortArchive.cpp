@@ -0,0 +1,572 @@
+/*
+ * undistortArchive.cpp
+ *
+ * Undistorts a directory of images or a video file with the calibration
+ * parameters produced by calibration (out_camera_data.yml).
+ * Images flow through a decode -> remap -> encode pipeline where each stage
+ * runs on its own threads, connected by bounded queues.
+ */
+
+#include <sys/stat.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "BoundedQueue.h"
+#include "CameraModel.h"
+#include "ThreadPool.h"
+#include "UndistortMaps.h"
+
+using namespace std;
+using namespace cv;
+
+typedef chrono::steady_clock Clock;
+
+/**
+ * Elapsed time since a time point
+ * @param start the starting time point
+ * @return the elapsed time in seconds
+ */
+static double secondsSince(const Clock::time_point & start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * A frame travelling through the pipeline
+ */
+struct Frame
+{
+	/**
+	 * Frame index in the input (file list or video)
+	 */
+	size_t index;
+
+	/**
+	 * Source file name (empty for video frames)
+	 */
+	string name;
+
+	/**
+	 * Image data
+	 */
+	Mat image;
+};
+
+/**
+ * Pipeline statistics.
+ * Stage times are summed over all threads of the stage
+ */
+struct PipelineStatistics
+{
+	mutex lock;
+	size_t frames;
+	size_t failures;
+	size_t bytes;
+	double decodeTime;
+	double remapTime;
+	double encodeTime;
+
+	PipelineStatistics() :
+		frames(0),
+		failures(0),
+		bytes(0),
+		decodeTime(0),
+		remapTime(0),
+		encodeTime(0)
+	{
+	}
+};
+
+/**
+ * Program settings
+ */
+struct Settings
+{
+	string calibrationFile;
+	string input;
+	string output;
+	int decoders;
+	int remappers;
+	int encoders;
+	int bands;
+	int mapType;
+	int interpolation;
+	double alpha;
+	string fourcc;
+	size_t queueSize;
+
+	Settings() :
+		decoders((int) ThreadPool::defaultThreadCount()),
+		remappers((int) ThreadPool::defaultThreadCount()),
+		encoders((int) ThreadPool::defaultThreadCount()),
+		bands(1),
+		mapType(CV_16SC2),
+		interpolation(INTER_LINEAR),
+		alpha(-1),
+		fourcc("MJPG"),
+		queueSize(8)
+	{
+	}
+};
+
+ostream & usage(ostream & os, char * name)
+{
+	os << "usage : " << name << " [options] <calib_camera_data_file.yaml|.calb> "
+	   << "<input> <output>" << endl
+	   << "  <input>  directory of images or video file" << endl
+	   << "  <output> directory for undistorted images (must exist) or video "
+	   << "file" << endl
+	   << "options :" << endl
+	   << "  -d <n>     decoding threads (images only, all cores by default)"
+	   << endl
+	   << "  -r <n>     remapping threads (all cores by default)" << endl
+	   << "  -e <n>     encoding threads (images only, all cores by default)"
+	   << endl
+	   << "  -b <n>     row bands remapped concurrently within each frame "
+	   << "(1 by default)" << endl
+	   << "  -q <n>     capacity of queues between stages (8 by default)"
+	   << endl
+	   << "  -f <16SC2|32FC1|32FC2>  maps format (16SC2 by default)" << endl
+	   << "  -i <nearest|linear|cubic|lanczos>  interpolation (linear by "
+	   << "default)" << endl
+	   << "  -a <alpha> free scaling of the undistorted image between 0 (only "
+	   << "valid pixels)" << endl
+	   << "             and 1 (all source pixels), camera matrix kept if not "
+	   << "specified" << endl
+	   << "  -c <FOURCC> output video codec (MJPG by default)" << endl;
+	return os;
+}
+
+/**
+ * Check if a path is a directory
+ * @param path the path to check
+ * @return true if path exists and is a directory
+ */
+static bool isDirectory(const string & path)
+{
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+/**
+ * File name part of a path
+ * @param path the path
+ * @return the file name without directories
+ */
+static string baseName(const string & path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+/**
+ * Check if a file name has a supported image extension
+ * @param filename the file name to check
+ * @return true if the file is an image
+ */
+static bool isImage(const string & filename)
+{
+	static const char * extensions[] =
+		{ ".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".ppm", ".pgm" };
+	size_t dot = filename.find_last_of('.');
+	if (dot == string::npos)
+	{
+		return false;
+	}
+	string ext = filename.substr(dot);
+	for (size_t i = 0; i < ext.size(); i++)
+	{
+		ext[i] = (char) tolower(ext[i]);
+	}
+	for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++)
+	{
+		if (ext == extensions[i])
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Parse command line arguments
+ * @param argc arguments count
+ * @param argv arguments values
+ * @param settings parsed settings
+ * @return true if arguments are valid
+ */
+static bool parseArguments(int argc, char ** argv, Settings & settings)
+{
+	vector<string> positional;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char * s = argv[i];
+		bool hasValue = i + 1 < argc;
+		int value = 0;
+
+		if (s[0] != '-')
+		{
+			positional.push_back(s);
+		}
+		else if (!hasValue)
+		{
+			cerr << "Missing value for option " << s << endl;
+			return false;
+		}
+		else if (strcmp(s, "-f") == 0)
+		{
+			if (!UndistortMaps::parseMapType(argv[++i], settings.mapType))
+			{
+				cerr << "Invalid maps format " << argv[i] << endl;
+				return false;
+			}
+		}
+		else if (strcmp(s, "-i") == 0)
+		{
+			if (!UndistortMaps::parseInterpolation(argv[++i],
+												   settings.interpolation))
+			{
+				cerr << "Invalid interpolation " << argv[i] << endl;
+				return false;
+			}
+		}
+		else if (strcmp(s, "-a") == 0)
+		{
+			if (sscanf(argv[++i], "%lf", &settings.alpha) != 1 ||
+				settings.alpha < 0 || settings.alpha > 1)
+			{
+				cerr << "Invalid free scaling " << argv[i] << endl;
+				return false;
+			}
+		}
+		else if (strcmp(s, "-c") == 0)
+		{
+			settings.fourcc = argv[++i];
+			if (settings.fourcc.size() != 4)
+			{
+				cerr << "Invalid codec " << settings.fourcc << endl;
+				return false;
+			}
+		}
+		else if (sscanf(argv[++i], "%d", &value) != 1 || value <= 0)
+		{
+			cerr << "Invalid value for option " << s << endl;
+			return false;
+		}
+		else if (strcmp(s, "-d") == 0)
+		{
+			settings.decoders = value;
+		}
+		else if (strcmp(s, "-r") == 0)
+		{
+			settings.remappers = value;
+		}
+		else if (strcmp(s, "-e") == 0)
+		{
+			settings.encoders = value;
+		}
+		else if (strcmp(s, "-b") == 0)
+		{
+			settings.bands = value;
+		}
+		else if (strcmp(s, "-q") == 0)
+		{
+			settings.queueSize = (size_t) value;
+		}
+		else
+		{
+			cerr << "Unknown option " << s << endl;
+			return false;
+		}
+	}
+
+	if (positional.size() != 3)
+	{
+		return false;
+	}
+
+	settings.calibrationFile = positional[0];
+	settings.input = positional[1];
+	settings.output = positional[2];
+	return true;
+}
+
+int main(int argc, char ** argv)
+{
+	Settings settings;
+
+	// ------------------------------------------------------------------------
+	// parse arguments
+	// ------------------------------------------------------------------------
+	if (!parseArguments(argc, argv, settings))
+	{
+		usage(cerr, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// ------------------------------------------------------------------------
+	// load calibration and build maps once
+	// ------------------------------------------------------------------------
+	CameraModel camera(settings.mapType, settings.interpolation, settings.alpha);
+	if (!camera.load(settings.calibrationFile))
+	{
+		cerr << "Failed to read calibration (camera matrix, distortion and "
+			 << "image size) : " << settings.calibrationFile << endl;
+		return EXIT_FAILURE;
+	}
+
+	Size imageSize = camera.getImageSize();
+	int width = imageSize.width;
+	int height = imageSize.height;
+	Clock::time_point start = Clock::now();
+	const UndistortMaps & maps = camera.getUndistortMaps();
+	double buildTime = secondsSince(start);
+
+	// ------------------------------------------------------------------------
+	// open input and output
+	// ------------------------------------------------------------------------
+	bool imagesInput = isDirectory(settings.input);
+	vector<string> files;
+	VideoCapture capture;
+	VideoWriter writer;
+
+	if (imagesInput)
+	{
+		vector<string> entries;
+		glob(settings.input, entries, false);
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			if (isImage(entries[i]))
+			{
+				files.push_back(entries[i]);
+			}
+		}
+		if (files.empty())
+		{
+			cerr << "No images found in " << settings.input << endl;
+			return EXIT_FAILURE;
+		}
+		if (!isDirectory(settings.output))
+		{
+			cerr << "Output directory " << settings.output
+				 << " does not exist" << endl;
+			return EXIT_FAILURE;
+		}
+	}
+	else
+	{
+		if (!capture.open(settings.input))
+		{
+			cerr << "Could not open video " << settings.input << endl;
+			return EXIT_FAILURE;
+		}
+		double fps = capture.get(CV_CAP_PROP_FPS);
+		const string & c = settings.fourcc;
+		if (!writer.open(settings.output,
+						 CV_FOURCC(c[0], c[1], c[2], c[3]),
+						 fps > 0 ? fps : 25.0,
+						 imageSize))
+		{
+			cerr << "Could not open output video " << settings.output << endl;
+			return EXIT_FAILURE;
+		}
+		// video decoding and encoding are sequential
+		settings.decoders = 1;
+		settings.encoders = 1;
+	}
+
+	cout << "Undistorting " << (imagesInput ? "images" : "video") << " "
+		 << settings.input << " to " << settings.output << endl
+		 << "  " << settings.decoders << " decoders, " << settings.remappers
+		 << " remappers (" << settings.bands << " bands), "
+		 << settings.encoders << " encoders, "
+		 << UndistortMaps::mapTypeName(settings.mapType) << " maps, "
+		 << UndistortMaps::interpolationName(settings.interpolation)
+		 << " interpolation" << endl;
+
+	// ------------------------------------------------------------------------
+	// decode -> remap -> encode pipeline
+	// ------------------------------------------------------------------------
+	BoundedQueue<Frame> decoded(settings.queueSize);
+	BoundedQueue<Frame> remapped(settings.queueSize);
+	PipelineStatistics stats;
+	atomic<size_t> nextFile(0);
+	vector<thread> decoders, remappers, encoders;
+
+	start = Clock::now();
+
+	for (int t = 0; t < settings.decoders; t++)
+	{
+		decoders.push_back(thread([&] {
+			for (;;)
+			{
+				Frame frame;
+				Clock::time_point t0 = Clock::now();
+				if (imagesInput)
+				{
+					frame.index = nextFile++;
+					if (frame.index >= files.size())
+					{
+						break;
+					}
+					frame.name = files[frame.index];
+					frame.image = imread(frame.name, IMREAD_UNCHANGED);
+				}
+				else
+				{
+					Mat grabbed;
+					if (!capture.read(grabbed) || grabbed.empty())
+					{
+						break;
+					}
+					frame.image = grabbed.clone();
+				}
+				double elapsed = secondsSince(t0);
+
+				bool valid = frame.image.size() == imageSize;
+				{
+					lock_guard<mutex> lock(stats.lock);
+					stats.decodeTime += elapsed;
+					if (!valid)
+					{
+						stats.failures++;
+					}
+				}
+				if (!valid)
+				{
+					cerr << "Skipping " << (imagesInput ? frame.name : "frame")
+						 << " : not a " << width << "x" << height
+						 << " image" << endl;
+					continue;
+				}
+				if (!imagesInput)
+				{
+					// only valid frames are numbered so the encoder can
+					// restore their order without gaps
+					frame.index = nextFile++;
+				}
+				decoded.push(frame);
+			}
+		}));
+	}
+
+	for (int t = 0; t < settings.remappers; t++)
+	{
+		remappers.push_back(thread([&] {
+			Frame frame;
+			while (decoded.pop(frame))
+			{
+				Clock::time_point t0 = Clock::now();
+				Mat undistorted;
+				maps.apply(frame.image, undistorted, settings.bands);
+				frame.image = undistorted;
+				double elapsed = secondsSince(t0);
+				{
+					lock_guard<mutex> lock(stats.lock);
+					stats.remapTime += elapsed;
+				}
+				remapped.push(frame);
+			}
+		}));
+	}
+
+	for (int t = 0; t < settings.encoders; t++)
+	{
+		encoders.push_back(thread([&] {
+			// video frames may come out of the remappers out of order
+			map<size_t, Mat> pending;
+			size_t nextIndex = 0;
+			Frame frame;
+			while (remapped.pop(frame))
+			{
+				Clock::time_point t0 = Clock::now();
+				bool ok = true;
+				if (imagesInput)
+				{
+					ok = imwrite(settings.output + "/" + baseName(frame.name),
+								 frame.image);
+				}
+				else
+				{
+					pending[frame.index] = frame.image;
+					map<size_t, Mat>::iterator it;
+					while ((it = pending.find(nextIndex)) != pending.end())
+					{
+						writer.write(it->second);
+						pending.erase(it);
+						nextIndex++;
+					}
+				}
+				double elapsed = secondsSince(t0);
+
+				lock_guard<mutex> lock(stats.lock);
+				stats.encodeTime += elapsed;
+				if (ok)
+				{
+					stats.frames++;
+					stats.bytes += frame.image.total() * frame.image.elemSize();
+				}
+				else
+				{
+					stats.failures++;
+					cerr << "Could not write " << frame.name << endl;
+				}
+			}
+		}));
+	}
+
+	for (size_t t = 0; t < decoders.size(); t++)
+	{
+		decoders[t].join();
+	}
+	decoded.close();
+	for (size_t t = 0; t < remappers.size(); t++)
+	{
+		remappers[t].join();
+	}
+	remapped.close();
+	for (size_t t = 0; t < encoders.size(); t++)
+	{
+		encoders[t].join();
+	}
+	writer.release();
+
+	double wallTime = secondsSince(start);
+
+	// ------------------------------------------------------------------------
+	// throughput report
+	// ------------------------------------------------------------------------
+	double n = stats.frames > 0 ? (double) stats.frames : 1.0;
+	printf("%u frames undistorted, %u failures in %.3f s : %.2f frames/s, "
+		   "%.1f MB/s\n",
+		   (unsigned) stats.frames,
+		   (unsigned) stats.failures,
+		   wallTime,
+		   wallTime > 0 ? stats.frames / wallTime : 0.0,
+		   wallTime > 0 ? stats.bytes / wallTime / 1e6 : 0.0);
+	printf("  %-8s %10s %12s\n", "stage", "total (s)", "mean (ms)");
+	printf("  %-8s %10.3f %12.2f\n", "maps", buildTime, 1e3 * buildTime);
+	printf("  %-8s %10.3f %12.2f\n", "decode",
+		   stats.decodeTime, 1e3 * stats.decodeTime / n);
+	printf("  %-8s %10.3f %12.2f\n", "remap",
+		   stats.remapTime, 1e3 * stats.remapTime / n);
+	printf("  %-8s %10.3f %12.2f\n", "encode",
+		   stats.encodeTime, 1e3 * stats.encodeTime / n);
+
+	return stats.failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}